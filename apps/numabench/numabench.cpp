@@ -0,0 +1,187 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <tdzdd/DdSpec.hpp>
+#include <tdzdd/DdStructure.hpp>
+#include <tdzdd/util/NumaPlacement.hpp>
+#include <tdzdd/util/ResourceUsage.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace tdzdd;
+
+/*
+ * Subsets of {1..n} whose sum of weights is a multiple of m.
+ * Each level has up to m nodes, which makes rows large enough
+ * to span many pages.
+ */
+class ModularSum: public DdSpec<ModularSum,int,2> {
+    int const n;
+    int const m;
+
+    int weight(int level) const {
+        return int((long long) level * level % m) + 1;
+    }
+
+public:
+    ModularSum(int n, int m) :
+            n(n), m(m) {
+    }
+
+    int getRoot(int& s) const {
+        s = 0;
+        return n;
+    }
+
+    int getChild(int& s, int level, int value) const {
+        if (value) s = (s + weight(level)) % m;
+        if (--level == 0) return (s == 0) ? -1 : 0;
+        return level;
+    }
+};
+
+struct AccessCount {
+    size_t local;
+    size_t remote;
+    size_t unknown;
+
+    AccessCount() :
+            local(0), remote(0), unknown(0) {
+    }
+
+    void add(void const* p, int node) {
+        int k = NumaPlacement::nodeOfAddress(p);
+        if (k < 0 || node < 0) ++unknown;
+        else if (k == node) ++local;
+        else ++remote;
+    }
+
+    double remoteRatio() const {
+        size_t n = local + remote;
+        return n ? double(remote) / n : 0.0;
+    }
+};
+
+/*
+ * Scans the diagram in parallel as the reducer does, sampling one node
+ * per page, and classifies the pages of the node and its children
+ * by whether they reside on the node of the scanning thread.
+ */
+AccessCount scan(DdStructure<2> const& dd) {
+    NodeTableEntity<2> const& diagram = *dd.getDiagram();
+    size_t const stride = 4096 / sizeof(Node<2>);
+    AccessCount total;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+#ifdef _OPENMP
+        int yy = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+#else
+        int yy = 0;
+        int threads = 1;
+#endif
+        NumaPlacement::bindThread(yy, threads);
+        AccessCount count;
+
+        for (int i = diagram.numRows() - 1; i >= 1; --i) {
+            intmax_t const m = diagram[i].size();
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+            for (intmax_t j = 0; j < m; j += stride) {
+                int node = NumaPlacement::currentNode();
+                Node<2> const& p = diagram[i][j];
+                count.add(&p, node);
+                for (int b = 0; b < 2; ++b) {
+                    NodeId f = p.branch[b];
+                    if (f.row() == 0) continue;
+                    count.add(&diagram[f.row()][f.col()], node);
+                }
+            }
+        }
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            total.local += count.local;
+            total.remote += count.remote;
+            total.unknown += count.unknown;
+        }
+    }
+
+    return total;
+}
+
+void run(int n, int m, bool numa) {
+    NumaPlacement::enable(numa);
+    ElapsedTimeCounter buildTime, reduceTime;
+
+    buildTime.start();
+    DdStructure<2> dd(ModularSum(n, m), true);
+    buildTime.stop();
+    AccessCount built = scan(dd);
+    size_t size = dd.size();
+
+    reduceTime.start();
+    dd.zddReduce();
+    reduceTime.stop();
+    AccessCount reduced = scan(dd);
+
+    std::cout << (numa ? "numa" : "default") << "\t" << size << "\t"
+            << buildTime << "\t" << reduceTime << "\t" << std::fixed
+            << std::setprecision(3) << built.remoteRatio() << "\t"
+            << reduced.remoteRatio() << "\t" << built.unknown << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    int n = (argc >= 2) ? std::atoi(argv[1]) : 60;
+    int m = (argc >= 3) ? std::atoi(argv[2]) : 100000;
+    if (n < 1 || m < 1) {
+        std::cerr << "usage: " << argv[0] << " [ <n> [ <m> ] ]\n";
+        return 1;
+    }
+
+#ifdef _OPENMP
+    std::cout << "threads: " << omp_get_max_threads() << "\n";
+#endif
+    std::cout << "NUMA nodes: " << NumaPlacement::numNodes() << "\n";
+    std::cout << "mode\tsize\tbuild\treduce\tremote(built)\tremote(reduced)"
+            "\tunknown\n";
+    run(n, m, false);
+    run(n, m, true);
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <chrono>
 #include <random>
 
+#include <tdzdd/DdForest.hpp>
 #include <tdzdd/DdStructure.hpp>
 #include <tdzdd/DdSpecOp.hpp>
 // #include <tdzdd/DdEval.hpp>
@@ -119,7 +120,8 @@ chrono::duration<double> measure(int n, int k, int m, int from, int SAMPLE_SIZE)
 
     vector<PropositionalState> ss;
     vector<Subsets> specs;
-    vector<DdStructure<2>> dds;
+    DdForest<2> forest;
+    vector<DdForest<2>::Root> dds;
     ss.reserve(SAMPLE_SIZE);
     specs.reserve(SAMPLE_SIZE);
     dds.reserve(SAMPLE_SIZE);
@@ -133,23 +135,23 @@ chrono::duration<double> measure(int n, int k, int m, int from, int SAMPLE_SIZE)
 	ss.push_back(s);
 	Subsets spec(s,k);
 	specs.push_back(spec);
-	DdStructure<2> dd(spec);
-	dd.zddReduce();
-	dds.push_back(dd);
+	dds.push_back(forest.add(spec));
     }
 
     auto start = chrono::high_resolution_clock::now();
 
-    DdStructure<2> dd = dds[0];
+    DdForest<2>::Root root = dds[0];
     for (int i = 1; i < SAMPLE_SIZE; i++){
-	auto spec = zddUnion(dd, dds[i]);
-	dd = DdStructure<2>(spec);
-	dd.zddReduce();
+	root = forest.add(zddUnion(root, dds[i]));
     }
 
     auto end = chrono::high_resolution_clock::now();
     chrono::duration<double> duration = end - start;
 
+    cout << "forest: " << forest.size() << " nodes, "
+	 << forest.numRoots() << " roots" << endl;
+    DdStructure<2> dd(root);
+
     dump(dd,
 	 to_string(n) + "-" +
 	 to_string(k) + "-" +
@@ -0,0 +1,364 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <tdzdd/DdSpecOp.hpp>
+#include <tdzdd/DdStructure.hpp>
+#include <tdzdd/spec/SizeConstraint.hpp>
+#include <tdzdd/util/NumaPlacement.hpp>
+
+using namespace tdzdd;
+
+extern bool useMP;
+
+TEST(BuildOptionsTest, SharedUniqTable) {
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    options.sharedUniqTable = true;
+    DdStructure<2> p(SizeConstraint(20, IntRange(5, 15)), useMP);
+    DdStructure<2> q(SizeConstraint(20, IntRange(5, 15)), options);
+    ASSERT_EQ(p.size(), q.size());
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.evaluate(ZddCardinality<>()), q.evaluate(ZddCardinality<>()));
+}
+
+TEST(BuildOptionsTest, SpillFiles) {
+    DdBuilderOptions options;
+    options.spillMemory = 1024;
+    DdStructure<2> p(SizeConstraint(20, IntRange(5, 15)));
+    DdStructure<2> q(SizeConstraint(20, IntRange(5, 15)), options);
+    ASSERT_EQ(p.size(), q.size());
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.evaluate(ZddCardinality<>()), q.evaluate(ZddCardinality<>()));
+}
+
+TEST(BuildOptionsTest, SpillPartitions) {
+    DdBuilderOptions options;
+    options.spillMemory = 128;
+    DdStructure<2> p(SizeConstraint(400, IntRange(0, 380)));
+    DdStructure<2> q(SizeConstraint(400, IntRange(0, 380)), options);
+    ASSERT_EQ(p.size(), q.size());
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.evaluate(ZddCardinality<>()), q.evaluate(ZddCardinality<>()));
+}
+
+namespace {
+
+class SameHashSize: public DdSpec<SameHashSize,int,2> {
+    int const n;
+
+public:
+    SameHashSize(int n)
+            : n(n) {
+    }
+
+    int getRoot(int& count) const {
+        count = 0;
+        return n;
+    }
+
+    int getChild(int& count, int level, int take) const {
+        count += take;
+        return (level == 1) ? -1 : level - 1;
+    }
+
+    size_t hashCode(int const& count) const {
+        return 0;
+    }
+};
+
+} // namespace
+
+TEST(BuildOptionsTest, SpillSameHash) {
+    DdBuilderOptions options;
+    options.spillMemory = 1024;
+    DdStructure<2> p(SameHashSize(10), options);
+    p.zddReduce();
+    ASSERT_EQ("1024", p.zddCardinality());
+    ASSERT_THROW(DdStructure<2>(SameHashSize(200), options),
+            std::runtime_error);
+}
+
+TEST(BuildOptionsTest, EagerDedup) {
+    DdBuilderOptions options;
+    options.eagerDedup = true;
+    IntRange const r1(3, 12);
+    IntRange const r2(8, 17, 3);
+    SizeConstraint const s1(20, r1);
+    SizeConstraint const s2(20, r2);
+
+    DdStructure<2> p(s1);
+    DdStructure<2> q(s1, options);
+    ASSERT_EQ(p.size(), q.size());
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+
+    DdStructure<2> r(zddLookahead(zddUnion(s1, s2)));
+    DdStructure<2> t(zddLookahead(zddUnion(s1, s2)), options);
+    ASSERT_EQ(r.size(), t.size());
+    r.zddReduce();
+    t.zddReduce();
+    ASSERT_EQ(r, t);
+    ASSERT_EQ(r.evaluate(ZddCardinality<>()), t.evaluate(ZddCardinality<>()));
+}
+
+TEST(BuildOptionsTest, HashCache) {
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    options.hashCache = true;
+    IntRange const r1(3, 12);
+    IntRange const r2(8, 17, 3);
+    SizeConstraint const s1(20, r1);
+    SizeConstraint const s2(20, r2);
+
+    DdStructure<2> p(zddLookahead(zddUnion(s1, s2)), useMP);
+    p.zddReduce();
+
+    for (int k = 0; k < 4; ++k) {
+        options.sharedUniqTable = (k == 1);
+        options.eagerDedup = (k == 2);
+        options.spillMemory = (k == 3) ? 1024 : 0;
+        DdStructure<2> q(zddLookahead(zddUnion(s1, s2)), options);
+        q.zddReduce();
+        ASSERT_EQ(p, q);
+        ASSERT_EQ(p.evaluate(ZddCardinality<>()),
+                q.evaluate(ZddCardinality<>()));
+    }
+}
+
+TEST(BuildOptionsTest, Reduction) {
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    IntRange const r1(3, 120);
+    IntRange const r2(8, 170, 3);
+    SizeConstraint const s1(200, r1);
+    SizeConstraint const s2(200, r2);
+
+    DdStructure<2> p(zddLookahead(zddUnion(s1, s2)), useMP);
+    p.zddReduce();
+    options.reduction = ZDD_REDUCTION;
+    DdStructure<2> q(zddLookahead(zddUnion(s1, s2)), options);
+    ASSERT_EQ(p.size(), q.size());
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.evaluate(ZddCardinality<>()), q.evaluate(ZddCardinality<>()));
+
+    DdStructure<2> r(zddIntersection(s1, s2), useMP);
+    r.bddReduce();
+    options.reduction = BDD_REDUCTION;
+    DdStructure<2> t(zddIntersection(s1, s2), options);
+    ASSERT_EQ(r.size(), t.size());
+    ASSERT_EQ(r, t);
+}
+
+TEST(BuildOptionsTest, DepthFirst) {
+    DdBuilderOptions options;
+    options.depthFirst = true;
+    IntRange const r1(3, 120);
+    IntRange const r2(8, 170, 3);
+    SizeConstraint const s1(200, r1);
+    SizeConstraint const s2(200, r2);
+
+    DdStructure<2> p(zddLookahead(zddUnion(s1, s2)), useMP);
+    DdStructure<2> q(zddLookahead(zddUnion(s1, s2)), options);
+    ASSERT_EQ(p.size(), q.size());
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+
+    options.reduction = ZDD_REDUCTION;
+    DdStructure<2> r(zddLookahead(zddUnion(s1, s2)), options);
+    ASSERT_EQ(p.size(), r.size());
+    ASSERT_EQ(p, r);
+    ASSERT_EQ(p.evaluate(ZddCardinality<>()), r.evaluate(ZddCardinality<>()));
+}
+
+TEST(BuildOptionsTest, MemoryLimit) {
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    options.memoryLimit = 4096;
+    try {
+        DdStructure<2> p(SizeConstraint(100, IntRange(0, 50)), options);
+        FAIL() << "DdBuildLimitExceeded is not thrown";
+    }
+    catch (DdBuildLimitExceeded const& e) {
+        ASSERT_LT(0, e.level());
+        ASSERT_EQ(101U, e.widths().size());
+        ASSERT_EQ(1U, e.widths()[100]);
+        ASSERT_LE(size_t(4096), e.peakBytes());
+    }
+
+    options.depthFirst = true;
+    ASSERT_THROW(DdStructure<2>(SizeConstraint(100, IntRange(0, 50)), options),
+            DdBuildLimitExceeded);
+
+    options.memoryLimit = 1 << 30;
+    DdStructure<2> q(SizeConstraint(100, IntRange(0, 50)), options);
+    ASSERT_LT(0U, q.size());
+}
+
+TEST(BuildOptionsTest, Checkpoint) {
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    options.checkpointFile = "testBuildOptions.ckp";
+    options.checkpointInterval = 0;
+    IntRange const r1(3, 120);
+    IntRange const r2(8, 170, 3);
+    SizeConstraint const s1(200, r1);
+    SizeConstraint const s2(200, r2);
+    DdStructure<2> p(zddLookahead(zddUnion(s1, s2)), useMP);
+    DdStructure<2> r = p;
+    r.zddReduce();
+
+    for (int k = 0; k < 2; ++k) {
+        options.eagerDedup = (k == 1);
+        options.memoryLimit = 1 << 16;
+        ASSERT_THROW(DdStructure<2>(zddLookahead(zddUnion(s1, s2)), options),
+                DdBuildLimitExceeded);
+        ASSERT_TRUE(DdCheckpointFile::exists(options.checkpointFile));
+
+        options.memoryLimit = 0;
+        DdStructure<2> q(zddLookahead(zddUnion(s1, s2)), options);
+        ASSERT_FALSE(DdCheckpointFile::exists(options.checkpointFile));
+        ASSERT_EQ(p.size(), q.size());
+        ASSERT_EQ(p.evaluate(ZddCardinality<>()),
+                q.evaluate(ZddCardinality<>()));
+        q.zddReduce();
+        ASSERT_EQ(r, q);
+    }
+
+    DdCheckpointFile::remove(options.checkpointFile);
+}
+
+TEST(BuildOptionsTest, Processes) {
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    IntRange const r1(3, 120);
+    IntRange const r2(8, 170, 3);
+    SizeConstraint const s1(200, r1);
+    SizeConstraint const s2(200, r2);
+    DdStructure<2> p(zddLookahead(zddUnion(s1, s2)), useMP);
+
+    for (int k = 1; k <= 4; k += 3) {
+        options.processes = k;
+        DdStructure<2> q(zddLookahead(zddUnion(s1, s2)), options);
+        ASSERT_EQ(p.size(), q.size());
+        ASSERT_EQ(p.evaluate(ZddCardinality<>()),
+                q.evaluate(ZddCardinality<>()));
+        q.zddReduce();
+        DdStructure<2> r = p;
+        r.zddReduce();
+        ASSERT_EQ(r, q);
+    }
+
+    options.reduction = ZDD_REDUCTION;
+    DdStructure<2> t(zddLookahead(zddUnion(s1, s2)), options);
+    p.zddReduce();
+    ASSERT_EQ(p, t);
+}
+
+TEST(BuildOptionsTest, UnsupportedOptions) {
+    IntRange const r(5, 15);
+    SizeConstraint const spec(20, r);
+    DdStructure<2> p(spec);
+    p.zddReduce();
+
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    options.maxWidth = 1000;
+    options.spillMemory = 1024;
+    DdStructure<2> q(spec, options);
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+
+    options.processes = 2;
+    ASSERT_THROW(DdStructure<2>(spec, options), std::runtime_error);
+    options.spillMemory = 0;
+    options.maxWidth = 0;
+    options.checkpointFile = "testBuildOptions.ckp";
+    ASSERT_THROW(DdStructure<2>(spec, options), std::runtime_error);
+    options.checkpointFile.clear();
+    options.timeLimit = 1000;
+    ASSERT_THROW(DdStructure<2>(spec, options), std::runtime_error);
+    options.timeLimit = 0;
+    ASSERT_NO_THROW(DdStructure<2>(spec, options));
+
+    options.depthFirst = true;
+    ASSERT_THROW(DdStructure<2>(spec, options), std::runtime_error);
+    options.processes = 0;
+    options.eagerDedup = true;
+    ASSERT_THROW(DdStructure<2>(spec, options), std::runtime_error);
+    options.depthFirst = false;
+    options.maxWidth = 1000;
+    ASSERT_THROW(DdStructure<2>(spec, options), std::runtime_error);
+    options.eagerDedup = false;
+    options.maxWidth = 0;
+    options.spillMemory = 1024;
+    options.checkpointFile = "testBuildOptions.ckp";
+    ASSERT_THROW(DdStructure<2>(spec, options), std::runtime_error);
+    ASSERT_FALSE(DdCheckpointFile::exists(options.checkpointFile));
+}
+
+TEST(BuildOptionsTest, NumaPlacement) {
+    ASSERT_LE(1, NumaPlacement::numNodes());
+    IntRange const r1(3, 120);
+    IntRange const r2(8, 170, 3);
+    SizeConstraint const s1(200, r1);
+    SizeConstraint const s2(200, r2);
+    DdStructure<2> p(zddLookahead(zddUnion(s1, s2)), useMP);
+
+    bool old = NumaPlacement::enable();
+    DdStructure<2> q(zddLookahead(zddUnion(s1, s2)), useMP);
+    p.zddReduce();
+    q.zddReduce();
+    NumaPlacement::enable(old);
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.evaluate(ZddCardinality<>()), q.evaluate(ZddCardinality<>()));
+}
+
+TEST(BuildOptionsTest, NodeIdLayout) {
+    ASSERT_EQ(size_t(NODE_CODE_BITS / 8), sizeof(NodeId));
+    NodeId f(NODE_ROW_MAX, NODE_COL_MAX, true);
+    ASSERT_EQ(int(NODE_ROW_MAX), f.row());
+    ASSERT_EQ(size_t(NODE_COL_MAX), f.col());
+    ASSERT_TRUE(f.getAttr());
+    ASSERT_EQ(NodeId(NODE_ROW_MAX, NODE_COL_MAX), f);
+
+    ASSERT_TRUE(nodeIdFits(NODE_ROW_MAX, size_t(NODE_COL_MAX) + 1));
+    ASSERT_FALSE(nodeIdFits(NODE_ROW_MAX + 1, 0));
+    ASSERT_NO_THROW(checkNodeId(NODE_ROW_MAX, 0));
+    ASSERT_THROW(checkNodeId(1, size_t(NODE_COL_MAX) + 2), std::runtime_error);
+
+    IntRange const r(0, 1);
+    ASSERT_THROW(DdStructure<2>(SizeConstraint(NODE_ROW_MAX + 1, r), useMP),
+            std::runtime_error);
+}
@@ -0,0 +1,126 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <tdzdd/DdForest.hpp>
+#include <tdzdd/DdSpecOp.hpp>
+#include <tdzdd/DdStructure.hpp>
+#include <tdzdd/spec/SizeConstraint.hpp>
+
+#include "RandomDd.hpp"
+
+using namespace tdzdd;
+
+extern bool useMP;
+
+TEST(DdForestTest, Sharing) {
+    DdForest<2> forest;
+    IntRange const r1(3, 12);
+    IntRange const r2(8, 17, 3);
+    SizeConstraint const s1(20, r1);
+    SizeConstraint const s2(20, r2);
+
+    DdForest<2>::Root a = forest.add(s1, useMP);
+    size_t const n = forest.size();
+    DdForest<2>::Root b = forest.add(s1);
+    ASSERT_EQ(n, forest.size());
+    ASSERT_TRUE(a == b);
+    ASSERT_EQ(a.id(), b.id());
+
+    DdForest<2>::Root c = forest.add(s2, useMP);
+    ASSERT_TRUE(a != c);
+    ASSERT_EQ(3U, forest.numRoots());
+
+    DdStructure<2> p(s1, useMP);
+    p.zddReduce();
+    DdStructure<2> q(a, useMP);
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.size(), q.size());
+
+    DdForest<2>::Root d = forest.add(zddUnion(a, c), useMP);
+    DdStructure<2> t(zddUnion(s1, s2), useMP);
+    t.zddReduce();
+    ASSERT_EQ(t.zddCardinality(), DdStructure<2>(d).zddCardinality());
+    ASSERT_TRUE(d == forest.add(t));
+    ASSERT_TRUE(a == forest.add(zddIntersection(d, a)));
+
+    DdForest<2>::Root e;
+    ASSERT_TRUE(e == forest.add(zddIntersection(a, DdStructure<2>())));
+    ASSERT_TRUE(e != forest.add(DdStructure<2>(0)));
+}
+
+TEST(DdForestTest, GarbageCollection) {
+    DdForest<2> forest;
+    MyVector<DdStructure<2> > dds;
+    MyVector<DdForest<2>::Root> roots;
+
+    for (int k = 0; k < 20; ++k) {
+        DdStructure<2> dd(RandomDd<2>(50, 100, 0.3), useMP);
+        roots.push_back(forest.add(dd));
+        dd.zddReduce();
+        dds.push_back(dd);
+    }
+    size_t const n = forest.size();
+    ASSERT_EQ(20U, forest.numRoots());
+
+    for (int k = 0; k < 20; k += 2) {
+        roots[k] = DdForest<2>::Root();
+    }
+    ASSERT_EQ(10U, forest.numRoots());
+    forest.gc();
+    ASSERT_GE(n, forest.size());
+
+    for (int k = 1; k < 20; k += 2) {
+        DdStructure<2> dd(roots[k], useMP);
+        dd.zddReduce();
+        ASSERT_EQ(dds[k], dd);
+        ASSERT_EQ(dds[k].size(), dd.size());
+        ASSERT_TRUE(roots[k] == forest.add(dds[k]));
+    }
+
+    roots.clear();
+    forest.gc();
+    ASSERT_EQ(0U, forest.numRoots());
+    ASSERT_EQ(0U, forest.size());
+}
+
+TEST(DdForestTest, BddReduction) {
+    DdForest<3> forest(BDD_REDUCTION);
+    for (int k = 0; k < 10; ++k) {
+        DdStructure<3> dd(RandomDd<3>(30, 100, 0.3), useMP);
+        DdForest<3>::Root a = forest.add(dd);
+        dd.bddReduce();
+        DdStructure<3> p(a, useMP);
+        p.bddReduce();
+        ASSERT_EQ(dd, p);
+        ASSERT_EQ(dd.size(), p.size());
+        ASSERT_EQ(dd.bddCardinality(30), p.bddCardinality(30));
+    }
+
+    DdReduction const qdd = QDD_REDUCTION;
+    ASSERT_THROW(DdForest<2> f(qdd), std::runtime_error);
+}
@@ -0,0 +1,157 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <tdzdd/DdSpec.hpp>
+#include <tdzdd/DdStructure.hpp>
+
+using namespace tdzdd;
+
+extern bool useMP;
+
+namespace {
+
+/*
+ * Subsets of items whose total weight is not more than the capacity;
+ * the weight of the item at each level can be changed.
+ */
+class WeightLimit: public DdSpec<WeightLimit,int,2> {
+    std::vector<int> weight;
+    int const capacity;
+
+public:
+    WeightLimit(int n, int capacity)
+            : weight(n + 1), capacity(capacity) {
+        for (int i = 1; i <= n; ++i) {
+            weight[i] = (i * 7) % 11 + 1;
+        }
+    }
+
+    void change(int lo, int hi, int d) {
+        for (int i = lo; i <= hi; ++i) {
+            weight[i] += d;
+        }
+    }
+
+    int getRoot(int& total) const {
+        total = 0;
+        return weight.size() - 1;
+    }
+
+    int getChild(int& total, int level, int value) const {
+        if (value) {
+            total += weight[level];
+            if (total > capacity) return 0;
+        }
+        return (level == 1) ? -1 : level - 1;
+    }
+};
+
+void expectSame(DdStructure<2> const& dd, WeightLimit const& spec) {
+    DdStructure<2> p(spec);
+    DdStructure<2> q = dd;
+    p.zddReduce();
+    q.zddReduce();
+    EXPECT_EQ(p, q);
+    EXPECT_EQ(p.evaluate(ZddCardinality<>()), q.evaluate(ZddCardinality<>()));
+}
+
+} // namespace
+
+TEST(IncrementalTest, Rebuild) {
+    DdBuilderOptions options;
+    WeightLimit spec(60, 100);
+    DdStateArchive<WeightLimit> archive("testIncremental", 8);
+    DdStructure<2> dd(spec, archive, options);
+    expectSame(dd, spec);
+
+    spec.change(3, 5, 2);
+    dd.rebuild(spec, archive, 3, 5, options);
+    expectSame(dd, spec);
+
+    spec.change(50, 58, -1);
+    dd.rebuild(spec, archive, 50, 58, options);
+    expectSame(dd, spec);
+
+    spec.change(20, 30, 3);
+    dd.rebuild(spec, archive, 20, 30, options);
+    expectSame(dd, spec);
+
+    spec.change(4, 4, -2);
+    dd.rebuild(spec, archive, 4, 4, options);
+    expectSame(dd, spec);
+
+    spec.change(60, 60, 5);
+    dd.rebuild(spec, archive, 60, 60, options);
+    expectSame(dd, spec);
+}
+
+TEST(IncrementalTest, Reduction) {
+    DdBuilderOptions options;
+    options.reduction = ZDD_REDUCTION;
+    WeightLimit spec(60, 100);
+    DdStateArchive<WeightLimit> archive("testIncremental", 8);
+    DdStructure<2> dd(spec, archive, options);
+    expectSame(dd, spec);
+
+    for (int k = 0; k < 6; ++k) {
+        int const lo = (k * 23) % 50 + 1;
+        int const hi = lo + k;
+        spec.change(lo, hi, (k % 2) ? 2 : -1);
+        dd.rebuild(spec, archive, lo, hi, options);
+        expectSame(dd, spec);
+    }
+}
+
+TEST(IncrementalTest, FrontierFiles) {
+    WeightLimit spec(40, 80);
+    std::string path;
+    {
+        DdStateArchive<WeightLimit> archive("testIncremental", 10);
+        DdStructure<2> dd(spec, archive);
+        ASSERT_EQ(30, archive.frontierAbove(25));
+        path = archive.frontierPath(30);
+        ASSERT_TRUE(DdCheckpointFile::exists(path));
+
+        spec.change(25, 28, 1);
+        dd.rebuild(spec, archive, 25, 28);
+        expectSame(dd, spec);
+        ASSERT_EQ(30, archive.frontierAbove(1));
+
+        spec.change(35, 35, 1);
+        dd.rebuild(spec, archive, 35, 35);
+        expectSame(dd, spec);
+        ASSERT_EQ(10, archive.frontierAbove(1));
+
+        spec.change(3, 3, 1);
+        dd.rebuild(spec, archive, 3, 3);
+        expectSame(dd, spec);
+        ASSERT_EQ(10, archive.frontierAbove(1));
+    }
+    ASSERT_FALSE(DdCheckpointFile::exists(path));
+}
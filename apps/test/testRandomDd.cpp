@@ -24,7 +24,11 @@
 
 #include <gtest/gtest.h>
 
+#include <map>
+#include <vector>
+
 #include <tdzdd/DdStructure.hpp>
+#include <tdzdd/eval/OptimalWeight.hpp>
 
 #include "RandomDd.hpp"
 
@@ -94,3 +98,422 @@ TEST(RandomDdTest, NinetyNineAry) {
         do_test<99>(10, 1000, 0.3);
     }
 }
+
+template<int A, bool BDD, bool ZDD>
+void do_radix_test(DdStructure<A> const& dd, bool exact) {
+    NodeTableHandler<A> p = dd.getDiagram();
+    NodeTableHandler<A> q = dd.getDiagram();
+    NodeId f = dd.root();
+    NodeId g = dd.root();
+    {
+        DdReducer<A,BDD,ZDD> zr(p, false);
+        zr.setRoot(f);
+        for (int i = 1; i <= dd.topLevel(); ++i) {
+            zr.reduce(i, false);
+        }
+    }
+    {
+        DdReducer<A,BDD,ZDD> zr(q, useMP);
+        zr.useRadixSort();
+        zr.setRoot(g);
+        for (int i = 1; i <= dd.topLevel(); ++i) {
+            zr.reduce(i, useMP);
+        }
+    }
+    ASSERT_EQ(f, g);
+    ASSERT_EQ(p->size(), q->size());
+    if (!exact) return;
+
+    for (int i = 1; i <= dd.topLevel(); ++i) {
+        ASSERT_EQ((*p)[i].size(), (*q)[i].size());
+        for (size_t j = 0; j < (*p)[i].size(); ++j) {
+            ASSERT_EQ((*p)[i][j], (*q)[i][j]);
+        }
+    }
+}
+
+TEST(RandomDdTest, RadixReduction) {
+    for (int i = 0; i < 10; ++i) {
+        DdStructure<2> dd(RandomDd<2>(100, 1000, 0.3), useMP);
+        do_radix_test<2,false,true>(dd, true);
+        do_radix_test<2,true,false>(dd, true);
+    }
+
+    for (int i = 0; i < 10; ++i) {
+        DdStructure<3> dd(RandomDd<3>(100, 1000, 0.3), useMP);
+        DdStructure<3> p = dd;
+        DdStructure<3> q = dd;
+        p.useMultiProcessors(false);
+        q.useMultiProcessors(true);
+        p.zddReduce();
+        q.zddReduce();
+        ASSERT_EQ(p, q);
+        p = dd;
+        q = dd;
+        p.useMultiProcessors(false);
+        q.useMultiProcessors(true);
+        p.bddReduce();
+        q.bddReduce();
+        ASSERT_EQ(p, q);
+        do_radix_test<3,false,true>(dd, false);
+    }
+}
+
+template<int A>
+void check_same_order(DdStructure<A> const& p, DdStructure<A> const& q) {
+    NodeTableEntity<A> const& tp = *p.getDiagram();
+    NodeTableEntity<A> const& tq = *q.getDiagram();
+    ASSERT_EQ(p.root(), q.root());
+    ASSERT_EQ(tp.numRows(), tq.numRows());
+    for (int i = 1; i < tp.numRows(); ++i) {
+        ASSERT_EQ(tp[i].size(), tq[i].size());
+        for (size_t j = 0; j < tp[i].size(); ++j) {
+            ASSERT_EQ(tp[i][j], tq[i][j]);
+        }
+    }
+}
+
+template<int A>
+void do_wavefront_test(DdStructure<A> const& dd) {
+    DdStructure<A> p = dd;
+    DdStructure<A> q = dd;
+    DdStructure<A> r = dd;
+    p.useMultiProcessors(false);
+    q.useMultiProcessors(true);
+    q.useWavefrontReduction();
+    r.useMultiProcessors(true);
+    p.zddReduce();
+    q.zddReduce();
+    r.zddReduce();
+    ASSERT_EQ(p.size(), q.size());
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.zddCardinality(), q.zddCardinality());
+    if (A == 2) check_same_order(p, r);
+
+    p = dd;
+    q = dd;
+    p.useMultiProcessors(false);
+    q.useMultiProcessors(true);
+    q.useWavefrontReduction();
+    p.bddReduce();
+    q.bddReduce();
+    ASSERT_EQ(p.size(), q.size());
+    ASSERT_EQ(p, q);
+}
+
+TEST(RandomDdTest, WavefrontReduction) {
+    for (int i = 0; i < 10; ++i) {
+        do_wavefront_test(DdStructure<2>(RandomDd<2>(1000, 10, 0.3), useMP));
+        do_wavefront_test(DdStructure<3>(RandomDd<3>(100, 100, 0.3), useMP));
+    }
+    do_wavefront_test(DdStructure<2>(RandomDd<2>(10, 20000, 0.3), useMP));
+}
+
+template<int A>
+void check_capacity(DdStructure<A> const& dd) {
+    NodeTableEntity<A> const& table = *dd.getDiagram();
+    for (int i = 1; i < table.numRows(); ++i) {
+        ASSERT_EQ(table[i].size(), table[i].capacity());
+    }
+}
+
+template<int A>
+void do_low_memory_test(DdStructure<A> const& dd) {
+    DdStructure<A> p = dd;
+    DdStructure<A> q = dd;
+    q.useLowMemoryReduction();
+    p.zddReduce();
+    q.zddReduce();
+    check_capacity(q);
+    ASSERT_EQ(p.size(), q.size());
+    ASSERT_EQ(p, q);
+    ASSERT_EQ(p.zddCardinality(), q.zddCardinality());
+
+    p = dd;
+    q = dd;
+    q.useLowMemoryReduction();
+    p.bddReduce();
+    q.bddReduce();
+    check_capacity(q);
+    ASSERT_EQ(p.size(), q.size());
+    ASSERT_EQ(p, q);
+
+    p = dd;
+    q = dd;
+    q.useLowMemoryReduction();
+    p.qddReduce();
+    q.qddReduce();
+    ASSERT_LE(q.size(), p.size());
+    ASSERT_EQ(p.zddCardinality(), q.zddCardinality());
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+}
+
+TEST(RandomDdTest, LowMemoryReduction) {
+    for (int i = 0; i < 10; ++i) {
+        do_low_memory_test(DdStructure<2>(RandomDd<2>(100, 1000, 0.3), useMP));
+        do_low_memory_test(DdStructure<3>(RandomDd<3>(100, 100, 0.3), useMP));
+    }
+}
+
+TEST(RandomDdTest, BinaryFile) {
+    std::string const path = "testRandomDd.bin";
+    DdStructure<2> p(RandomDd<2>(100, 1000, 0.3), useMP);
+    DdStructure<2> r = p;
+    r.zddReduce();
+    p.dumpBinary(path);
+
+    DdStructure<2> q;
+    q.mapBinary(path);
+    ASSERT_EQ(p.size(), q.size());
+    ASSERT_EQ(p.root(), q.root());
+    ASSERT_EQ(p.zddCardinality(), q.zddCardinality());
+
+    DdStructure<2> s(q, useMP);
+    s.zddReduce();
+    ASSERT_EQ(r, s);
+
+    q.zddReduce();
+    ASSERT_EQ(r, q);
+    q.mapBinary(path);
+    ASSERT_EQ(p.size(), q.size());
+    q.zddReduce();
+    ASSERT_EQ(r, q);
+
+    r.dumpBinary(path);
+    q.mapBinary(path);
+    ASSERT_EQ(r, q);
+    DdStructure<2>::const_iterator a = r.begin();
+    DdStructure<2>::const_iterator b = q.begin();
+    for (int k = 0; k < 100 && a != r.end(); ++k, ++a, ++b) {
+        ASSERT_TRUE(b != q.end());
+        ASSERT_EQ(*a, *b);
+    }
+
+    DdStructure<3> t;
+    ASSERT_THROW(t.mapBinary(path), std::runtime_error);
+    ASSERT_THROW(q.mapBinary(path + ".none"), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+template<int A>
+void do_columns_test(DdStructure<A> const& dd, int n) {
+    NodeColumns<A> columns(*dd.getDiagram(), useMP);
+    ASSERT_EQ(dd.evaluate(ZddCardinality<uint64_t,A>()),
+            dd.evaluate(ZddCardinality<uint64_t,A>(), columns));
+    ASSERT_EQ(dd.evaluate(BddCardinality<uint64_t,A>(n)),
+            dd.evaluate(BddCardinality<uint64_t,A>(n), columns));
+    ASSERT_EQ(dd.zddCardinality(),
+            dd.evaluate(ZddCardinality<std::string,A>(), columns));
+    ASSERT_EQ(dd.bddCardinality(n),
+            dd.evaluate(BddCardinality<std::string,A>(n), columns));
+}
+
+TEST(RandomDdTest, NodeColumns) {
+    for (int i = 0; i < 10; ++i) {
+        DdStructure<2> p(RandomDd<2>(100, 1000, 0.3), useMP);
+        do_columns_test(p, 100);
+        p.zddReduce();
+        do_columns_test(p, 100);
+
+        std::vector<int> weight(101);
+        for (int j = 0; j <= 100; ++j) {
+            weight[j] = (j * 37) % 11 - 5;
+        }
+        NodeColumns<2> columns(*p.getDiagram());
+        ASSERT_EQ(p.evaluate(ZddMaxWeight<int>(weight)),
+                p.evaluate(ZddMaxWeight<int>(weight), columns));
+
+        DdStructure<3> q(RandomDd<3>(100, 100, 0.3), useMP);
+        q.bddReduce();
+        do_columns_test(q, 100);
+    }
+
+    DdStructure<2> p(10);
+    DdStructure<2> q(20);
+    NodeColumns<2> columns(*p.getDiagram());
+    ASSERT_THROW(q.evaluate(ZddCardinality<>(), columns), std::runtime_error);
+}
+
+TEST(RandomDdTest, CopyOnWrite) {
+    DdStructure<2> p(RandomDd<2>(100, 1000, 0.3), useMP);
+    DdStructure<2> r(p, useMP);
+    DdStructure<2> t(p, useMP);
+    r.zddReduce();
+    t.bddReduce();
+
+    DdStructure<2> q = p;
+    NodeTableEntity<2>& e = q.getDiagram().privateEntity();
+    NodeTableEntity<2> const& ce = e;
+    NodeTableEntity<2> const& pe = *p.getDiagram();
+    ASSERT_NE(&pe, &ce);
+    for (int i = 1; i <= 100; ++i) {
+        ASSERT_EQ(pe[i].data(), ce[i].data());
+    }
+
+    int const k = q.root().row();
+    NodeId const f = e[k][0].branch[0];
+    e[k][0].branch[0] = 0;
+    ASSERT_EQ(f, pe[k][0].branch[0]);
+    ASSERT_NE(pe[k].data(), ce[k].data());
+    for (int i = 1; i < k; ++i) {
+        ASSERT_EQ(pe[i].data(), ce[i].data());
+    }
+    e[k][0].branch[0] = f;
+    ASSERT_EQ(pe[k].size(), ce[k].size());
+    for (size_t j = 0; j < ce[k].size(); ++j) {
+        ASSERT_EQ(pe[k][j], ce[k][j]);
+    }
+
+    DdStructure<2> s = q;
+    q.zddReduce();
+    s.bddReduce();
+    ASSERT_EQ(r, q);
+    ASSERT_EQ(t, s);
+    p.zddReduce();
+    ASSERT_EQ(r, p);
+}
+
+TEST(RandomDdTest, ConcurrentQueries) {
+    int const T = 8;
+    DdStructure<2> p(RandomDd<2>(100, 1000, 0.3), useMP);
+    p.zddReduce();
+    DdStructure<2> r(p, false);
+    r.zddReduce();
+    std::string const card = r.zddCardinality();
+    size_t items = 0;
+    for (DdStructure<2>::const_iterator t = r.begin(); t != r.end(); ++t) {
+        items += t->size();
+        if (items >= 10000) break;
+    }
+
+    MyVector<std::string> cards(T);
+    MyVector<size_t> counts(T);
+    MyVector<DdStructure<2> > copies(T);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(T)
+#endif
+    for (int k = 0; k < T; ++k) {
+        DdStructure<2> q = p;
+        cards[k] = q.zddCardinality();
+        counts[k] = 0;
+        for (DdStructure<2>::const_iterator t = p.begin(); t != p.end(); ++t) {
+            counts[k] += t->size();
+            if (counts[k] >= 10000) break;
+        }
+        copies[k] = DdStructure<2>(p, false);
+        copies[k].zddReduce();
+    }
+
+    for (int k = 0; k < T; ++k) {
+        ASSERT_EQ(card, cards[k]);
+        ASSERT_EQ(items, counts[k]);
+        ASSERT_EQ(r, copies[k]);
+    }
+}
+
+template<int A>
+struct PathCount: public DdTopDownEval<PathCount<A>,uint64_t> {
+    void evalRoot(uint64_t& v) const {
+        v = 1;
+    }
+
+    void evalArc(uint64_t& v, int level, uint64_t const& u, int parentLevel,
+                 int b) const {
+        v += u;
+    }
+
+    void mergeValues(uint64_t& v, uint64_t const& w) const {
+        v += w;
+    }
+};
+
+struct PassCount: public DdTopDownEval<PassCount,uint64_t> {
+    DataTable<uint64_t>* through;
+
+    PassCount(DataTable<uint64_t>& through) :
+            through(&through) {
+    }
+
+    void evalRoot(uint64_t& v) const {
+        v = 1;
+    }
+
+    void evalArc(uint64_t& v, int level, uint64_t const& u, int parentLevel,
+                 int b) const {
+        v += u;
+    }
+
+    void mergeValues(uint64_t& v, uint64_t const& w) const {
+        v += w;
+    }
+
+    void visitNode(uint64_t const& v, uint64_t const& w, int level,
+                   size_t col) const {
+        (*through)[level][col] = v * w;
+    }
+};
+
+static void countPasses(DdStructure<2> const& dd, NodeId f,
+                        std::vector<NodeId>& path,
+                        std::map<NodeId,uint64_t>& count) {
+    if (f.row() == 0) {
+        if (f == 1) {
+            for (size_t k = 0; k < path.size(); ++k) {
+                ++count[path[k]];
+            }
+        }
+        return;
+    }
+    path.push_back(f);
+    for (int b = 0; b < 2; ++b) {
+        countPasses(dd, dd.child(f, b), path, count);
+    }
+    path.pop_back();
+}
+
+TEST(RandomDdTest, TopDown) {
+    for (int i = 0; i < 10; ++i) {
+        DdStructure<2> p(RandomDd<2>(100, 1000, 0.3), useMP);
+        ASSERT_EQ(p.evaluate(ZddCardinality<uint64_t,2>()),
+                p.evaluate(PathCount<2>()));
+        p.zddReduce();
+        ASSERT_EQ(p.evaluate(ZddCardinality<uint64_t,2>()),
+                p.evaluate(PathCount<2>()));
+
+        DdStructure<3> q(RandomDd<3>(100, 100, 0.3), useMP);
+        ASSERT_EQ(q.evaluate(ZddCardinality<uint64_t,3>()),
+                q.evaluate(PathCount<3>()));
+    }
+
+    DdStructure<2> e(0, useMP);
+    ASSERT_EQ(e.evaluate(ZddCardinality<uint64_t,2>()),
+            e.evaluate(PathCount<2>()));
+}
+
+TEST(RandomDdTest, ForwardBackward) {
+    for (int i = 0; i < 10; ++i) {
+        DdStructure<2> p(RandomDd<2>(14, 30, 0.3), useMP);
+        if (i % 2) p.zddReduce();
+        NodeTableEntity<2> const& table = *p.getDiagram();
+
+        DataTable<uint64_t> through(table.numRows());
+        for (int ii = 0; ii < table.numRows(); ++ii) {
+            through[ii].resize(table[ii].size());
+        }
+        ASSERT_EQ(p.evaluate(ZddCardinality<uint64_t,2>()),
+                p.forwardBackward(PassCount(through),
+                        ZddCardinality<uint64_t,2>()));
+
+        std::vector<NodeId> path;
+        std::map<NodeId,uint64_t> count;
+        countPasses(p, p.root(), path, count);
+        for (int ii = 1; ii < table.numRows(); ++ii) {
+            for (size_t j = 0; j < table[ii].size(); ++j) {
+                ASSERT_EQ(count[NodeId(ii, j)], through[ii][j]);
+            }
+        }
+    }
+}
@@ -25,6 +25,7 @@
 #include <gtest/gtest.h>
 
 #include <climits>
+#include <vector>
 
 #include <tdzdd/DdStructure.hpp>
 #include <tdzdd/DdSpecOp.hpp>
@@ -146,3 +147,37 @@ TEST(SizeConstraintTest, ZDD) {
     ASSERT_EQ(3, zr.evaluate(MinNumItems()));
     ASSERT_EQ(9, zr.evaluate(MaxNumItems()));
 }
+
+TEST(SizeConstraintTest, MultiSubset) {
+    IntRange const r0(3, 15);
+    IntRange const r1(0, 4);
+    IntRange const r2(5, 20, 3);
+    IntRange const r3(16, 20);
+    IntRange const r4(2, 8);
+    IntRange const r5(10, 12);
+    DdStructure<2> base(SizeConstraint(20, r0), useMP);
+    base.zddReduce();
+
+    std::vector<SizeConstraint> specs;
+    specs.push_back(SizeConstraint(20, r1));
+    specs.push_back(SizeConstraint(20, r2));
+    specs.push_back(SizeConstraint(20, r3));
+    specs.push_back(SizeConstraint(12, r4));
+    specs.push_back(SizeConstraint(25, r5));
+
+    std::vector<DdStructure<2> > results = base.zddSubsets(specs);
+    ASSERT_EQ(specs.size(), results.size());
+
+    for (size_t k = 0; k < specs.size(); ++k) {
+        DdStructure<2> p = base;
+        p.zddSubset(specs[k]);
+        DdStructure<2> q = results[k];
+        ASSERT_EQ(p.size(), q.size());
+        p.zddReduce();
+        q.zddReduce();
+        ASSERT_EQ(p, q);
+        ASSERT_EQ(p.evaluate(ZddCardinality<>()),
+                q.evaluate(ZddCardinality<>()));
+    }
+    ASSERT_EQ(0, results[2].evaluate(ZddCardinality<int>()));
+}
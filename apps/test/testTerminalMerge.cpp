@@ -0,0 +1,153 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <tdzdd/DdSpec.hpp>
+#include <tdzdd/DdStructure.hpp>
+
+using namespace tdzdd;
+
+extern bool useMP;
+
+namespace {
+
+/*
+ * Subsets of at least k items out of n, of which only the smallest ones
+ * are kept by merging the states at the 1-terminal.
+ */
+class MinimumSubsets: public DdSpec<MinimumSubsets,int,2> {
+    int const n;
+    int const k;
+
+public:
+    MinimumSubsets(int n, int k)
+            : n(n), k(k) {
+    }
+
+    int getRoot(int& count) const {
+        count = 0;
+        return n;
+    }
+
+    int getChild(int& count, int level, int value) const {
+        count += value;
+        if (level == 1) return (count >= k) ? -1 : 0;
+        return level - 1;
+    }
+
+    int mergeStates(int& count1, int& count2) const {
+        return (count1 > count2) ? 1 : (count1 < count2) ? 2 : 0;
+    }
+};
+
+/*
+ * Subsets of n items whose 1-terminal states are merged in an
+ * order-sensitive way: the kept state accumulates a digest of the merged
+ * ones, and a new state is dropped when it matches the current digest.
+ * All states are kept if merge is false.
+ */
+class DigestSubsets: public DdSpec<DigestSubsets,int,2> {
+    int const n;
+    bool const merge;
+
+public:
+    explicit DigestSubsets(int n, bool merge = true)
+            : n(n), merge(merge) {
+    }
+
+    int getRoot(int& sum) const {
+        sum = 0;
+        return n;
+    }
+
+    int getChild(int& sum, int level, int value) const {
+        sum += value * level * level;
+        if (level == 1) return (sum % 5 == 0) ? 0 : -1;
+        return level - 1;
+    }
+
+    int mergeStates(int& sum1, int& sum2) const {
+        if (!merge) return 0;
+        if (sum1 == sum2) return 0; // identical states at an inner level
+        if ((sum1 + sum2) % 3 == 0) return 2;
+        sum1 = (sum1 * 7 + sum2) % 1009;
+        return 0;
+    }
+};
+
+}
+
+TEST(TerminalMergeTest, Construction) {
+    MinimumSubsets const spec(30, 12);
+    DdStructure<2> p(spec);
+    DdStructure<2> q(spec, useMP);
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+    ASSERT_EQ("86493225", p.zddCardinality());
+
+    DdBuilderOptions options;
+    options.processes = 3;
+    DdStructure<2> r(spec, options);
+    r.zddReduce();
+    ASSERT_EQ(p, r);
+}
+
+TEST(TerminalMergeTest, Subsetting) {
+    MinimumSubsets const spec(30, 12);
+    DdStructure<2> p(spec);
+    DdStructure<2> q(30, useMP);
+    q.zddSubset(spec);
+    p.zddReduce();
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+}
+
+TEST(TerminalMergeTest, OrderSensitiveMerge) {
+    DigestSubsets const spec(16);
+    DdStructure<2> p(spec);
+    p.zddReduce();
+    DdStructure<2> q(spec);
+    q.zddReduce();
+    ASSERT_EQ(p, q);
+
+    DdStructure<2> all(DigestSubsets(16, false));
+    all.zddReduce();
+    ASSERT_NE(p, all);
+
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    for (int k = 0; k < 4; ++k) {
+        options.sharedUniqTable = (k % 2 != 0);
+        options.hashCache = (k >= 2);
+        DdStructure<2> r(spec, options);
+        r.zddReduce();
+        DdStructure<2> t = r;
+        t.zddSubset(all);
+        t.zddReduce();
+        ASSERT_EQ(r, t);
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <tdzdd/DdSpec.hpp>
+#include <tdzdd/DdSpecOp.hpp>
+#include <tdzdd/DdStructure.hpp>
+#include <tdzdd/eval/OptimalWeight.hpp>
+
+using namespace tdzdd;
+
+extern bool useMP;
+
+namespace {
+
+/*
+ * Knapsack problem; the state is the total size of the selected items.
+ * A smaller state has more room for the remaining items.
+ */
+class Knapsack: public DdSpec<Knapsack,int,2> {
+    std::vector<int> const& size;
+    int const capacity;
+
+public:
+    Knapsack(std::vector<int> const& size, int capacity)
+            : size(size), capacity(capacity) {
+    }
+
+    int getRoot(int& used) const {
+        used = 0;
+        return size.size() - 1;
+    }
+
+    int getChild(int& used, int level, int value) const {
+        if (value) {
+            used += size[level];
+            if (used > capacity) return 0;
+        }
+        return (level == 1) ? -1 : level - 1;
+    }
+
+    bool preferState(int const& used1, int const& used2, int level) const {
+        return used1 < used2;
+    }
+
+    void relaxStates(int& used1, int& used2, int level) {
+        if (used2 < used1) used1 = used2;
+    }
+};
+
+size_t maxWidth(DdStructure<2> const& dd) {
+    size_t w = 0;
+    for (int i = 1; i <= dd.topLevel(); ++i) {
+        w = std::max(w, (*dd.getDiagram())[i].size());
+    }
+    return w;
+}
+
+}
+
+TEST(WidthLimitTest, RestrictedAndRelaxed) {
+    int const n = 40;
+    std::vector<int> size(n + 1), value(n + 1);
+    for (int i = 1; i <= n; ++i) {
+        size[i] = i * 37 % 23 + 5;
+        value[i] = i * 53 % 31 + 1;
+    }
+    Knapsack const spec(size, 150);
+
+    DdStructure<2> exact(spec, useMP);
+    exact.zddReduce();
+    long long const opt = exact.evaluate(ZddMaxWeight<>(value));
+
+    DdBuilderOptions options;
+    options.useMP = useMP;
+    options.maxWidth = 8;
+    DdStructure<2> restricted(spec, options);
+    ASSERT_GE(size_t(8), maxWidth(restricted));
+    restricted.zddReduce();
+    ASSERT_GE(opt, restricted.evaluate(ZddMaxWeight<>(value)));
+    ASSERT_LT(0, restricted.evaluate(ZddMaxWeight<>(value)));
+    DdStructure<2> sub(zddIntersection(restricted, exact));
+    sub.zddReduce();
+    ASSERT_EQ(restricted, sub);
+
+    options.widthRule = RELAXED_DD;
+    DdStructure<2> relaxed(spec, options);
+    ASSERT_GE(size_t(8), maxWidth(relaxed));
+    relaxed.zddReduce();
+    ASSERT_LE(opt, relaxed.evaluate(ZddMaxWeight<>(value)));
+    DdStructure<2> sup(zddIntersection(relaxed, exact));
+    sup.zddReduce();
+    ASSERT_EQ(exact, sup);
+
+    ASSERT_GT(maxWidth(exact), size_t(8));
+}
@@ -0,0 +1,97 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <tdzdd/util/WorkStealingScheduler.hpp>
+
+using namespace tdzdd;
+
+TEST(WorkStealingTest, EveryIndexOnce) {
+    int const threads = 4;
+    size_t const n = 1000;
+    std::vector<size_t> cumWeight(n + 1);
+    std::vector<int> count(n);
+
+    // a few very heavy indices at the front
+    cumWeight[0] = 0;
+    for (size_t k = 0; k < n; ++k) {
+        cumWeight[k + 1] = cumWeight[k] + (k < 10 ? 10000 : 1);
+    }
+
+    WorkStealingScheduler scheduler(threads);
+    scheduler.reset(n, &cumWeight[0]);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+    {
+#ifdef _OPENMP
+        int yy = omp_get_thread_num();
+#else
+        int yy = 0;
+#endif
+        size_t begin, end;
+        while (scheduler.next(yy, begin, end)) {
+            EXPECT_LT(begin, end);
+            for (size_t k = begin; k < end; ++k) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+                ++count[k];
+            }
+        }
+    }
+
+    size_t work = 0;
+    for (int y = 0; y < threads; ++y) {
+        work += scheduler.work(y);
+    }
+    EXPECT_EQ(cumWeight[n], work);
+    for (size_t k = 0; k < n; ++k) {
+        ASSERT_EQ(1, count[k]) << "k = " << k;
+    }
+}
+
+TEST(WorkStealingTest, UnitWeights) {
+    WorkStealingScheduler scheduler(3);
+    scheduler.reset(0);
+    size_t begin, end;
+    EXPECT_FALSE(scheduler.next(0, begin, end));
+
+    scheduler.reset(7);
+    size_t total = 0;
+    for (int y = 0; y < 3; ++y) {
+        while (scheduler.next(y, begin, end)) {
+            total += end - begin;
+        }
+    }
+    EXPECT_EQ(7U, total);
+}
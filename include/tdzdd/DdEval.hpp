@@ -25,8 +25,11 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <iostream>
 
+#include "dd/Node.hpp"
+
 namespace tdzdd {
 
 /**
@@ -81,6 +84,122 @@ public:
     }
 };
 
+/**
+ * Collection of child node values/levels of a block of nodes at the same
+ * level for DdEval::evalBlock function interface.
+ * The child node IDs are given in the structure-of-arrays layout.
+ * When all the b-children of the block are at the same level,
+ * getRow(b) returns the value array of that level, which can be indexed
+ * by the columns of getBranches(b) without looking up their levels.
+ * @tparam T data type of work area for each node.
+ * @tparam ARITY the number of children for each node.
+ */
+template<typename T, int ARITY>
+class DdBlockValues {
+    T* const* rows;
+    NodeId const* branch[ARITY];
+    int commonLevel[ARITY];
+    size_t size_;
+
+public:
+    /**
+     * Constructor.
+     * @param rows value arrays indexed by levels.
+     * @param n the number of nodes in the block.
+     */
+    DdBlockValues(T* const* rows, size_t n) :
+            rows(rows), size_(n) {
+    }
+
+    /**
+     * Sets the b-th child IDs of the nodes.
+     * @param b branch index.
+     * @param f array of the b-th child IDs.
+     * @param level the common level of them, or -1 if they are mixed.
+     */
+    void setBranches(int b, NodeId const* f, int level) {
+        assert(0 <= b && b < ARITY);
+        branch[b] = f;
+        commonLevel[b] = level;
+    }
+
+    /**
+     * Returns the number of nodes in the block.
+     * @return the number of nodes.
+     */
+    size_t size() const {
+        return size_;
+    }
+
+    /**
+     * Returns the b-th child IDs of the nodes.
+     * @param b branch index.
+     * @return array of the b-th child IDs.
+     */
+    NodeId const* getBranches(int b) const {
+        assert(0 <= b && b < ARITY);
+        return branch[b];
+    }
+
+    /**
+     * Returns the level of all the b-th children if it is common.
+     * @param b branch index.
+     * @return the common level, or -1 if they are at different levels.
+     */
+    int getCommonLevel(int b) const {
+        assert(0 <= b && b < ARITY);
+        return commonLevel[b];
+    }
+
+    /**
+     * Returns the values at the level of all the b-th children.
+     * @param b branch index.
+     * @return the value array indexed by columns,
+     *         or null if the children are at different levels.
+     */
+    T const* getRow(int b) const {
+        assert(0 <= b && b < ARITY);
+        return (commonLevel[b] >= 0) ? rows[commonLevel[b]] : 0;
+    }
+
+    /**
+     * Returns the value of the b-th child of the k-th node.
+     * @param b branch index.
+     * @param k node index in the block.
+     * @return value of the child.
+     */
+    T const& get(int b, size_t k) const {
+        assert(0 <= b && b < ARITY);
+        assert(k < size_);
+        NodeId const f = branch[b][k];
+        return rows[f.row()][f.col()];
+    }
+
+    /**
+     * Returns the level of the b-th child of the k-th node.
+     * @param b branch index.
+     * @param k node index in the block.
+     * @return level of the child.
+     */
+    int getLevel(int b, size_t k) const {
+        assert(0 <= b && b < ARITY);
+        assert(k < size_);
+        return branch[b][k].row();
+    }
+
+    /**
+     * Collects the child values/levels of the k-th node.
+     * @param k node index in the block.
+     * @param values the collection to be set.
+     */
+    void getValues(size_t k, DdValues<T,ARITY>& values) const {
+        for (int b = 0; b < ARITY; ++b) {
+            values.setReference(b, get(b, k));
+            values.setLevel(b, getLevel(b, k));
+        }
+    }
+};
+
 /**
  * Base class of DD evaluators.
  *
@@ -93,6 +212,7 @@ public:
  * - void initialize(int level)
  * - R getValue(T const& work)
  * - void destructLevel(int i)
+ * - void evalBlock(T* v, int level, DdBlockValues<T,ARITY> const& values)
  *
  * @tparam E the class implementing this class.
  * @tparam T data type of work area for each node.
@@ -147,6 +267,131 @@ public:
      */
     void destructLevel(int i) {
     }
+
+    /**
+     * Evaluates a block of nodes at the same level.
+     * It is used by the evaluation on the structure-of-arrays layout.
+     * The default implementation calls evalNode() for each node.
+     * @param v work area values for the nodes.
+     * @param level the level of the nodes.
+     * @param values the child values/levels of the nodes.
+     */
+    template<int ARITY>
+    void evalBlock(T* v, int level, DdBlockValues<T,ARITY> const& values) {
+        for (size_t k = 0; k < values.size(); ++k) {
+            DdValues<T,ARITY> vals;
+            values.getValues(k, vals);
+            entity().evalNode(v[k], level, vals);
+        }
+    }
+};
+
+/**
+ * Base class of top-down DD evaluators.
+ * Values are propagated from the root to the terminals;
+ * the value of a node is accumulated from the contributions of the arcs
+ * coming into it, and it is complete when its level is reached.
+ *
+ * Every implementation must define the following functions:
+ * - void evalRoot(T& v)
+ * - void evalArc(T& v, int level, T const& u, int parentLevel, int b)
+ * - void mergeValues(T& v, T const& w)
+ *
+ * Optionally, the following functions can be overloaded:
+ * - bool isThreadSafe()
+ * - bool showMessages()
+ * - void initialize(int level)
+ * - void initValue(T& v)
+ * - void visitNode(T const& v, int level, size_t col)
+ * - void visitNode(T const& v, U const& w, int level, size_t col)
+ * - R getValue(T const& v)
+ * - void destructLevel(int i)
+ *
+ * @tparam E the class implementing this class.
+ * @tparam T data type of work area for each node.
+ * @tparam R data type of return value.
+ */
+template<typename E, typename T, typename R = T>
+class DdTopDownEval {
+public:
+    E& entity() {
+        return *static_cast<E*>(this);
+    }
+
+    E const& entity() const {
+        return *static_cast<E const*>(this);
+    }
+
+    /**
+     * Declares thread-safety.
+     * A thread-safe evaluator must implement mergeValues(), since
+     * the contributions are accumulated in separate buffers for each thread.
+     * @return true if this class is thread-safe.
+     */
+    bool isThreadSafe() const {
+        return true;
+    }
+
+    /**
+     * Declares preference to show messages.
+     * @return true if messages are preferred.
+     */
+    bool showMessages() const {
+        return false;
+    }
+
+    /**
+     * Initialization.
+     * @param level the maximum level of the DD.
+     */
+    void initialize(int level) {
+    }
+
+    /**
+     * Initializes the value of a node before any contribution is added.
+     * @param v work area value for the node.
+     */
+    void initValue(T& v) {
+        v = T();
+    }
+
+    /**
+     * Receives the complete value of a node.
+     * @param v work area value for the node.
+     * @param level the level of the node.
+     * @param col the column of the node.
+     */
+    void visitNode(T const& v, int level, size_t col) {
+    }
+
+    /**
+     * Receives the complete value of a node with its bottom-up value
+     * in the forward-backward evaluation.
+     * @param v work area value for the node.
+     * @param w bottom-up value for the node.
+     * @param level the level of the node.
+     * @param col the column of the node.
+     */
+    template<typename U>
+    void visitNode(T const& v, U const& w, int level, size_t col) {
+        entity().visitNode(v, level, col);
+    }
+
+    /**
+     * Makes a result value.
+     * @param v work area value for the 1-terminal.
+     * @return final value of the evaluation.
+     */
+    R getValue(T const& v) {
+        return R(v);
+    }
+
+    /**
+     * Destructs i-th level of data storage.
+     * @param i the level to be destructed.
+     */
+    void destructLevel(int i) {
+    }
 };
 
 } // namespace tdzdd
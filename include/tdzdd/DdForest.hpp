@@ -0,0 +1,415 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include "DdSpec.hpp"
+#include "DdStructure.hpp"
+#include "dd/DataTable.hpp"
+#include "dd/DdSweeper.hpp"
+#include "dd/Node.hpp"
+#include "dd/NodeTable.hpp"
+#include "util/MyHashTable.hpp"
+#include "util/MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Collection of reduced DDs sharing one node table.
+ * Every node is stored once in the level-indexed unique table,
+ * so that structurally identical sub-diagrams of different DDs are shared
+ * and two DDs are equivalent if and only if their root IDs are the same.
+ * The DDs are referenced by Root objects, which are reference-counted.
+ * Nodes that are not reachable from any root are removed by the level-wise
+ * garbage collection.
+ * A forest is not thread-safe and must outlive its Root objects.
+ * @tparam ARITY arity of the nodes.
+ */
+template<int ARITY>
+class DdForest {
+    static size_t const GC_RATIO = 2;
+    static size_t const GC_MIN = 1 << 16;
+
+    /*
+     * Hash function of the nodes at a level,
+     * which are identified by their column numbers plus one.
+     */
+    struct UniqHash {
+        NodeTableEntity<ARITY> const* table;
+        int level;
+
+        UniqHash(NodeTableEntity<ARITY> const* table = 0, int level = 0) :
+                table(table), level(level) {
+        }
+
+        size_t operator()(size_t j) const {
+            return (*table)[level][j - 1].hash();
+        }
+
+        bool operator()(size_t j1, size_t j2) const {
+            return (*table)[level][j1 - 1] == (*table)[level][j2 - 1];
+        }
+    };
+
+    typedef MyHashTable<size_t,UniqHash,UniqHash> UniqTable;
+
+    NodeTableEntity<ARITY> table;
+    MyVector<UniqTable> uniq;
+    MyVector<NodeId> rootId;
+    MyVector<size_t> rootRefs;
+    MyVector<size_t> freeRoots;
+    DdReduction reduction;
+    size_t gcCount;
+
+    DdForest(DdForest const&);
+    DdForest& operator=(DdForest const&);
+
+public:
+    /**
+     * Reference to a DD in a forest.
+     * It also implements DdSpec so that the DD can be used
+     * for DD construction and operations.
+     */
+    class Root: public DdSpec<Root,NodeId,ARITY> {
+        DdForest* forest;
+        size_t index;
+
+    public:
+        /**
+         * Default constructor.
+         * It refers to no forest and represents the 0-terminal.
+         */
+        Root() :
+                forest(0), index(0) {
+        }
+
+        /**
+         * Constructor.
+         * @param forest the forest.
+         * @param index index of the root slot.
+         */
+        Root(DdForest& forest, size_t index) :
+                forest(&forest), index(index) {
+            forest.ref(index);
+        }
+
+        Root(Root const& o) :
+                forest(o.forest), index(o.index) {
+            if (forest) forest->ref(index);
+        }
+
+        Root& operator=(Root const& o) {
+            if (o.forest) o.forest->ref(o.index);
+            if (forest) forest->deref(index);
+            forest = o.forest;
+            index = o.index;
+            return *this;
+        }
+
+        ~Root() {
+            if (forest) forest->deref(index);
+        }
+
+        /**
+         * Gets the root node.
+         * It may change when the garbage collection runs.
+         * @return root node ID.
+         */
+        NodeId id() const {
+            return forest ? forest->rootId[index] : NodeId(0);
+        }
+
+        /**
+         * Checks equivalence with another DD in the same forest.
+         * @param o the other root.
+         * @return true if they represent the same DD.
+         */
+        bool operator==(Root const& o) const {
+            assert(!forest || !o.forest || forest == o.forest);
+            return id() == o.id();
+        }
+
+        /**
+         * Checks inequivalence with another DD in the same forest.
+         * @param o the other root.
+         * @return true if they represent different DDs.
+         */
+        bool operator!=(Root const& o) const {
+            return !operator==(o);
+        }
+
+        /**
+         * Implements DdSpec.
+         */
+        int getRoot(NodeId& f) const {
+            f = id();
+            return (f == 1) ? -1 : f.row();
+        }
+
+        /**
+         * Implements DdSpec.
+         */
+        int getChild(NodeId& f, int level, int value) const {
+            assert(level > 0 && level == f.row());
+            assert(0 <= value && value < ARITY);
+            f = forest->table.child(f, value);
+            return (f.row() > 0) ? f.row() : -f.col();
+        }
+
+        /**
+         * Implements DdSpec.
+         */
+        size_t hashCode(NodeId const& f) const {
+            return f.hash();
+        }
+    };
+
+    friend class Root;
+
+    /**
+     * Constructor.
+     * @param reduction the reduction rules of the DDs,
+     *        which must be BDD_REDUCTION or ZDD_REDUCTION.
+     */
+    DdForest(DdReduction reduction = ZDD_REDUCTION) :
+            uniq(1), reduction(reduction), gcCount(GC_MIN) {
+        if (reduction != BDD_REDUCTION && reduction != ZDD_REDUCTION) {
+            throw std::runtime_error(
+                    "DdForest supports BDD and ZDD reduction only");
+        }
+    }
+
+    /**
+     * Gets the number of nonterminal nodes.
+     * @return the number of nonterminal nodes.
+     */
+    size_t size() const {
+        return table.size();
+    }
+
+    /**
+     * Gets the number of DDs referenced.
+     * @return the number of roots.
+     */
+    size_t numRoots() const {
+        return rootId.size() - freeRoots.size();
+    }
+
+    /**
+     * Stores a DD in the forest.
+     * The DD is reduced during the import.
+     * @param dd the DD.
+     * @return reference to the DD in the forest.
+     */
+    Root add(DdStructure<ARITY> const& dd) {
+        if (size() >= gcCount) {
+            gc();
+            gcCount = std::max(size() * GC_RATIO, size_t(GC_MIN));
+        }
+
+        NodeTableEntity<ARITY> const& diagram = *dd.getDiagram();
+        NodeId const root = dd.root();
+        int const n = root.row();
+        if (n == 0) return makeRoot(root);
+        addLevels(n);
+
+        DataTable<char> reached(n + 1);
+        for (int i = 1; i <= n; ++i) {
+            reached[i].resize(diagram[i].size());
+        }
+        reached[n][root.col()] = 1;
+
+        for (int i = n; i >= 1; --i) {
+            size_t const m = diagram[i].size();
+            for (size_t j = 0; j < m; ++j) {
+                if (!reached[i][j]) continue;
+                for (int b = 0; b < ARITY; ++b) {
+                    NodeId const f = diagram[i][j].branch[b];
+                    if (f.row() > 0) reached[f.row()][f.col()] = 1;
+                }
+            }
+        }
+
+        DataTable<NodeId> newId(n + 1);
+        newId[0].resize(2);
+        newId[0][0] = 0;
+        newId[0][1] = 1;
+
+        for (int i = 1; i <= n; ++i) {
+            size_t const m = diagram[i].size();
+            newId[i].resize(m);
+            for (size_t j = 0; j < m; ++j) {
+                if (!reached[i][j]) continue;
+                Node<ARITY> p;
+                for (int b = 0; b < ARITY; ++b) {
+                    NodeId const f = diagram[i][j].branch[b];
+                    p.branch[b] = newId[f.row()][f.col()];
+                }
+                newId[i][j] = getNode(i, p);
+            }
+            reached[i - 1].clear();
+        }
+
+        return makeRoot(newId[n][root.col()]);
+    }
+
+    /**
+     * Constructs a DD and stores it in the forest.
+     * @param spec DD spec.
+     * @param useMP use algorithms for multiple processors.
+     * @return reference to the DD in the forest.
+     */
+    template<typename SPEC>
+    Root add(DdSpecBase<SPEC,ARITY> const& spec, bool useMP = false) {
+        return add(DdStructure<ARITY>(spec, useMP));
+    }
+
+    /**
+     * Removes the nodes that are not reachable from any root.
+     * Node IDs of the roots may change.
+     */
+    void gc() {
+        int const n = table.numRows();
+        DataTable<char> reached(n);
+        for (int i = 1; i < n; ++i) {
+            reached[i].resize(table[i].size());
+        }
+        for (size_t k = 0; k < rootId.size(); ++k) {
+            NodeId const f = rootId[k];
+            if (rootRefs[k] > 0 && f.row() > 0) reached[f.row()][f.col()] = 1;
+        }
+
+        for (int i = n - 1; i >= 1; --i) {
+            size_t const m = table[i].size();
+            for (size_t j = 0; j < m; ++j) {
+                if (!reached[i][j]) continue;
+                for (int b = 0; b < ARITY; ++b) {
+                    NodeId const f = table[i][j].branch[b];
+                    if (f.row() > 0) reached[f.row()][f.col()] = 1;
+                }
+            }
+        }
+
+        DataTable<NodeId> newId(n);
+        newId[0].resize(2);
+        newId[0][0] = 0;
+        newId[0][1] = 1;
+
+        for (int i = 1; i < n; ++i) {
+            MyVector<Node<ARITY> >& row = table[i];
+            size_t const m = row.size();
+            size_t jj = 0;
+            newId[i].resize(m);
+
+            for (size_t j = 0; j < m; ++j) {
+                if (!reached[i][j]) continue;
+                Node<ARITY>& p = row[j];
+                for (int b = 0; b < ARITY; ++b) {
+                    NodeId const f = p.branch[b];
+                    p.branch[b] = newId[f.row()][f.col()];
+                }
+                newId[i][j] = NodeId(i, jj, p.branch[0].hasEmpty());
+                row[jj++] = p;
+            }
+
+            row.resize(jj);
+            reached[i].clear();
+            uniq[i].initialize(jj * 2);
+            for (size_t j = 0; j < jj; ++j) {
+                uniq[i].add(j + 1);
+            }
+        }
+
+        for (size_t k = 0; k < rootId.size(); ++k) {
+            NodeId& f = rootId[k];
+            f = (rootRefs[k] > 0) ? newId[f.row()][f.col()] : NodeId(0);
+        }
+    }
+
+private:
+    void addLevels(int n) {
+        int const old = table.numRows();
+        if (n < old) return;
+        table.setNumRows(n + 1);
+        uniq.reserve(n + 1);
+        for (int i = old; i <= n; ++i) {
+            UniqHash const h(&table, i);
+            uniq.push_back(UniqTable(h, h));
+        }
+    }
+
+    /*
+     * Gets the node ID of (a node equivalent to) p at level i,
+     * applying the node deletion rule.
+     */
+    NodeId getNode(int i, Node<ARITY> const& p) {
+        NodeId const f = (reduction == BDD_REDUCTION) ? p.branch[0] : NodeId(0);
+        bool deletable = true;
+        for (int b = 1; b < ARITY; ++b) {
+            if (p.branch[b] != f) {
+                deletable = false;
+                break;
+            }
+        }
+        if (deletable) return p.branch[0];
+
+        MyVector<Node<ARITY> >& row = table[i];
+        size_t const j = row.size();
+        checkNodeId(i, j + 1);
+        row.push_back(p);
+        size_t const k = uniq[i].add(j + 1);
+        if (k != j + 1) row.pop_back();
+        return NodeId(i, k - 1, p.branch[0].hasEmpty());
+    }
+
+    Root makeRoot(NodeId f) {
+        size_t k;
+        if (freeRoots.empty()) {
+            k = rootId.size();
+            rootId.push_back(f);
+            rootRefs.push_back(0);
+        }
+        else {
+            k = freeRoots.back();
+            freeRoots.pop_back();
+            rootId[k] = f;
+        }
+        return Root(*this, k);
+    }
+
+    void ref(size_t k) {
+        ++rootRefs[k];
+    }
+
+    void deref(size_t k) {
+        assert(rootRefs[k] > 0);
+        if (--rootRefs[k] == 0) freeRoots.push_back(k);
+    }
+};
+
+} // namespace tdzdd
@@ -52,6 +52,8 @@ namespace tdzdd {
  *
  * Optionally, the following functions can be overloaded:
  * - void printLevel(std::ostream& os, int level) const
+ * - bool prefer_state(void const* p1, void const* p2, int level) const
+ * - void relax_states(void* p1, void* p2, int level)
  *
  * A return code of get_root(void*) or get_child(void*, int, bool) is:
  * 0 when the node is the 0-terminal, -1 when it is the 1-terminal, or
@@ -61,6 +63,14 @@ namespace tdzdd {
  * one should be forwarded to the 0-terminal, 2 when they cannot be merged
  * and the second one should be forwarded to the 0-terminal.
  *
+ * prefer_state(void const*, void const*, int) and
+ * relax_states(void*, void*, int) are used only for width-bounded
+ * construction.
+ * The former tells if the first state should be kept rather than the second
+ * one when the width of a level exceeds the limit.
+ * The latter merges the second state into the first one, so that the first
+ * one represents at least all solutions of both (relaxation).
+ *
  * @tparam S the class implementing this class.
  * @tparam AR arity of the nodes.
  */
@@ -81,6 +91,13 @@ public:
         os << level;
     }
 
+    bool prefer_state(void const* p1, void const* p2, int level) const {
+        return false;
+    }
+
+    void relax_states(void* p1, void* p2, int level) {
+    }
+
     /**
      * Returns a random instance using simple depth-first search
      * without caching.
@@ -244,6 +261,8 @@ public:
  * - void construct(void* p)
  * - void getCopy(void* p, T const& state)
  * - void mergeStates(T& state1, T& state2)
+ * - bool preferState(T const& state1, T const& state2, int level) const
+ * - void relaxStates(T& state1, T& state2, int level)
  * - size_t hashCode(T const& state) const
  * - bool equalTo(T const& state1, T const& state2) const
  * - void printLevel(std::ostream& os, int level) const
@@ -302,6 +321,21 @@ public:
         return this->entity().mergeStates(state(p1), state(p2));
     }
 
+    bool preferState(State const& s1, State const& s2, int level) const {
+        return false;
+    }
+
+    bool prefer_state(void const* p1, void const* p2, int level) const {
+        return this->entity().preferState(state(p1), state(p2), level);
+    }
+
+    void relaxStates(State& s1, State& s2, int level) {
+    }
+
+    void relax_states(void* p1, void* p2, int level) {
+        this->entity().relaxStates(state(p1), state(p2), level);
+    }
+
     void destruct(void* p) {
         state(p).~State();
     }
@@ -360,6 +394,8 @@ public:
  *
  * Optionally, the following functions can be overloaded:
  * - void mergeStates(T* array1, T* array2)
+ * - bool preferState(T const* array1, T const* array2, int level) const
+ * - void relaxStates(T* array1, T* array2, int level)
  * - size_t hashCode(T const* state) const
  * - bool equalTo(T const* state1, T const* state2) const
  * - void printLevel(std::ostream& os, int level) const
@@ -440,6 +476,21 @@ public:
         return this->entity().mergeStates(state(p1), state(p2));
     }
 
+    bool preferState(T const* a1, T const* a2, int level) const {
+        return false;
+    }
+
+    bool prefer_state(void const* p1, void const* p2, int level) const {
+        return this->entity().preferState(state(p1), state(p2), level);
+    }
+
+    void relaxStates(T* a1, T* a2, int level) {
+    }
+
+    void relax_states(void* p1, void* p2, int level) {
+        this->entity().relaxStates(state(p1), state(p2), level);
+    }
+
     void destruct(void* p) {
     }
 
@@ -512,6 +563,9 @@ public:
  * - void construct(void* p)
  * - void getCopy(void* p, TS const& state)
  * - void mergeStates(TS& s1, TA* a1, TS& s2, TA* a2)
+ * - bool preferState(TS const& s1, TA const* a1, TS const& s2, TA const* a2,
+ *                    int level) const
+ * - void relaxStates(TS& s1, TA* a1, TS& s2, TA* a2, int level)
  * - size_t hashCode(TS const& state) const
  * - bool equalTo(TS const& state1, TS const& state2) const
  * - void printLevel(std::ostream& os, int level) const
@@ -613,6 +667,25 @@ public:
                                           a_state(p2));
     }
 
+    bool preferState(S_State const& s1, A_State const* a1, S_State const& s2,
+                     A_State const* a2, int level) const {
+        return false;
+    }
+
+    bool prefer_state(void const* p1, void const* p2, int level) const {
+        return this->entity().preferState(s_state(p1), a_state(p1),
+                                          s_state(p2), a_state(p2), level);
+    }
+
+    void relaxStates(S_State& s1, A_State* a1, S_State& s2, A_State* a2,
+                     int level) {
+    }
+
+    void relax_states(void* p1, void* p2, int level) {
+        this->entity().relaxStates(s_state(p1), a_state(p1), s_state(p2),
+                                   a_state(p2), level);
+    }
+
     void destruct(void* p) {
     }
 
@@ -30,14 +30,22 @@
 #include <ostream>
 #include <set>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "DdEval.hpp"
 #include "DdSpec.hpp"
 #include "dd/DdBuilder.hpp"
+#include "dd/DdBuilderDist.hpp"
+#include "dd/DdBuilderOptions.hpp"
+#include "dd/DdCheckpoint.hpp"
 #include "dd/DdReducer.hpp"
+#include "dd/DdStateArchive.hpp"
+#include "dd/DepthFirstBuilder.hpp"
 #include "dd/Node.hpp"
+#include "dd/NodeColumns.hpp"
 #include "dd/NodeTable.hpp"
+#include "dd/ZddMultiSubsetter.hpp"
 #include "eval/Cardinality.hpp"
 #include "op/Lookahead.hpp"
 #include "op/Unreduction.hpp"
@@ -45,11 +53,17 @@
 #include "util/MessageHandler.hpp"
 #include "util/MyHashTable.hpp"
 #include "util/MyVector.hpp"
+#include "util/ResourceUsage.hpp"
 
 namespace tdzdd {
 
 /**
  * Ordered n-ary decision diagram structure.
+ * Const member functions, such as evaluate(), iteration, and the use
+ * as a DD spec, can be called by multiple threads at the same time.
+ * Copies sharing the same diagram can be made and destructed by different
+ * threads; a non-const member function needs exclusive access to
+ * the object on which it is called.
  * @tparam ARITY arity of the nodes.
  */
 template<int ARITY>
@@ -57,13 +71,15 @@ class DdStructure: public DdSpec<DdStructure<ARITY>,NodeId,ARITY> {
     NodeTableHandler<ARITY> diagram; ///< The diagram structure.
     NodeId root_;                    ///< Root node ID.
     bool useMP;                      ///< Flag to use MP algorithms.
+    bool lowMemory;                  ///< Flag to reduce in place.
+    bool wavefront;                  ///< Flag to reduce in dependency order.
 
 public:
     /**
      * Default constructor.
      */
     DdStructure() :
-            root_(0), useMP(false) {
+            root_(0), useMP(false), lowMemory(false), wavefront(false) {
     }
 
 //    /*
@@ -80,7 +96,8 @@ public:
      * @param useMP use algorithms for multiple processors.
      */
     DdStructure(int n, bool useMP = false) :
-            diagram(n + 1), root_(1), useMP(useMP) {
+            diagram(n + 1), root_(1), useMP(useMP), lowMemory(false),
+            wavefront(false) {
         assert(n >= 0);
         NodeTableEntity<ARITY>& table = diagram.privateEntity();
         NodeId f(1);
@@ -103,60 +120,330 @@ public:
      */
     template<typename SPEC>
     DdStructure(DdSpecBase<SPEC,ARITY> const& spec, bool useMP = false) :
-            useMP(useMP) {
+            useMP(useMP), lowMemory(false), wavefront(false) {
+        DdBuilderOptions options;
+        options.useMP = useMP;
 #ifdef _OPENMP
-        if (useMP) constructMP_(spec.entity());
+        if (useMP) constructMP_(spec.entity(), options);
         else
 #endif
-        construct_(spec.entity());
+        construct_(spec.entity(), options);
+    }
+
+    /**
+     * DD construction with options.
+     * When a limit given by the options is exceeded, the construction is
+     * aborted and DdBuildLimitExceeded is thrown.
+     * The serial builder is used instead of the parallel one when an option
+     * only for the serial builder is given.
+     * std::runtime_error is thrown when the options request a feature
+     * that the selected builder does not support.
+     * @param spec DD spec.
+     * @param options construction options.
+     */
+    template<typename SPEC>
+    DdStructure(DdSpecBase<SPEC,ARITY> const& spec,
+                DdBuilderOptions const& options) :
+            useMP(options.useMP), lowMemory(false), wavefront(false) {
+        checkOptions(options, false);
+        if (options.depthFirst) constructDF_(spec.entity(), options);
+        else
+        if (options.processes >= 1) constructDist_(spec.entity(), options);
+        else
+#ifdef _OPENMP
+        if (useMP && !serialOnly(options)) constructMP_(spec.entity(), options);
+        else
+#endif
+        construct_(spec.entity(), options);
+    }
+
+    /**
+     * DD construction with recording for incremental reconstruction.
+     * The states of all nodes and the frontiers of the construction are
+     * recorded in the archive, so that rebuild() can reconstruct the
+     * diagram when the spec changes.
+     * The construction is serial; only the hash cache, the reduction rules
+     * and the resource limits are taken from the options.
+     * @param spec DD spec.
+     * @param archive the archive to record the construction.
+     * @param options construction options.
+     */
+    template<typename SPEC>
+    DdStructure(DdSpecBase<SPEC,ARITY> const& spec,
+                DdStateArchive<SPEC>& archive,
+                DdBuilderOptions const& options = DdBuilderOptions()) :
+            root_(0), useMP(options.useMP), lowMemory(false), wavefront(false) {
+        checkOptions(options, true);
+        constructIncr_(spec.entity(), archive, 0, 0, options);
+    }
+
+    /**
+     * Incremental DD reconstruction.
+     * The spec must differ from the one of the previous construction only
+     * in get_child() at the levels from lo to hi.
+     * The construction is resumed from the lowest frontier not below hi,
+     * and the states below lo that have been recorded are linked to
+     * the nodes of the previous diagram instead of being expanded.
+     * The diagram and the archive must be the results of the previous
+     * construction with each other; reducing the diagram separately
+     * invalidates the archive, so use the reduction option instead.
+     * The result may contain unreachable nodes of the previous diagram.
+     * The 1-terminal candidates of the previous diagram are not merged
+     * by merge_states() again.
+     * When no frontier is available, the diagram is built from scratch.
+     * @param spec DD spec.
+     * @param archive the archive of the previous construction.
+     * @param lo the lowest level of the changes.
+     * @param hi the highest level of the changes.
+     * @param options construction options.
+     */
+    template<typename SPEC>
+    void rebuild(DdSpecBase<SPEC,ARITY> const& spec,
+                 DdStateArchive<SPEC>& archive, int lo, int hi,
+                 DdBuilderOptions const& options = DdBuilderOptions()) {
+        checkOptions(options, true);
+        constructIncr_(spec.entity(), archive, lo, hi, options);
     }
 
 private:
+    /*
+     * Checks if the options request the features only for the serial
+     * breadth-first builder.
+     */
+    static bool serialOnly(DdBuilderOptions const& options) {
+        return options.spillMemory > 0 || options.eagerDedup
+                || options.maxWidth > 0;
+    }
+
+    /*
+     * Throws an exception if the options request a feature that the
+     * builder selected by them does not support.
+     * The options for performance only, useMP, sharedUniqTable and
+     * hashCache, are used where they are supported.
+     */
+    static void checkOptions(DdBuilderOptions const& options,
+                             bool incremental) {
+        bool const dist = !incremental && !options.depthFirst
+                && options.processes >= 1;
+        char const* builder = incremental ? "incremental construction" :
+                options.depthFirst ? "the depth-first builder" :
+                dist ? "the distributed builder" : 0;
+        char const* option = 0;
+
+        if (builder != 0) {
+            if (options.processes >= 1 && !dist) {
+                option = "processes";
+            }
+            else if (options.depthFirst && incremental) {
+                option = "depthFirst";
+            }
+            else if (options.spillMemory > 0) {
+                option = "spillMemory";
+            }
+            else if (options.eagerDedup) {
+                option = "eagerDedup";
+            }
+            else if (options.maxWidth > 0) {
+                option = "maxWidth";
+            }
+            else if (!options.checkpointFile.empty()) {
+                option = "checkpointFile";
+            }
+            else if (dist && options.memoryLimit > 0) {
+                option = "memoryLimit";
+            }
+            else if (dist && options.timeLimit > 0) {
+                option = "timeLimit";
+            }
+        }
+        else if (options.eagerDedup && sizeof(NodeId) < sizeof(NodeId*)) {
+            builder = "32-bit node IDs";
+            option = "eagerDedup";
+        }
+        else if (options.eagerDedup
+                && (options.spillMemory > 0 || options.maxWidth > 0)) {
+            builder = "eagerDedup";
+            option = (options.spillMemory > 0) ? "spillMemory" : "maxWidth";
+        }
+        else if (options.spillMemory > 0 && !options.checkpointFile.empty()) {
+            builder = "spillMemory";
+            option = "checkpointFile";
+        }
+
+        if (option == 0) return;
+        throw std::runtime_error(std::string("DdBuilderOptions: ") + option
+                + " is not supported with " + builder);
+    }
+
     template<typename SPEC>
-    void construct_(SPEC const& spec) {
+    void construct_(SPEC const& spec, DdBuilderOptions const& options) {
         MessageHandler mh;
         mh.begin(typenameof(spec));
         DdBuilder<SPEC> zc(spec, diagram);
-        int n = zc.initialize(root_);
+        zc.useSpillFiles(options.spillDirectory, options.spillMemory);
+        zc.useEagerDedup(options.eagerDedup);
+        zc.useHashCache(options.hashCache);
+        zc.setReduction(options.reduction);
+        zc.setMaxWidth(options.maxWidth, options.widthRule);
+        zc.setLimits(options.memoryLimit, options.timeLimit);
+        std::string const& ckp = options.checkpointFile;
+        bool const resume = !ckp.empty() && DdCheckpointFile::exists(ckp);
+        int n = resume ? zc.resume(ckp, root_) : zc.initialize(root_);
+        if (resume) mh << " resumed at " << n;
 
         if (n > 0) {
             mh.setSteps(n);
+            double saved = getWallClockTime();
             for (int i = n; i > 0; --i) {
                 zc.construct(i);
                 mh.step();
+                if (!ckp.empty() && i > 1 && getWallClockTime() - saved
+                        >= options.checkpointInterval) {
+                    zc.saveCheckpoint(ckp, i - 1);
+                    saved = getWallClockTime();
+                }
             }
         }
         else {
             mh << " ...";
         }
+        if (!ckp.empty()) DdCheckpointFile::remove(ckp);
 
         mh.end(size());
     }
 
     template<typename SPEC>
-    void constructMP_(SPEC const& spec) {
+    void constructMP_(SPEC const& spec, DdBuilderOptions const& options) {
         MessageHandler mh;
         mh.begin(typenameof(spec));
         DdBuilderMP<SPEC> zc(spec, diagram);
-        int n = zc.initialize(root_);
+        zc.useSharedUniqTable(options.sharedUniqTable);
+        zc.useHashCache(options.hashCache);
+        zc.setReduction(options.reduction);
+        zc.setLimits(options.memoryLimit, options.timeLimit);
+        std::string const& ckp = options.checkpointFile;
+        bool const resume = !ckp.empty() && DdCheckpointFile::exists(ckp);
+        int n = resume ? zc.resume(ckp, root_) : zc.initialize(root_);
+        if (resume) mh << " resumed at " << n;
 
         if (n > 0) {
 #ifdef _OPENMP
             mh << " " << omp_get_max_threads() << "x";
 #endif
             mh.setSteps(n);
+            double saved = getWallClockTime();
             for (int i = n; i > 0; --i) {
                 zc.construct(i);
                 mh.step();
+                if (!ckp.empty() && i > 1 && getWallClockTime() - saved
+                        >= options.checkpointInterval) {
+                    zc.saveCheckpoint(ckp, i - 1);
+                    saved = getWallClockTime();
+                }
             }
         }
         else {
             mh << " ...";
         }
+        if (!ckp.empty()) DdCheckpointFile::remove(ckp);
 
         mh.end(size());
     }
 
+    template<typename SPEC>
+    void constructDist_(SPEC const& spec, DdBuilderOptions const& options) {
+        MessageHandler mh;
+        mh.begin(typenameof(spec));
+        DdBuilderDist<SPEC> zc(spec, diagram);
+        zc.setProcesses(options.processes);
+        zc.setReduction(options.reduction);
+        int n = zc.initialize(root_);
+
+        if (n > 0) {
+            mh << " " << options.processes << " processes";
+            mh.setSteps(n);
+            for (int i = n; i > 0; --i) {
+                zc.construct(i);
+                mh.step();
+            }
+        }
+        else {
+            mh << " ...";
+        }
+
+        mh.end(size());
+    }
+
+    template<typename SPEC>
+    void constructDF_(SPEC const& spec, DdBuilderOptions const& options) {
+        MessageHandler mh;
+        mh.begin(typenameof(spec)) << " depth-first ...";
+        DepthFirstBuilder<SPEC> zc(spec, diagram);
+        zc.setReduction(options.reduction);
+        zc.setLimits(options.memoryLimit, options.timeLimit);
+        zc.construct(root_);
+        mh.end(size());
+    }
+
+    template<typename SPEC>
+    void constructIncr_(SPEC const& spec, DdStateArchive<SPEC>& archive,
+                        int lo, int hi, DdBuilderOptions const& options) {
+        MessageHandler mh;
+        mh.begin(typenameof(spec));
+        NodeTableHandler<ARITY> table;
+        NodeId root;
+        DdBuilder<SPEC> zc(spec, table);
+        zc.useHashCache(options.hashCache);
+        zc.setReduction(options.reduction);
+        zc.setLimits(options.memoryLimit, options.timeLimit);
+
+        int const top = archive.frontierAbove(hi);
+        int n;
+        if (1 <= lo && lo <= hi && top > 0) {
+            archive.update(spec, lo, top);
+            zc.useArchive(&archive, lo);
+            n = zc.resume(archive.frontierPath(top), root);
+            mh << " resumed at " << n;
+        }
+        else {
+            archive.clear();
+            zc.useArchive(&archive);
+            n = zc.initialize(root);
+            if (n > 0) archive.reset(spec, n);
+            lo = 1;
+        }
+
+        if (n > 0) {
+            mh.setSteps(n);
+            for (int i = n; i > 0; --i) {
+                if (i == lo - 1) {
+                    NodeTableEntity<ARITY>& output = table.privateEntity();
+                    for (int ii = 1; ii < lo; ++ii) {
+                        MyVector<Node<ARITY> > const& row = (*diagram)[ii];
+                        output.initRow(ii, row.size());
+                        for (size_t j = 0; j < row.size(); ++j) {
+                            output[ii][j] = row[j];
+                        }
+                    }
+                }
+
+                zc.construct(i);
+                mh.step();
+                if (i - 1 >= lo && archive.isFrontier(i - 1)) {
+                    zc.saveCheckpoint(archive.frontierPath(i - 1), i - 1);
+                    archive.setFrontier(i - 1);
+                }
+            }
+        }
+        else {
+            mh << " ...";
+        }
+
+        diagram = table;
+        root_ = root;
+        mh.end(size());
+    }
+
 public:
     /**
      * ZDD subsetting.
@@ -224,6 +511,48 @@ private:
     }
 
 public:
+    /**
+     * ZDD subsetting by multiple specs.
+     * The result for each spec is the same as the one given by zddSubset(),
+     * but the diagram is traversed only once for all of them.
+     * This diagram is not changed.
+     * @param specs ZDD specs of the same type.
+     * @return the refined ZDDs in the order of the specs.
+     */
+    template<typename SPEC>
+    std::vector<DdStructure> zddSubsets(std::vector<SPEC> const& specs) const {
+        MessageHandler mh;
+        mh.begin("multi-subsetting") << " " << specs.size() << " specs";
+        ZddMultiSubsetter<SPEC> zs(diagram, specs);
+        zs.useMultiProcessors(useMP);
+        int n = zs.initialize(root_);
+
+        if (n > 0) {
+#ifdef _OPENMP
+            if (useMP) mh << " " << omp_get_max_threads() << "x";
+#endif
+            mh.setSteps(n);
+            for (int i = n; i > 0; --i) {
+                zs.subset(i);
+                mh.step();
+            }
+        }
+        else {
+            mh << " ...";
+        }
+
+        std::vector<DdStructure> results(specs.size());
+        size_t total = 0;
+        for (size_t k = 0; k < specs.size(); ++k) {
+            results[k].diagram = zs.getDiagram(k);
+            results[k].root_ = zs.getRoot(k);
+            results[k].useMP = useMP;
+            total += results[k].size();
+        }
+        mh.end(total);
+        return results;
+    }
+
     /**
      * Enables or disables multiple processor algorithms.
      * @param flag true for using multiple processor algorithms.
@@ -235,6 +564,36 @@ public:
         return old;
     }
 
+    /**
+     * Enables or disables the low-memory reduction.
+     * The reduction algorithms then compact each level of the diagram in
+     * place instead of building a reduced copy, at the cost of parallelism.
+     * @param flag true for using the low-memory reduction.
+     * @return old value of the flag.
+     */
+    bool useLowMemoryReduction(bool flag = true) {
+        bool old = lowMemory;
+        lowMemory = flag;
+        return old;
+    }
+
+    /**
+     * Enables or disables the wavefront reduction.
+     * In the multiple processor mode, the reduction algorithms then reduce
+     * a level as soon as all the levels referred by it are done, so that
+     * independent narrow levels are reduced by different threads at the
+     * same time; the order of the nodes at each level may differ from the
+     * one of the serial algorithm.
+     * It is not used with the low-memory reduction.
+     * @param flag true for using the wavefront reduction.
+     * @return old value of the flag.
+     */
+    bool useWavefrontReduction(bool flag = true) {
+        bool old = wavefront;
+        wavefront = flag;
+        return old;
+    }
+
     /**
      * Gets the root node.
      * @return root node ID.
@@ -397,12 +756,19 @@ public:
 #endif
 
         DdReducer<ARITY,BDD,ZDD> zr(diagram, useMP);
+        zr.useRadixSort(useMP);
+        zr.useInPlace(lowMemory);
         zr.setRoot(root_);
 
-        mh.setSteps(n);
-        for (int i = 1; i <= n; ++i) {
-            zr.reduce(i, useMP);
-            mh.step();
+        if (useMP && wavefront && !lowMemory) {
+            zr.reduceWavefront(n, true);
+        }
+        else {
+            mh.setSteps(n);
+            for (int i = 1; i <= n; ++i) {
+                zr.reduce(i, useMP);
+                mh.step();
+            }
         }
 
         mh.end(size());
@@ -550,6 +916,405 @@ public:
         return retval;
     }
 
+    /**
+     * Evaluates the DD from the bottom to the top
+     * on the structure-of-arrays layout of the node table.
+     * Blocks of nodes at the same level are passed to the evalBlock
+     * function of the evaluator.
+     * @param evaluator the driver class that implements DdEval interface.
+     * @param columns the node table of this DD in the structure-of-arrays
+     *        layout.
+     * @return value at the root.
+     */
+    template<typename S, typename T, typename R>
+    R evaluate(DdEval<S,T,R> const& evaluator,
+               NodeColumns<ARITY> const& columns) const {
+        S eval(evaluator.entity()); // copied
+#ifdef _OPENMP
+        bool useMP = this->useMP && eval.isThreadSafe();
+#endif
+        bool msg = eval.showMessages();
+        int n = root_.row();
+
+        if (columns.numRows() <= n) throw std::runtime_error(
+                "Node columns do not match the DD");
+        for (int i = 1; i <= n; ++i) {
+            if (columns.size(i) != (*diagram)[i].size()) throw std::runtime_error(
+                    "Node columns do not match the DD");
+        }
+
+        MessageHandler mh;
+        if (msg) {
+            mh.begin(typenameof(eval));
+#ifdef _OPENMP
+            if (useMP) mh << " " << omp_get_max_threads() << "x";
+#endif
+            mh.setSteps(n);
+        }
+
+#ifdef _OPENMP
+        int threads = useMP ? omp_get_max_threads() : 0;
+        MyVector<S> evals(threads, eval);
+#endif
+        eval.initialize(n);
+#ifdef _OPENMP
+        if (useMP)
+#pragma omp parallel
+        {
+            int k = omp_get_thread_num();
+            evals[k].initialize(n);
+        }
+#endif
+
+        DataTable<T> work(diagram->numRows());
+        MyVector<T*> rows(diagram->numRows());
+        for (size_t i = 0; i < rows.size(); ++i) {
+            rows[i] = 0;
+        }
+        {
+            size_t const m = (*diagram)[0].size();
+            assert(m >= 2);
+            work[0].resize(m);
+            for (size_t j = 0; j < m; ++j) {
+                eval.evalTerminal(work[0][j], j);
+            }
+            rows[0] = work[0].data();
+        }
+
+        size_t const bs = columns.blockSize();
+
+        for (int i = 1; i <= n; ++i) {
+            size_t const m = columns.size(i);
+            size_t const mb = (m + bs - 1) / bs;
+            work[i].resize(m);
+            rows[i] = work[i].data();
+
+#ifdef _OPENMP
+            if (useMP)
+#pragma omp parallel
+            {
+                int k = omp_get_thread_num();
+
+#pragma omp for schedule(static)
+                for (intmax_t kb = 0; kb < intmax_t(mb); ++kb) {
+                    size_t const j = kb * bs;
+                    DdBlockValues<T,ARITY> values(rows.data(),
+                            std::min(bs, m - j));
+                    for (int b = 0; b < ARITY; ++b) {
+                        values.setBranches(b, columns.branches(i, b) + j,
+                                columns.commonLevel(i, kb, b));
+                    }
+                    evals[k].evalBlock(&work[i][j], i, values);
+                }
+            }
+            else
+#endif
+            for (size_t kb = 0; kb < mb; ++kb) {
+                size_t const j = kb * bs;
+                DdBlockValues<T,ARITY> values(rows.data(), std::min(bs, m - j));
+                for (int b = 0; b < ARITY; ++b) {
+                    values.setBranches(b, columns.branches(i, b) + j,
+                            columns.commonLevel(i, kb, b));
+                }
+                eval.evalBlock(&work[i][j], i, values);
+            }
+
+            MyVector<int> const& levels = diagram->lowerLevels(i);
+            for (int const* t = levels.begin(); t != levels.end(); ++t) {
+                work[*t].clear();
+                rows[*t] = 0;
+                eval.destructLevel(*t);
+            }
+#ifdef _OPENMP
+            if (useMP)
+#pragma omp parallel
+            {
+                int k = omp_get_thread_num();
+                for (int const* t = levels.begin(); t != levels.end(); ++t) {
+                    evals[k].destructLevel(*t);
+                }
+            }
+#endif
+            if (msg) mh.step();
+        }
+
+        R retval = eval.getValue(work[root_.row()][root_.col()]);
+        if (msg) mh.end();
+        return retval;
+    }
+
+    /**
+     * Evaluates the DD from the top to the bottom.
+     * @param evaluator the driver class that implements DdTopDownEval
+     *        interface.
+     * @return value at the 1-terminal.
+     */
+    template<typename S, typename T, typename R>
+    R evaluate(DdTopDownEval<S,T,R> const& evaluator) const {
+        NoBottomUpValues none;
+        return evaluateTopDown(evaluator, none);
+    }
+
+    /**
+     * Evaluates the DD from the bottom to the top and then from the top to
+     * the bottom.
+     * The bottom-up values of all nodes are kept until the top-down pass
+     * reaches their levels, where they are given to the visitNode function
+     * of the top-down evaluator together with the top-down values.
+     * @param forward the driver class that implements DdTopDownEval
+     *        interface.
+     * @param backward the driver class that implements DdEval interface.
+     * @return value of the top-down evaluation at the 1-terminal.
+     */
+    template<typename S, typename T, typename R, typename S2, typename U,
+            typename R2>
+    R forwardBackward(DdTopDownEval<S,T,R> const& forward,
+                      DdEval<S2,U,R2> const& backward) const {
+        BottomUpValues<S2,U> values(*this, backward.entity());
+        return evaluateTopDown(forward, values);
+    }
+
+private:
+    struct NoBottomUpValues {
+        template<typename S, typename T>
+        void visit(S& eval, T const& v, int i, size_t j) const {
+            eval.visitNode(v, i, j);
+        }
+
+        void destructLevel(int i) {
+        }
+    };
+
+    template<typename S, typename U>
+    class BottomUpValues {
+        S eval;
+        MyVector<S> evals;
+        DataTable<U> work;
+
+    public:
+        BottomUpValues(DdStructure const& dd, S const& evaluator) :
+                eval(evaluator), work(dd.diagram->numRows()) {
+            NodeTableEntity<ARITY> const& table = *dd.diagram;
+#ifdef _OPENMP
+            bool useMP = dd.useMP && eval.isThreadSafe();
+            int threads = useMP ? omp_get_max_threads() : 0;
+            evals.reserve(threads);
+            for (int k = 0; k < threads; ++k) {
+                evals.push_back(eval);
+            }
+#endif
+            int n = dd.root_.row();
+            eval.initialize(n);
+#ifdef _OPENMP
+            if (useMP)
+#pragma omp parallel
+            {
+                int k = omp_get_thread_num();
+                evals[k].initialize(n);
+            }
+#endif
+
+            {
+                size_t const m = table[0].size();
+                assert(m >= 2);
+                work[0].resize(m);
+                for (size_t j = 0; j < m; ++j) {
+                    eval.evalTerminal(work[0][j], j);
+                }
+            }
+
+            for (int i = 1; i <= n; ++i) {
+                MyVector<Node<ARITY> > const& node = table[i];
+                size_t const m = node.size();
+                work[i].resize(m);
+
+#ifdef _OPENMP
+                if (useMP)
+#pragma omp parallel
+                {
+                    int k = omp_get_thread_num();
+
+#pragma omp for schedule(static)
+                    for (intmax_t j = 0; j < intmax_t(m); ++j) {
+                        DdValues<U,ARITY> values;
+                        for (int b = 0; b < ARITY; ++b) {
+                            NodeId f = node[j].branch[b];
+                            values.setReference(b, work[f.row()][f.col()]);
+                            values.setLevel(b, f.row());
+                        }
+                        evals[k].evalNode(work[i][j], i, values);
+                    }
+                }
+                else
+#endif
+                for (size_t j = 0; j < m; ++j) {
+                    DdValues<U,ARITY> values;
+                    for (int b = 0; b < ARITY; ++b) {
+                        NodeId f = node[j].branch[b];
+                        values.setReference(b, work[f.row()][f.col()]);
+                        values.setLevel(b, f.row());
+                    }
+                    eval.evalNode(work[i][j], i, values);
+                }
+            }
+        }
+
+        template<typename S1, typename T>
+        void visit(S1& eval, T const& v, int i, size_t j) const {
+            eval.visitNode(v, work[i][j], i, j);
+        }
+
+        /*
+         * The values at level i are no longer referred to after level i
+         * is visited, since they are not passed to evalArc.
+         */
+        void destructLevel(int i) {
+            work[i].clear();
+            eval.destructLevel(i);
+            for (size_t k = 0; k < evals.size(); ++k) {
+                evals[k].destructLevel(i);
+            }
+        }
+    };
+
+    template<typename S, typename T>
+    static void initValues(S& eval, MyVector<T>& row, size_t m) {
+        row.resize(m);
+        for (size_t j = 0; j < m; ++j) {
+            eval.initValue(row[j]);
+        }
+    }
+
+    template<typename S, typename T, typename R, typename V>
+    R evaluateTopDown(DdTopDownEval<S,T,R> const& evaluator,
+                      V& bottomUp) const {
+        S eval(evaluator.entity()); // copied
+#ifdef _OPENMP
+        bool useMP = this->useMP && eval.isThreadSafe();
+#endif
+        bool msg = eval.showMessages();
+        int n = root_.row();
+
+        MessageHandler mh;
+        if (msg) {
+            mh.begin(typenameof(eval));
+#ifdef _OPENMP
+            if (useMP) mh << " " << omp_get_max_threads() << "x";
+#endif
+            mh.setSteps(n);
+        }
+
+#ifdef _OPENMP
+        int threads = useMP ? omp_get_max_threads() : 0;
+        MyVector<S> evals(threads, eval);
+        MyVector<DataTable<T> > local(threads); // per-thread contributions
+        for (int k = 0; k < threads; ++k) {
+            local[k].init(diagram->numRows());
+        }
+#endif
+        eval.initialize(n);
+#ifdef _OPENMP
+        if (useMP)
+#pragma omp parallel
+        {
+            int k = omp_get_thread_num();
+            evals[k].initialize(n);
+            initValues(evals[k], local[k][0], (*diagram)[0].size());
+        }
+#endif
+
+        DataTable<T> work(diagram->numRows());
+        initValues(eval, work[0], (*diagram)[0].size());
+        if (n > 0) initValues(eval, work[n], (*diagram)[n].size());
+        eval.evalRoot(work[n][root_.col()]);
+
+        for (int i = n; i >= 1; --i) {
+            MyVector<Node<ARITY> > const& node = (*diagram)[i];
+            size_t const m = node.size();
+            MyVector<int> const& levels = diagram->lowerLevels(i);
+
+            // The levels first reached from level i need their work areas.
+            for (int const* t = levels.begin(); t != levels.end(); ++t) {
+                initValues(eval, work[*t], (*diagram)[*t].size());
+            }
+            if (work[i].size() != m) { // unreachable level
+                initValues(eval, work[i], m);
+            }
+
+#ifdef _OPENMP
+            if (useMP)
+#pragma omp parallel
+            {
+                int k = omp_get_thread_num();
+                DataTable<T>& acc = local[k];
+
+                for (int const* t = levels.begin(); t != levels.end(); ++t) {
+                    initValues(evals[k], acc[*t], (*diagram)[*t].size());
+                }
+
+#pragma omp for schedule(static)
+                for (intmax_t j = 0; j < intmax_t(m); ++j) {
+                    for (int kk = 0; kk < threads; ++kk) {
+                        if (local[kk][i].size() != m) continue;
+                        evals[k].mergeValues(work[i][j], local[kk][i][j]);
+                    }
+                }
+
+                acc[i].clear();
+
+#pragma omp for schedule(static)
+                for (intmax_t j = 0; j < intmax_t(m); ++j) {
+                    T const& v = work[i][j];
+                    bottomUp.visit(evals[k], v, i, j);
+                    for (int b = 0; b < ARITY; ++b) {
+                        NodeId f = node[j].branch[b];
+                        evals[k].evalArc(acc[f.row()][f.col()], f.row(), v, i,
+                                b);
+                    }
+                }
+            }
+            else
+#endif
+            for (size_t j = 0; j < m; ++j) {
+                T const& v = work[i][j];
+                bottomUp.visit(eval, v, i, j);
+                for (int b = 0; b < ARITY; ++b) {
+                    NodeId f = node[j].branch[b];
+                    eval.evalArc(work[f.row()][f.col()], f.row(), v, i, b);
+                }
+            }
+
+            work[i].clear();
+            eval.destructLevel(i);
+#ifdef _OPENMP
+            if (useMP)
+#pragma omp parallel
+            {
+                int k = omp_get_thread_num();
+                evals[k].destructLevel(i);
+            }
+#endif
+            bottomUp.destructLevel(i);
+            if (msg) mh.step();
+        }
+
+#ifdef _OPENMP
+        if (useMP) {
+            for (size_t j = 0; j < work[0].size(); ++j) {
+                for (int kk = 0; kk < threads; ++kk) {
+                    if (local[kk][0].size() != work[0].size()) continue;
+                    eval.mergeValues(work[0][j], local[kk][0][j]);
+                }
+            }
+        }
+#endif
+
+        R retval = eval.getValue(work[0][1]);
+        if (msg) mh.end();
+        return retval;
+    }
+
+public:
     /**
      * Iterator on a set of integer vectors represented by a DD.
      */
@@ -696,6 +1461,31 @@ public:
         return f.hash();
     }
 
+    /**
+     * Writes the DD to a file in the binary format.
+     * The file can be used only on platforms with the same byte order
+     * and the same node ID layout.
+     * @param path file name.
+     */
+    void dumpBinary(std::string const& path) const {
+        diagram->writeBinary(path, root_);
+    }
+
+    /**
+     * Replaces the DD with a file written by dumpBinary().
+     * The file is mapped into memory and its nodes are used in place
+     * without parsing or copying, so that the DD can be evaluated,
+     * iterated, and used as a DD spec immediately.
+     * A level is copied into memory when it is modified.
+     * @param path file name.
+     */
+    void mapBinary(std::string const& path) {
+        NodeTableHandler<ARITY> table;
+        NodeId root = table.privateEntity().mapBinary(path);
+        diagram = table;
+        root_ = root;
+    }
+
     /**
      * Dumps the node table in Sapporo ZDD format.
      * Works only for binary DDs.
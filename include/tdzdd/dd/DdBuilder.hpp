@@ -24,24 +24,33 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <ostream>
 #include <stdexcept>
+#include <string>
 
 #ifdef _OPENMP
 #include <omp.h>
 #endif
 
+#include "DdBuilderOptions.hpp"
+#include "DdCheckpoint.hpp"
 #include "DdSweeper.hpp"
 #include "Node.hpp"
 #include "NodeTable.hpp"
 #include "../DdSpec.hpp"
+#include "../util/ConcurrentHashTable.hpp"
 #include "../util/MemoryPool.hpp"
 #include "../util/MessageHandler.hpp"
 #include "../util/MyHashTable.hpp"
 #include "../util/MyList.hpp"
 #include "../util/MyVector.hpp"
+#include "../util/NumaPlacement.hpp"
+#include "../util/SpillFile.hpp"
+#include "../util/WorkStealingScheduler.hpp"
+#include "../util/demangle.hpp"
 
 namespace tdzdd {
 
@@ -86,20 +95,33 @@ protected:
         return headerSize + (n + sizeof(SpecNode) - 1) / sizeof(SpecNode);
     }
 
+    /*
+     * Hash function and equality of states.
+     * When slot is positive, the hash code of a state is cached in that
+     * word of SpecNode by cache(), and it is used instead of hash_code()
+     * as well as for a quick check before equal_to().
+     */
     template<typename SPEC>
     struct Hasher {
         SPEC const& spec;
         int const level;
+        int const slot;
 
-        Hasher(SPEC const& spec, int level) :
-                spec(spec), level(level) {
+        Hasher(SPEC const& spec, int level, int slot = 0) :
+                spec(spec), level(level), slot(slot) {
+        }
+
+        void cache(SpecNode* p) const {
+            if (slot > 0) p[slot].code = spec.hash_code(state(p), level);
         }
 
         size_t operator()(SpecNode const* p) const {
+            if (slot > 0) return p[slot].code;
             return spec.hash_code(state(p), level);
         }
 
         size_t operator()(SpecNode const* p, SpecNode const* q) const {
+            if (slot > 0 && p[slot].code != q[slot].code) return false;
             return spec.equal_to(state(p), state(q), level);
         }
     };
@@ -149,25 +171,118 @@ protected:
         return headerSize + (n + sizeof(SpecNode) - 1) / sizeof(SpecNode);
     }
 
+    /*
+     * Hash function and equality of states.
+     * When slot is positive, the hash code of a state is cached in that
+     * word of SpecNode by cache(), and it is used instead of hash_code()
+     * as well as for a quick check before equal_to().
+     */
     template<typename SPEC>
     struct Hasher {
         SPEC const& spec;
         int const level;
+        int const slot;
 
-        Hasher(SPEC const& spec, int level) :
-                spec(spec), level(level) {
+        Hasher(SPEC const& spec, int level, int slot = 0) :
+                spec(spec), level(level), slot(slot) {
+        }
+
+        void cache(SpecNode* p) const {
+            if (slot > 0) p[slot].code = spec.hash_code(state(p), level);
         }
 
         size_t operator()(SpecNode const* p) const {
+            if (slot > 0) return p[slot].code;
             return spec.hash_code(state(p), level);
         }
 
         size_t operator()(SpecNode const* p, SpecNode const* q) const {
+            if (slot > 0 && p[slot].code != q[slot].code) return false;
             return spec.equal_to(state(p), state(q), level);
         }
     };
+
+    /*
+     * Order of 1-terminal candidates by their branch slots in a row,
+     * that is by the column and then by the branch index.
+     * The slots are unique; thus it is a total order without ties.
+     */
+    struct OneCandidateLess {
+        bool operator()(SpecNode const* p, SpecNode const* q) const {
+            return p[0].srcPtr < q[0].srcPtr;
+        }
+    };
+
+    /*
+     * Merges the states reaching the 1-terminal at level i into the
+     * 1-terminal state "one".
+     * The candidates are collected by each thread and then processed in
+     * the order of their branch slots, as the serial builders do.
+     * The result does not depend on which thread collects which candidate,
+     * but it follows the column numbers, which the parallel builders may
+     * assign differently from run to run.
+     * The candidates are destructed and cleared.
+     */
+    template<typename SPEC, int AR>
+    static void mergeOneCandidates(SPEC& spec, void* one,
+                                   MyVector<NodeBranchId>& oneSrcPtr,
+                                   MyVector<MyList<SpecNode> >& candidates,
+                                   NodeTableEntity<AR>& output, int i) {
+        MyVector<SpecNode*> list;
+        for (size_t y = 0; y < candidates.size(); ++y) {
+            for (MyList<SpecNode>::iterator t = candidates[y].begin();
+                    t != candidates[y].end(); ++t) {
+                list.push_back(*t);
+            }
+        }
+        if (list.empty()) return;
+        std::sort(list.begin(), list.end(), OneCandidateLess());
+
+        NodeId const* const base = output[i].data()->branch;
+
+        for (size_t k = 0; k < list.size(); ++k) {
+            SpecNode* p = list[k];
+            size_t const off = srcPtr(p) - base;
+            NodeBranchId const nbi(i, off / AR, off % AR);
+
+            if (oneSrcPtr.empty()) { // the first 1-terminal candidate
+                spec.get_copy(one, state(p));
+                oneSrcPtr.push_back(nbi);
+            }
+            else {
+                switch (spec.merge_states(one, state(p))) {
+                case 1:
+                    while (!oneSrcPtr.empty()) {
+                        NodeBranchId const& o = oneSrcPtr.back();
+                        assert(o.row >= i);
+                        output[o.row][o.col].branch[o.val] = 0;
+                        oneSrcPtr.pop_back();
+                    }
+                    spec.destruct(one);
+                    spec.get_copy(one, state(p));
+                    oneSrcPtr.push_back(nbi);
+                    break;
+                case 2:
+                    *srcPtr(p) = 0;
+                    break;
+                default:
+                    oneSrcPtr.push_back(nbi);
+                    break;
+                }
+            }
+
+            spec.destruct(state(p));
+        }
+
+        for (size_t y = 0; y < candidates.size(); ++y) {
+            candidates[y].clear();
+        }
+    }
 };
 
+template<typename S>
+class DdStateArchive;
+
 /**
  * Basic breadth-first DD builder.
  */
@@ -178,9 +293,11 @@ class DdBuilder: DdBuilderBase {
     static int const AR = Spec::ARITY;
 
     Spec spec;
-    int const specNodeSize;
+    int specNodeSize;
+    int hashSlot;
     NodeTableEntity<AR>& output;
     DdSweeper<AR> sweeper;
+    NodeId* rootPtr;
 
     MyVector<MyList<SpecNode> > snodeTable;
 
@@ -188,20 +305,93 @@ class DdBuilder: DdBuilderBase {
     void* const one;
     MyVector<NodeBranchId> oneSrcPtr;
 
+    std::string spillDirectory;
+    size_t spillBudget;
+    MyVector<SpillFile*> spillFiles;
+    size_t spillCheckCount;
+
+    DdBuildLimiter limiter;
+    size_t limitCheckCount;
+
+    bool eagerDedup;
+    MyVector<UniqTable*> eagerTables;
+
+    size_t maxWidth;
+    DdWidthRule widthRule;
+
+    DdStateArchive<Spec>* archive;
+    int spliceLevel;
+
+    /*
+     * Hash function and equality of the states in a list,
+     * identified by (index + 1).
+     */
+    struct IndexHasher {
+        Spec const& spec;
+        MyVector<SpecNode*> const& nodes;
+        int const level;
+
+        IndexHasher(Spec const& spec, MyVector<SpecNode*> const& nodes,
+                    int level) :
+                spec(spec), nodes(nodes), level(level) {
+        }
+
+        size_t operator()(size_t k) const {
+            return spec.hash_code(state(nodes[k - 1]), level);
+        }
+
+        bool operator()(size_t k, size_t l) const {
+            return spec.equal_to(state(nodes[k - 1]), state(nodes[l - 1]),
+                    level);
+        }
+    };
+
+    /*
+     * Order of the states by prefer_state(void const*, void const*, int).
+     */
+    struct Preference {
+        Spec const& spec;
+        MyVector<SpecNode*> const& nodes;
+        int const level;
+
+        Preference(Spec const& spec, MyVector<SpecNode*> const& nodes,
+                   int level) :
+                spec(spec), nodes(nodes), level(level) {
+        }
+
+        bool operator()(size_t k, size_t l) const {
+            return spec.prefer_state(state(nodes[k]), state(nodes[l]), level);
+        }
+    };
+
     void init(int n) {
         snodeTable.resize(n + 1);
         if (n >= output.numRows()) output.setNumRows(n + 1);
         oneSrcPtr.clear();
+        clearSpillFiles();
+        if (spillBudget > 0 && !eagerDedup) spillFiles.resize(n + 1);
+        clearEagerTables();
+        if (eagerDedup) eagerTables.resize(n + 1);
     }
 
 public:
     DdBuilder(Spec const& spec, NodeTableHandler<AR>& output, int n = 0) :
             spec(spec),
             specNodeSize(getSpecNodeSize(spec.datasize())),
+            hashSlot(0),
             output(output.privateEntity()),
             sweeper(this->output, oneSrcPtr),
+            rootPtr(0),
             oneStorage(spec.datasize()),
-            one(oneStorage.data()) {
+            one(oneStorage.data()),
+            spillBudget(0),
+            spillCheckCount(0),
+            limitCheckCount(0),
+            eagerDedup(false),
+            maxWidth(0),
+            widthRule(RESTRICTED_DD),
+            archive(0),
+            spliceLevel(0) {
         if (n >= 1) init(n);
     }
 
@@ -210,6 +400,156 @@ public:
             spec.destruct(one);
             oneSrcPtr.clear();
         }
+        for (size_t i = 0; i < snodeTable.size(); ++i) {
+            MyList<SpecNode>& snodes = snodeTable[i];
+            for (; !snodes.empty(); snodes.pop_front()) {
+                spec.destruct(state(snodes.front()));
+            }
+        }
+        clearSpillFiles();
+        clearEagerTables();
+    }
+
+    /**
+     * Enables the eager deduplication mode.
+     * Each child state is looked up in the unique table of its level as
+     * soon as it is generated, and only unseen states are stored.
+     * The branches to a known state wait for its node ID in a list linked
+     * through the branch slots themselves.
+     * Thus the pending states are not more than the nodes of the next
+     * levels, instead of the edges to them.
+     * The external-memory mode is disabled in this mode.
+     * The flag is ignored when a node ID cannot hold a pointer
+     * (TDZDD_COMPACT_NODE).
+     * This function must be called before initialize().
+     * @param flag true for enabling the eager deduplication mode.
+     * @return old value of the flag.
+     */
+    bool useEagerDedup(bool flag = true) {
+        bool old = eagerDedup;
+        eagerDedup = flag && sizeof(NodeId) >= sizeof(NodeId*);
+        return old;
+    }
+
+    /**
+     * Enables the hash cache.
+     * The hash code of each state is computed only once and kept in an
+     * extra word of the SpecNode, so that resizing the unique tables does
+     * not call hash_code(), and equal_to() is called only for the states
+     * of the same hash code.
+     * It is effective for large states.
+     * This function must be called before initialize().
+     * @param flag true for enabling the hash cache.
+     * @return old value of the flag.
+     */
+    bool useHashCache(bool flag = true) {
+        bool old = hashSlot > 0;
+        specNodeSize = getSpecNodeSize(spec.datasize()) + (flag ? 1 : 0);
+        hashSlot = flag ? specNodeSize - 1 : 0;
+        return old;
+    }
+
+    /**
+     * Sets the resource limits.
+     * The limits are checked at the beginning of each level and
+     * periodically during the construction of a level.
+     * When a limit is exceeded, DdBuildLimitExceeded is thrown.
+     * @param memoryLimit upper limit of memoryUsage() in bytes;
+     *        0 for no limit.
+     * @param timeLimit upper limit of the elapsed time in seconds
+     *        from this call; 0 for no limit.
+     */
+    void setLimits(size_t memoryLimit, double timeLimit) {
+        limiter.set(memoryLimit, timeLimit);
+    }
+
+    /**
+     * Estimates the memory usage of the builder.
+     * It counts the output nodes and the pending states in memory.
+     * @return the memory usage in bytes.
+     */
+    size_t memoryUsage() const {
+        size_t bytes = 0;
+        for (int i = 0; i < output.numRows(); ++i) {
+            bytes += output[i].size() * sizeof(Node<AR> );
+        }
+        for (size_t i = 0; i < snodeTable.size(); ++i) {
+            bytes += snodeTable[i].size() * (specNodeSize + 1)
+                    * sizeof(SpecNode);
+        }
+        for (size_t i = 0; i < eagerTables.size(); ++i) {
+            if (eagerTables[i] == 0) continue;
+            bytes += eagerTables[i]->tableSize() * sizeof(SpecNode*);
+        }
+        return bytes;
+    }
+
+    /**
+     * Enables the external-memory mode.
+     * When the pending states of the lower levels exceed the memory budget,
+     * the largest lists of them are moved to temporary files.
+     * A level that does not fit in the budget is divided into partitions by
+     * the hash codes of the states on disk, and the partitions are
+     * uniquified one by one.
+     * States are written to the files as raw bytes;
+     * therefore they must not contain pointers to other memory blocks.
+     * This function must be called before initialize().
+     * @param directory directory for temporary files; empty for the default.
+     * @param memoryBudget memory budget for the pending states in bytes;
+     *        0 for disabling the external-memory mode.
+     */
+    void useSpillFiles(std::string const& directory, size_t memoryBudget) {
+        spillDirectory = directory;
+        spillBudget = memoryBudget;
+    }
+
+    /**
+     * Selects the reduction rules applied during the construction.
+     * The diagram is reduced in place as the levels are completed,
+     * and it is completely reduced after level 1 is constructed.
+     * @param rule the reduction rules.
+     */
+    void setReduction(DdReduction rule) {
+        sweeper.setReduction(rule);
+    }
+
+    /**
+     * Limits the number of nodes at each level.
+     * When a level has more distinct states than the limit, they are
+     * ordered by prefer_state(void const*, void const*, int) of the spec.
+     * For RESTRICTED_DD, the states beyond the limit are forwarded to the
+     * 0-terminal; the result represents a subset of the exact one.
+     * For RELAXED_DD, the last state within the limit and all states beyond
+     * it are merged into one by relax_states(void*, void*, int);
+     * the result represents a superset of the exact one.
+     * The limit is not applied with the eager deduplication mode or to the
+     * levels divided into partitions in the external-memory mode.
+     * @param width the maximum width; 0 for no limit.
+     * @param rule handling of the states beyond the limit.
+     */
+    void setMaxWidth(size_t width, DdWidthRule rule = RESTRICTED_DD) {
+        maxWidth = width;
+        widthRule = rule;
+    }
+
+    /**
+     * Records the states of the nodes to an archive.
+     * The node IDs in the archive are kept valid as the diagram is swept,
+     * and they are saved in and restored from the checkpoints.
+     * The states below a given level are looked up in the archive before
+     * they are uniquified; a state found there is linked to the recorded
+     * node instead of being expanded.
+     * The eager deduplication mode and the external-memory mode are not
+     * supported.
+     * This function must be called before initialize() or resume().
+     * @param a the archive; null for disabling.
+     * @param level the highest level of the states to be linked;
+     *        0 for recording only.
+     */
+    void useArchive(DdStateArchive<Spec>* a, int level = 0) {
+        archive = a;
+        spliceLevel = level;
+        if (a) sweeper.track(a->nodeIds());
     }
 
     /**
@@ -221,6 +561,10 @@ public:
     void schedule(NodeId* fp, int level, void* s) {
         SpecNode* p0 = snodeTable[level].alloc_front(specNodeSize);
         spec.get_copy(state(p0), s);
+        if (eagerDedup) {
+            if (probe(level, p0, fp) == 0) snodeTable[level].pop_front();
+            return;
+        }
         srcPtr(p0) = fp;
     }
 
@@ -230,6 +574,7 @@ public:
      */
     int initialize(NodeId& root) {
         sweeper.setRoot(root);
+        rootPtr = &root;
         MyVector<char> tmp(spec.datasize());
         void* const tmpState = tmp.data();
         int n = spec.get_root(tmpState);
@@ -251,12 +596,118 @@ public:
         return n;
     }
 
+    /**
+     * Saves a checkpoint of the construction.
+     * It must be called between the constructions of levels.
+     * The construction can be continued from the checkpoint by resume()
+     * of DdBuilder or DdBuilderMP.
+     * States are written to the file as raw bytes;
+     * therefore they must not contain pointers to other memory blocks.
+     * The external-memory mode is not supported.
+     * @param path file name.
+     * @param level the next level to be constructed.
+     */
+    void saveCheckpoint(std::string const& path, int level) {
+        for (size_t i = 0; i < spillFiles.size(); ++i) {
+            if (spillFiles[i] != 0 && spillFiles[i]->size() > 0) {
+                throw std::runtime_error(
+                        "Checkpoint is not supported in the external-memory mode");
+            }
+        }
+
+        DdCheckpointFile file(path, true);
+        int const n = int(snodeTable.size()) - 1;
+        file.putHeader(typenameof(spec), AR, spec.datasize());
+        file.put(n);
+        file.put(level);
+        file.put(*rootPtr);
+        file.putTable(output);
+        sweeper.save(file);
+        file.putVector(oneSrcPtr);
+        if (!oneSrcPtr.empty()) file.write(one, spec.datasize());
+        if (archive) archive->saveIds(file, level);
+
+        NodeBranchLocator<AR> locator(output, rootPtr);
+        MyVector<NodeBranchId> slots;
+
+        for (int i = 1; i <= n; ++i) {
+            MyList<SpecNode>& snodes = snodeTable[i];
+            file.put(snodes.size());
+
+            for (MyList<SpecNode>::iterator t = snodes.begin();
+                    t != snodes.end(); ++t) {
+                slots.clear();
+                if (eagerDedup) {
+                    for (NodeId* fp = srcPtr(*t); fp != 0;
+                            fp = waitingNext(fp)) {
+                        slots.push_back(locator.locate(fp));
+                    }
+                }
+                else {
+                    slots.push_back(locator.locate(srcPtr(*t)));
+                }
+                file.write(state(*t), spec.datasize());
+                file.putVector(slots);
+            }
+        }
+
+        file.commit();
+    }
+
+    /**
+     * Initializes the builder from a checkpoint instead of initialize().
+     * @param path file name of the checkpoint.
+     * @param root result storage.
+     * @return the next level to be constructed.
+     */
+    int resume(std::string const& path, NodeId& root) {
+        DdCheckpointFile file(path, false);
+        file.checkHeader(typenameof(spec), AR, spec.datasize());
+        int const n = file.get<int>();
+        int const level = file.get<int>();
+        sweeper.setRoot(root);
+        rootPtr = &root;
+        root = file.get<NodeId>();
+        init(n);
+        file.getTable(output);
+        sweeper.load(file);
+        file.getVector(oneSrcPtr);
+        if (!oneSrcPtr.empty()) file.read(one, spec.datasize());
+        if (archive) archive->loadIds(file, level);
+
+        NodeBranchLocator<AR> locator(output, rootPtr);
+        MyVector<NodeBranchId> slots;
+        MyVector<char> tmp(spec.datasize());
+        void* const tmpState = tmp.data();
+
+        for (int i = 1; i <= n; ++i) {
+            for (size_t k = file.get<size_t>(); k > 0; --k) {
+                file.read(tmpState, spec.datasize());
+                file.getVector(slots);
+                for (size_t t = 0; t < slots.size(); ++t) {
+                    schedule(locator.resolve(slots[t]), i, tmpState);
+                }
+                spec.destruct(tmpState);
+            }
+        }
+
+        return level;
+    }
+
     /**
      * Builds one level.
      * @param i level.
      */
     void construct(int i) {
         assert(0 < i && size_t(i) < snodeTable.size());
+        if (limiter.enabled()) checkLimits(i);
+
+        if (size_t(i) < spillFiles.size() && spillFiles[i] != 0) {
+            if (!loadSpilledLevel(i)) {
+                constructFromPartitions(i);
+                return;
+            }
+        }
 
         MyList<SpecNode> &snodes = snodeTable[i];
         size_t j0 = output[i].size();
@@ -264,35 +715,27 @@ public:
         int lowestChild = i - 1;
         size_t deadCount = 0;
 
-        {
-            Hasher<Spec> hasher(spec, i);
-            UniqTable uniq(snodes.size() * 2, hasher, hasher);
+        if (eagerDedup) {
+            delete eagerTables[i];
+            eagerTables[i] = 0;
 
             for (MyList<SpecNode>::iterator t = snodes.begin();
                     t != snodes.end(); ++t) {
-                SpecNode* p = *t;
-                SpecNode*& p0 = uniq.add(p);
+                NodeId const f(i, m++);
+                resolveWaiting(srcPtr(*t), f);
+                nodeId(*t) = f;
+            }
+        }
+        else {
+            if (maxWidth > 0) limitWidth(i);
+            Hasher<Spec> hasher(spec, i, hashSlot);
+            UniqTable uniq(snodes.size() * 2, hasher, hasher);
 
-                if (p0 == p) {
-                    nodeId(p) = *srcPtr(p) = NodeId(i, m++);
-                }
-                else {
-                    switch (spec.merge_states(state(p0), state(p))) {
-                    case 1:
-                        nodeId(p0) = 0; // forward to 0-terminal
-                        nodeId(p) = *srcPtr(p) = NodeId(i, m++);
-                        p0 = p;
-                        break;
-                    case 2:
-                        *srcPtr(p) = 0;
-                        nodeId(p) = 1; // unused
-                        break;
-                    default:
-                        *srcPtr(p) = nodeId(p0);
-                        nodeId(p) = 1; // unused
-                        break;
-                    }
-                }
+            for (MyList<SpecNode>::iterator t = snodes.begin();
+                    t != snodes.end(); ++t) {
+                if (i < spliceLevel && splice(*t, i)) continue;
+                hasher.cache(*t);
+                uniquify(uniq, *t, i, m);
             }
 //#ifdef DEBUG
 //            MessageHandler mh;
@@ -300,205 +743,1153 @@ public:
 //#endif
         }
 
+        checkNodeId(i, m);
         output[i].resize(m);
-        Node<AR>* const outi = output[i].data();
         size_t jj = j0;
         SpecNode* pp = snodeTable[i - 1].alloc_front(specNodeSize);
 
         for (; !snodes.empty(); snodes.pop_front()) {
             SpecNode* p = snodes.front();
-            Node<AR>& q = outi[jj];
+
+            if (limiter.enabled() && ++limitCheckCount % 1024 == 0
+                    && !limiter.check(memoryUsage())) {
+                snodeTable[i - 1].pop_front(); // the spare
+                limiter.raise(i, memoryUsage(), output);
+            }
 
             if (nodeId(p) == 1) {
                 spec.destruct(state(p));
                 continue;
             }
 
-            bool allZero = true;
+            if (archive && nodeId(p) != 0) {
+                archive->add(i, state(p), NodeId(i, jj));
+            }
+            if (makeNode(i, jj++, p, pp, lowestChild)) ++deadCount;
+            if (spillBudget > 0 && !eagerDedup) checkSpill(i, pp);
+        }
 
-            for (int b = 0; b < AR; ++b) {
-                if (nodeId(p) == 0) {
-                    q.branch[b] = 0;
-                    continue;
-                }
+        snodeTable[i - 1].pop_front();
+        spec.destructLevel(i);
+        sweeper.update(i, lowestChild, deadCount);
+    }
 
-                spec.get_copy(state(pp), state(p));
-                int ii = spec.get_child(state(pp), i, b);
+private:
+    /*
+     * Drops or relaxes the states at level i beyond the width limit
+     * before they are uniquified.
+     */
+    void limitWidth(int i) {
+        MyList<SpecNode>& snodes = snodeTable[i];
+        size_t const n = snodes.size();
+        if (n <= maxWidth) return;
+
+        MyVector<SpecNode*> nodes;
+        nodes.reserve(n);
+        for (MyList<SpecNode>::iterator t = snodes.begin(); t != snodes.end();
+                ++t) {
+            nodes.push_back(*t);
+        }
 
-                if (ii == 0) {
-                    q.branch[b] = 0;
-                    spec.destruct(state(pp));
+        MyVector<size_t> repOf(n);
+        MyVector<size_t> reps;
+        {
+            IndexHasher hasher(spec, nodes, i);
+            MyHashTable<size_t,IndexHasher,IndexHasher> uniq(n * 2, hasher,
+                    hasher);
+            for (size_t k = 0; k < n; ++k) {
+                repOf[k] = uniq.add(k + 1) - 1;
+                if (repOf[k] == k) reps.push_back(k);
+            }
+        }
+        if (reps.size() <= maxWidth) return;
+
+        std::stable_sort(reps.begin(), reps.end(), Preference(spec, nodes, i));
+        MyVector<size_t> rank(n);
+        for (size_t r = 0; r < reps.size(); ++r) {
+            rank[reps[r]] = r;
+        }
+
+        bool const relax = widthRule == RELAXED_DD;
+        size_t const keep = relax ? maxWidth - 1 : maxWidth;
+        SpecNode* const target = relax ? nodes[reps[keep]] : 0;
+        if (relax) {
+            for (size_t r = keep + 1; r < reps.size(); ++r) {
+                spec.relax_states(state(target), state(nodes[reps[r]]), i);
+            }
+        }
+
+        MyList<SpecNode> kept;
+        for (size_t k = 0; k < n; ++k) {
+            SpecNode* p = nodes[k];
+            if (rank[repOf[k]] < keep) {
+                SpecNode* q = kept.alloc_front(specNodeSize);
+                srcPtr(q) = srcPtr(p);
+                spec.get_copy(state(q), state(p));
+            }
+            else if (relax) {
+                SpecNode* q = kept.alloc_front(specNodeSize);
+                srcPtr(q) = srcPtr(p);
+                spec.get_copy(state(q), state(target));
+            }
+            else {
+                *srcPtr(p) = 0;
+            }
+        }
+
+        for (; !snodes.empty(); snodes.pop_front()) {
+            spec.destruct(state(snodes.front()));
+        }
+        snodes.swap(kept);
+    }
+
+    /*
+     * Links state p at level i to the equivalent node in the archive.
+     * Returns false if it is not found.
+     */
+    bool splice(SpecNode* p, int i) {
+        NodeId const* f = archive->find(i, state(p));
+        if (f == 0) return false;
+        *srcPtr(p) = *f;
+        nodeId(p) = 1; // unused
+        return true;
+    }
+
+    /*
+     * Registers state p to the unique table and gives it a node ID.
+     * m is the number of columns at level i.
+     */
+    void uniquify(UniqTable& uniq, SpecNode* p, int i, size_t& m) {
+        SpecNode*& p0 = uniq.add(p);
+
+        if (p0 == p) {
+            nodeId(p) = *srcPtr(p) = NodeId(i, m++);
+        }
+        else {
+            switch (spec.merge_states(state(p0), state(p))) {
+            case 1:
+                nodeId(p0) = 0; // forward to 0-terminal
+                nodeId(p) = *srcPtr(p) = NodeId(i, m++);
+                p0 = p;
+                break;
+            case 2:
+                *srcPtr(p) = 0;
+                nodeId(p) = 1; // unused
+                break;
+            default:
+                *srcPtr(p) = nodeId(p0);
+                nodeId(p) = 1; // unused
+                break;
+            }
+        }
+    }
+
+    static NodeId*& waitingNext(NodeId* f) {
+        return *reinterpret_cast<NodeId**>(f);
+    }
+
+    /*
+     * Gives node ID f to all branch slots in the waiting list from fp.
+     */
+    static void resolveWaiting(NodeId* fp, NodeId f) {
+        while (fp != 0) {
+            NodeId* next = waitingNext(fp);
+            *fp = f;
+            fp = next;
+        }
+    }
+
+    void clearEagerTables() {
+        for (size_t i = 0; i < eagerTables.size(); ++i) {
+            delete eagerTables[i];
+        }
+        eagerTables.clear();
+    }
+
+    /*
+     * Looks up state p in the unique table of level ii, where fp is the
+     * branch slot for it.
+     * If p is new, it is registered with the waiting list {fp} and the
+     * table entry is returned.
+     * Otherwise, fp is linked to the waiting list of the known state or
+     * set to 0 according to merge_states(), the state of p is destructed,
+     * and null is returned.
+     */
+    SpecNode** probe(int ii, SpecNode* p, NodeId* fp) {
+        Hasher<Spec> hasher(spec, ii, hashSlot);
+        UniqTable*& uniq = eagerTables[ii];
+        if (uniq == 0) uniq = new UniqTable(hasher, hasher);
+
+        hasher.cache(p);
+        SpecNode*& p0 = uniq->add(p);
+
+        if (p0 == p) {
+            srcPtr(p) = fp;
+            waitingNext(fp) = 0;
+            return &p0;
+        }
+
+        switch (spec.merge_states(state(p0), state(p))) {
+        case 1:
+            resolveWaiting(srcPtr(p0), 0); // forward to 0-terminal
+            spec.destruct(state(p0));
+            spec.get_copy(state(p0), state(p));
+            srcPtr(p0) = fp;
+            waitingNext(fp) = 0;
+            break;
+        case 2:
+            *fp = 0;
+            break;
+        default:
+            waitingNext(fp) = srcPtr(p0);
+            srcPtr(p0) = fp;
+            break;
+        }
+
+        spec.destruct(state(p));
+        return 0;
+    }
+
+    /*
+     * Makes the node at column jj of level i from state p,
+     * schedules its child states, and destructs p.
+     * pp is a spare SpecNode at level i-1.
+     * Returns true if all branches are 0.
+     */
+    bool makeNode(int i, size_t jj, SpecNode* p, SpecNode*& pp,
+                  int& lowestChild) {
+        Node<AR>& q = output[i][jj];
+        bool allZero = true;
+
+        for (int b = 0; b < AR; ++b) {
+            if (nodeId(p) == 0) {
+                q.branch[b] = 0;
+                continue;
+            }
+
+            spec.get_copy(state(pp), state(p));
+            int ii = spec.get_child(state(pp), i, b);
+
+            if (ii == 0) {
+                q.branch[b] = 0;
+                spec.destruct(state(pp));
+            }
+            else if (ii < 0) {
+                if (oneSrcPtr.empty()) { // the first 1-terminal candidate
+                    spec.get_copy(one, state(pp));
+                    q.branch[b] = 1;
+                    oneSrcPtr.push_back(NodeBranchId(i, jj, b));
                 }
-                else if (ii < 0) {
-                    if (oneSrcPtr.empty()) { // the first 1-terminal candidate
+                else {
+                    switch (spec.merge_states(one, state(pp))) {
+                    case 1:
+                        while (!oneSrcPtr.empty()) {
+                            NodeBranchId const& nbi = oneSrcPtr.back();
+                            assert(nbi.row >= i);
+                            output[nbi.row][nbi.col].branch[nbi.val] = 0;
+                            oneSrcPtr.pop_back();
+                        }
+                        spec.destruct(one);
                         spec.get_copy(one, state(pp));
                         q.branch[b] = 1;
                         oneSrcPtr.push_back(NodeBranchId(i, jj, b));
+                        break;
+                    case 2:
+                        q.branch[b] = 0;
+                        break;
+                    default:
+                        q.branch[b] = 1;
+                        oneSrcPtr.push_back(NodeBranchId(i, jj, b));
+                        break;
+                    }
+                }
+                spec.destruct(state(pp));
+                allZero = false;
+            }
+            else if (eagerDedup) {
+                SpecNode** entry = probe(ii, pp, &q.branch[b]);
+                if (entry != 0) {
+                    if (ii == i - 1) {
+                        pp = snodeTable[ii].alloc_front(specNodeSize);
                     }
                     else {
-                        switch (spec.merge_states(one, state(pp))) {
-                        case 1:
-                            while (!oneSrcPtr.empty()) {
-                                NodeBranchId const& nbi = oneSrcPtr.back();
-                                assert(nbi.row >= i);
-                                output[nbi.row][nbi.col].branch[nbi.val] = 0;
-                                oneSrcPtr.pop_back();
-                            }
-                            spec.destruct(one);
-                            spec.get_copy(one, state(pp));
-                            q.branch[b] = 1;
-                            oneSrcPtr.push_back(NodeBranchId(i, jj, b));
-                            break;
-                        case 2:
-                            q.branch[b] = 0;
-                            break;
-                        default:
-                            q.branch[b] = 1;
-                            oneSrcPtr.push_back(NodeBranchId(i, jj, b));
-                            break;
-                        }
+                        SpecNode* ppp = snodeTable[ii].alloc_front(
+                                specNodeSize);
+                        spec.get_copy(state(ppp), state(pp));
+                        spec.destruct(state(pp));
+                        srcPtr(ppp) = &q.branch[b];
+                        if (hashSlot > 0) ppp[hashSlot] = pp[hashSlot];
+                        *entry = ppp;
                     }
-                    spec.destruct(state(pp));
-                    allZero = false;
-                }
-                else if (ii == i - 1) {
-                    srcPtr(pp) = &q.branch[b];
-                    pp = snodeTable[ii].alloc_front(specNodeSize);
-                    allZero = false;
-                }
-                else {
-                    assert(ii < i - 1);
-                    SpecNode* ppp = snodeTable[ii].alloc_front(specNodeSize);
-                    spec.get_copy(state(ppp), state(pp));
-                    spec.destruct(state(pp));
-                    srcPtr(ppp) = &q.branch[b];
-                    if (ii < lowestChild) lowestChild = ii;
-                    allZero = false;
                 }
+                if (ii < lowestChild) lowestChild = ii;
+                allZero = false;
+            }
+            else if (ii == i - 1) {
+                srcPtr(pp) = &q.branch[b];
+                pp = snodeTable[ii].alloc_front(specNodeSize);
+                allZero = false;
+            }
+            else {
+                assert(ii < i - 1);
+                SpecNode* ppp = snodeTable[ii].alloc_front(specNodeSize);
+                spec.get_copy(state(ppp), state(pp));
+                spec.destruct(state(pp));
+                srcPtr(ppp) = &q.branch[b];
+                if (ii < lowestChild) lowestChild = ii;
+                allZero = false;
             }
-
-            spec.destruct(state(p));
-            ++jj;
-            if (allZero) ++deadCount;
         }
 
-        snodeTable[i - 1].pop_front();
+        spec.destruct(state(p));
+        return allZero;
+    }
+
+    void checkLimits(int i) {
+        size_t const bytes = memoryUsage();
+        if (!limiter.check(bytes)) limiter.raise(i, bytes, output);
+    }
+
+    size_t recordSize() const {
+        return specNodeSize * sizeof(SpecNode);
+    }
+
+    void clearSpillFiles() {
+        for (size_t i = 0; i < spillFiles.size(); ++i) {
+            delete spillFiles[i];
+        }
+        spillFiles.clear();
+    }
+
+    /*
+     * Moves the pending states at a level to its spill file.
+     */
+    void spill(int level) {
+        if (spillFiles[level] == 0) {
+            spillFiles[level] = new SpillFile(spillDirectory, recordSize());
+        }
+        SpillFile& file = *spillFiles[level];
+        MyList<SpecNode>& snodes = snodeTable[level];
+
+        for (MyList<SpecNode>::iterator t = snodes.begin(); t != snodes.end();
+                ++t) {
+            file.write(*t);
+        }
+        file.close();
+        snodes.clear();
+    }
+
+    /*
+     * Spills the largest lists of pending states while they exceed the
+     * memory budget during construction of level i.
+     * pp is the spare SpecNode at level i-1.
+     */
+    void checkSpill(int i, SpecNode*& pp) {
+        if (++spillCheckCount % 1024 != 0) return;
+
+        size_t const cellSize = recordSize() + sizeof(SpecNode);
+        size_t total = 0;
+        for (int ii = 1; ii < i; ++ii) {
+            total += snodeTable[ii].size() * cellSize;
+        }
+        if (total <= spillBudget) return;
+
+        while (total > spillBudget / 2) {
+            int maxLevel = 1;
+            for (int ii = 2; ii < i; ++ii) {
+                if (snodeTable[ii].size() > snodeTable[maxLevel].size()) {
+                    maxLevel = ii;
+                }
+            }
+
+            bool const spare = (maxLevel == i - 1);
+            size_t const n = snodeTable[maxLevel].size() - (spare ? 1 : 0);
+            if (n == 0) break;
+
+            if (spare) snodeTable[maxLevel].pop_front();
+            spill(maxLevel);
+            total -= n * cellSize;
+            if (spare) pp = snodeTable[maxLevel].alloc_front(specNodeSize);
+        }
+    }
+
+    /*
+     * Reads the spilled states of level i into the memory if they fit
+     * in the budget.
+     * Returns false if they do not fit.
+     */
+    bool loadSpilledLevel(int i) {
+        SpillFile& file = *spillFiles[i];
+        size_t const cellSize = recordSize() + 3 * sizeof(SpecNode*);
+        size_t const n = file.size() + snodeTable[i].size();
+        if (n * cellSize > spillBudget) return false;
+
+        MyVector<SpecNode> buf(specNodeSize);
+        while (file.read(buf.data())) {
+            SpecNode* p = snodeTable[i].alloc_front(specNodeSize);
+            std::copy(buf.data(), buf.data() + specNodeSize, p);
+        }
+
+        delete spillFiles[i];
+        spillFiles[i] = 0;
+        return true;
+    }
+
+    /*
+     * Builds level i by the on-disk hash-partitioned pass.
+     * The states are divided into partitions by their hash codes, and each
+     * partition is uniquified in memory to assign column numbers.
+     * Then the unique states are read again to make the nodes.
+     */
+    void constructFromPartitions(int i) {
+        static size_t const MAX_PARTITIONS = 256;
+        size_t const recSize = recordSize();
+        size_t const cellSize = recSize + 3 * sizeof(SpecNode*);
+        SpillFile& file = *spillFiles[i];
+        MyList<SpecNode>& snodes = snodeTable[i];
+        size_t const n = file.size() + snodes.size();
+        size_t const parts = std::min(
+                (n * cellSize + spillBudget - 1) / spillBudget, MAX_PARTITIONS);
+        MyVector<SpillFile*> partition(parts);
+
+        for (size_t k = 0; k < parts; ++k) {
+            partition[k] = new SpillFile(spillDirectory, recSize);
+        }
+
+        Hasher<Spec> hasher(spec, i, hashSlot);
+        MyVector<SpecNode> buf(specNodeSize);
+        while (file.read(buf.data())) {
+            hasher.cache(buf.data());
+            size_t k = hasher(buf.data()) % parts;
+            partition[k]->write(buf.data());
+        }
+        for (MyList<SpecNode>::iterator t = snodes.begin(); t != snodes.end();
+                ++t) {
+            hasher.cache(*t);
+            size_t k = hasher(*t) % parts;
+            partition[k]->write(*t);
+        }
+        for (size_t k = 0; k < parts; ++k) {
+            partition[k]->close();
+        }
+        delete spillFiles[i];
+        spillFiles[i] = 0;
+        snodes.clear();
+
+        size_t const j0 = output[i].size();
+        size_t m = j0;
+
+        MyVector<SpillFile*> done;
+
+        for (size_t k = 0; k < parts; ++k) {
+            uniquifyPartition(partition[k], parts, hasher, i, m, done);
+        }
+
+        checkNodeId(i, m);
+        output[i].resize(m);
+        size_t jj = j0;
+        int lowestChild = i - 1;
+        size_t deadCount = 0;
+        SpecNode* pp = snodeTable[i - 1].alloc_front(specNodeSize);
+        size_t const chunk = std::max(spillBudget / 4 / recSize, size_t(1));
+        buf.resize(chunk * specNodeSize);
+
+        for (size_t k = 0; k < done.size(); ++k) {
+            SpillFile& part = *done[k];
+            size_t nk;
+
+            while ((nk = part.read(buf.data(), chunk)) > 0) {
+                for (size_t r = 0; r < nk; ++r) {
+                    SpecNode* p = buf.data() + r * specNodeSize;
+                    if (makeNode(i, jj++, p, pp, lowestChild)) ++deadCount;
+                    checkSpill(i, pp);
+                }
+            }
+
+            delete done[k];
+            done[k] = 0;
+        }
+
+        snodeTable[i - 1].pop_front();
         spec.destructLevel(i);
         sweeper.update(i, lowestChild, deadCount);
     }
+
+    /*
+     * Uniquifies the states of a partition of level i and appends the
+     * partition, holding only the unique states, to the list done.
+     * A partition larger than the memory budget is divided again by the
+     * digits of the hash codes above divisor, which are not used so far.
+     * Throws an exception if the hash codes cannot divide it any more.
+     */
+    void uniquifyPartition(SpillFile* part, size_t divisor,
+            Hasher<Spec>& hasher, int i, size_t& m,
+            MyVector<SpillFile*>& done) {
+        static size_t const MAX_PARTITIONS = 256;
+        size_t const recSize = recordSize();
+        size_t const cellSize = recSize + 3 * sizeof(SpecNode*);
+        size_t const nk = part->size();
+
+        if (nk == 0) {
+            delete part;
+            return;
+        }
+
+        if (nk * cellSize > spillBudget) {
+            size_t const parts = std::min(
+                    (nk * cellSize + spillBudget - 1) / spillBudget,
+                    MAX_PARTITIONS);
+            if (divisor > size_t(-1) / parts) {
+                delete part;
+                throw std::runtime_error(
+                        "DdBuilder: too many states with the same hash code"
+                                " to fit in spillMemory");
+            }
+
+            MyVector<SpillFile*> partition(parts);
+            for (size_t k = 0; k < parts; ++k) {
+                partition[k] = new SpillFile(spillDirectory, recSize);
+            }
+
+            MyVector<SpecNode> buf(specNodeSize);
+            while (part->read(buf.data())) {
+                size_t k = hasher(buf.data()) / divisor % parts;
+                partition[k]->write(buf.data());
+            }
+            for (size_t k = 0; k < parts; ++k) {
+                partition[k]->close();
+            }
+            delete part;
+
+            for (size_t k = 0; k < parts; ++k) {
+                uniquifyPartition(partition[k], divisor * parts, hasher, i, m,
+                        done);
+            }
+            return;
+        }
+
+        MyVector<SpecNode> buf(nk * specNodeSize);
+        part->read(buf.data(), nk);
+        part->clear();
+
+        UniqTable uniq(nk * 2, hasher, hasher);
+        for (size_t r = 0; r < nk; ++r) {
+            uniquify(uniq, buf.data() + r * specNodeSize, i, m);
+        }
+
+        for (size_t r = 0; r < nk; ++r) {
+            SpecNode* p = buf.data() + r * specNodeSize;
+            if (nodeId(p) == 1) {
+                spec.destruct(state(p));
+            }
+            else {
+                part->write(p);
+            }
+        }
+        part->close();
+        done.push_back(part);
+    }
 };
 
 /**
  * Multi-threaded breadth-first DD builder.
  */
 template<typename S>
-class DdBuilderMP: DdBuilderMPBase {//TODO oneStorage
+class DdBuilderMP: DdBuilderMPBase {
     typedef S Spec;
     typedef MyHashTable<SpecNode*,Hasher<Spec>,Hasher<Spec> > UniqTable;
+    typedef ConcurrentHashTable<SpecNode*> SharedUniqTable;
     static int const AR = Spec::ARITY;
     static int const TASKS_PER_THREAD = 10;
+    static int64_t const IN_TABLE = int64_t(~uint64_t(0) >> 1);
 
     int const threads;
     int const tasks;
 
     MyVector<Spec> specs;
-    int const specNodeSize;
+    int specNodeSize;
+    int hashSlot;
     NodeTableEntity<AR>& output;
     DdSweeper<AR> sweeper;
+    NodeId* rootPtr;
 
     MyVector<MyVector<MyVector<MyList<SpecNode> > > > snodeTables;
+    MyVector<SpecNode*> nodeSource;
+
+    MyVector<char> oneStorage;
+    void* const one;
+    MyVector<NodeBranchId> oneSrcPtr;
+    MyVector<MyList<SpecNode> > oneCandidates;
+
+    bool useSharedTable;
+    SharedUniqTable sharedUniq;
+    MyVector<size_t> blockColumn;
+
+    WorkStealingScheduler scheduler;
+    LoadImbalanceStats stats;
+    DdBuildLimiter limiter;
+
+#ifdef DEBUG
+    ElapsedTimeCounter etcP1, etcP2, etcS1;
+#endif
+
+    void init(int n) {
+        checkNodeId(n, 0);
+        for (int y = 0; y < threads; ++y) {
+            snodeTables[y].resize(tasks);
+            for (int x = 0; x < tasks; ++x) {
+                snodeTables[y][x].resize(n + 1);
+            }
+        }
+        if (n >= output.numRows()) output.setNumRows(n + 1);
+        oneSrcPtr.clear();
+    }
+
+public:
+    DdBuilderMP(Spec const& s, NodeTableHandler<AR>& output, int n = 0) :
+#ifdef _OPENMP
+            threads(omp_get_max_threads()),
+            tasks(MyHashConstant::primeSize(TASKS_PER_THREAD * threads)),
+#else
+            threads(1),
+            tasks(1),
+#endif
+            specs(threads, s),
+            specNodeSize(getSpecNodeSize(s.datasize())),
+            hashSlot(0),
+            output(output.privateEntity()),
+            sweeper(this->output, oneSrcPtr),
+            rootPtr(0),
+            snodeTables(threads),
+            oneStorage(s.datasize()),
+            one(oneStorage.data()),
+            oneCandidates(threads),
+            useSharedTable(false),
+            blockColumn(threads + 1),
+            scheduler(threads),
+            stats(threads) {
+        if (n >= 1) init(n);
+#ifdef DEBUG
+        MessageHandler mh;
+        mh << "#thread = " << threads << ", #task = " << tasks;
+#endif
+    }
+
+    ~DdBuilderMP() {
+        if (!oneSrcPtr.empty()) {
+            specs[0].destruct(one);
+            oneSrcPtr.clear();
+        }
+        for (int y = 0; y < threads; ++y) {
+            for (size_t x = 0; x < snodeTables[y].size(); ++x) {
+                for (size_t i = 0; i < snodeTables[y][x].size(); ++i) {
+                    MyList<SpecNode>& snodes = snodeTables[y][x][i];
+                    for (; !snodes.empty(); snodes.pop_front()) {
+                        specs[y].destruct(state(snodes.front()));
+                    }
+                }
+            }
+        }
+#ifdef DEBUG
+        MessageHandler mh;
+        mh << "P1: " << etcP1 << "\n";
+        mh << "P2: " << etcP2 << "\n";
+        mh << "S1: " << etcS1 << "\n";
+        mh << "LB: " << stats << "\n";
+#endif
+    }
+
+    /**
+     * Enables the hash cache.
+     * The hash code of each state is computed only once when it is
+     * generated and kept in an extra word of the SpecNode, so that the
+     * unique tables do not call hash_code(), and equal_to() is called
+     * only for the states of the same hash code.
+     * It is effective for large states.
+     * This function must be called before initialize().
+     * @param flag true for enabling the hash cache.
+     * @return old value of the flag.
+     */
+    bool useHashCache(bool flag = true) {
+        bool old = hashSlot > 0;
+        specNodeSize = getSpecNodeSize(specs[0].datasize()) + (flag ? 1 : 0);
+        hashSlot = flag ? specNodeSize - 1 : 0;
+        return old;
+    }
+
+    /**
+     * Sets the resource limits.
+     * The limits are checked at the beginning of each level.
+     * When a limit is exceeded, DdBuildLimitExceeded is thrown.
+     * @param memoryLimit upper limit of memoryUsage() in bytes;
+     *        0 for no limit.
+     * @param timeLimit upper limit of the elapsed time in seconds
+     *        from this call; 0 for no limit.
+     */
+    void setLimits(size_t memoryLimit, double timeLimit) {
+        limiter.set(memoryLimit, timeLimit);
+    }
+
+    /**
+     * Estimates the memory usage of the builder.
+     * It counts the output nodes and the pending states.
+     * @return the memory usage in bytes.
+     */
+    size_t memoryUsage() const {
+        size_t bytes = 0;
+        for (int i = 0; i < output.numRows(); ++i) {
+            bytes += output[i].size() * sizeof(Node<AR> );
+        }
+        for (int y = 0; y < threads; ++y) {
+            for (size_t x = 0; x < snodeTables[y].size(); ++x) {
+                for (size_t i = 0; i < snodeTables[y][x].size(); ++i) {
+                    bytes += snodeTables[y][x][i].size() * (specNodeSize + 1)
+                            * sizeof(SpecNode);
+                }
+            }
+        }
+        return bytes;
+    }
+
+    /**
+     * Selects the unique table backend.
+     * By default, the states of each level are divided into partitions by
+     * their hash codes and each partition is uniquified by a private hash
+     * table of a thread.
+     * A shared table, on the other hand, is a single concurrent hash table
+     * filled by all threads at once, which avoids the partitioning and the
+     * serial column numbering of large levels.
+     * This function must be called before initialize().
+     * merge_states() must not modify the part of the state that is used by
+     * hash_code() or equal_to() when the shared table is used.
+     * @param flag true for using the shared table.
+     * @return old value of the flag.
+     */
+    bool useSharedUniqTable(bool flag = true) {
+        bool old = useSharedTable;
+        useSharedTable = flag;
+        return old;
+    }
+
+    /**
+     * Selects the reduction rules applied during the construction.
+     * The diagram is reduced in place as the levels are completed,
+     * and it is completely reduced after level 1 is constructed.
+     * @param rule the reduction rules.
+     */
+    void setReduction(DdReduction rule) {
+        sweeper.setReduction(rule);
+    }
+
+    /**
+     * Schedules a top-down event.
+     * @param fp result storage.
+     * @param level node level of the event.
+     * @param s node state of the event.
+     */
+    void schedule(NodeId* fp, int level, void* s) {
+        SpecNode* p0 = snodeTables[0][0][level].alloc_front(specNodeSize);
+        specs[0].get_copy(state(p0), s);
+        srcPtr(p0) = fp;
+        Hasher<Spec>(specs[0], level, hashSlot).cache(p0);
+    }
+
+    /**
+     * Initializes the builder.
+     * @param root result storage.
+     */
+    int initialize(NodeId& root) {
+        sweeper.setRoot(root);
+        rootPtr = &root;
+        MyVector<char> tmp(specs[0].datasize());
+        void* const tmpState = tmp.data();
+        int n = specs[0].get_root(tmpState);
+
+        if (n <= 0) {
+            root = n ? 1 : 0;
+            n = 0;
+        }
+        else {
+            init(n);
+            schedule(&root, n, tmpState);
+        }
+
+        specs[0].destruct(tmpState);
+        return n;
+    }
+
+    /**
+     * Saves a checkpoint of the construction.
+     * It must be called between the constructions of levels.
+     * The construction can be continued from the checkpoint by resume()
+     * of DdBuilder or DdBuilderMP.
+     * States are written to the file as raw bytes;
+     * therefore they must not contain pointers to other memory blocks.
+     * @param path file name.
+     * @param level the next level to be constructed.
+     */
+    void saveCheckpoint(std::string const& path, int level) {
+        Spec& spec = specs[0];
+        DdCheckpointFile file(path, true);
+        int const n = int(snodeTables[0][0].size()) - 1;
+        file.putHeader(typenameof(spec), AR, spec.datasize());
+        file.put(n);
+        file.put(level);
+        file.put(*rootPtr);
+        file.putTable(output);
+        sweeper.save(file);
+        file.putVector(oneSrcPtr);
+        if (!oneSrcPtr.empty()) file.write(one, spec.datasize());
+
+        NodeBranchLocator<AR> locator(output, rootPtr);
+        MyVector<NodeBranchId> slots(1);
+
+        for (int i = 1; i <= n; ++i) {
+            size_t m = 0;
+            for (int y = 0; y < threads; ++y) {
+                for (int x = 0; x < tasks; ++x) {
+                    m += snodeTables[y][x][i].size();
+                }
+            }
+            file.put(m);
+
+            for (int y = 0; y < threads; ++y) {
+                for (int x = 0; x < tasks; ++x) {
+                    MyList<SpecNode>& snodes = snodeTables[y][x][i];
+                    for (MyList<SpecNode>::iterator t = snodes.begin();
+                            t != snodes.end(); ++t) {
+                        slots[0] = locator.locate(srcPtr(*t));
+                        file.write(state(*t), spec.datasize());
+                        file.putVector(slots);
+                    }
+                }
+            }
+        }
+
+        file.commit();
+    }
+
+    /**
+     * Initializes the builder from a checkpoint instead of initialize().
+     * @param path file name of the checkpoint.
+     * @param root result storage.
+     * @return the next level to be constructed.
+     */
+    int resume(std::string const& path, NodeId& root) {
+        Spec& spec = specs[0];
+        DdCheckpointFile file(path, false);
+        file.checkHeader(typenameof(spec), AR, spec.datasize());
+        int const n = file.get<int>();
+        int const level = file.get<int>();
+        sweeper.setRoot(root);
+        rootPtr = &root;
+        root = file.get<NodeId>();
+        init(n);
+        file.getTable(output);
+        sweeper.load(file);
+
+        file.getVector(oneSrcPtr);
+        if (!oneSrcPtr.empty()) file.read(one, spec.datasize());
+
+        NodeBranchLocator<AR> locator(output, rootPtr);
+        MyVector<NodeBranchId> slots;
+        MyVector<char> tmp(spec.datasize());
+        void* const tmpState = tmp.data();
+        size_t k = 0;
+
+        for (int i = 1; i <= n; ++i) {
+            for (size_t m = file.get<size_t>(); m > 0; --m) {
+                file.read(tmpState, spec.datasize());
+                file.getVector(slots);
+                size_t const h = spec.hash_code(tmpState, i);
+                for (size_t t = 0; t < slots.size(); ++t, ++k) {
+                    int x = useSharedTable ? k % tasks : h % tasks;
+                    SpecNode* p = snodeTables[k % threads][x][i].alloc_front(
+                            specNodeSize);
+                    spec.get_copy(state(p), tmpState);
+                    srcPtr(p) = locator.resolve(slots[t]);
+                    if (hashSlot > 0) p[hashSlot].code = h;
+                }
+                spec.destruct(tmpState);
+            }
+        }
+
+        return level;
+    }
+
+    /**
+     * Builds one level.
+     * @param i level.
+     */
+    void construct(int i) {
+        assert(0 < i && i < output.numRows());
+        assert(output.numRows() - snodeTables[0][0].size() == 0);
+        if (limiter.enabled()) {
+            size_t const bytes = memoryUsage();
+            if (!limiter.check(bytes)) limiter.raise(i, bytes, output);
+        }
+
+        MyVector<size_t> nodeColumn(tasks);
+        MyVector<size_t> cumWeight(tasks + 1);
+        size_t const m0 = output[i].size();
+        int lowestChild = i - 1;
+        size_t deadCount = 0;
+
+        cumWeight[0] = 0;
+        for (int x = 0; x < tasks; ++x) {
+            size_t m = 0;
+            for (int y = 0; y < threads; ++y) {
+                m += snodeTables[y][x][i].size();
+            }
+            cumWeight[x + 1] = cumWeight[x] + m;
+        }
+
+        if (useSharedTable) {
+            constructWithSharedTable(i, cumWeight);
+            return;
+        }
+
+        scheduler.reset(tasks, cumWeight.data());
+
+#ifdef DEBUG
+        etcP1.start();
+#endif
+
+#ifdef _OPENMP
+        // OpenMP 2.0 does not support reduction(min:lowestChild)
+#pragma omp parallel reduction(+:deadCount)
+#endif
+        {
+#ifdef _OPENMP
+            int yy = omp_get_thread_num();
+            NumaPlacement::bindThread(yy, threads);
+#else
+            int yy = 0;
+#endif
+
+            Spec& spec = specs[yy];
+            MyVector<char> tmp(spec.datasize());
+            void* const tmpState = tmp.data();
+            Hasher<Spec> hasher(spec, i, hashSlot);
+            UniqTable uniq(hasher, hasher);
+            int lc = lowestChild;
+            size_t begin, end;
+
+            while (scheduler.next(yy, begin, end)) {
+                for (int x = begin; x < int(end); ++x) {
+                    size_t m = cumWeight[x + 1] - cumWeight[x];
+                    nodeColumn[x] = 0;
+                    if (m == 0) continue;
+
+                    uniq.initialize(m * 2);
+                    size_t j = 0;
+
+                    for (int y = 0; y < threads; ++y) {
+                        MyList<SpecNode> &snodes = snodeTables[y][x][i];
+
+                        for (MyList<SpecNode>::iterator t = snodes.begin();
+                                t != snodes.end(); ++t) {
+                            SpecNode* p = *t;
+                            SpecNode*& p0 = uniq.add(p);
+
+                            if (p0 == p) {
+                                code(p) = ++j; // code(p) >= 1
+                            }
+                            else {
+                                switch (spec.merge_states(state(p0), state(p))) {
+                                case 1:
+                                    code(p0) = 0;
+                                    code(p) = ++j; // code(p) >= 1
+                                    p0 = p;
+                                    break;
+                                case 2:
+                                    code(p) = 0;
+                                    break;
+                                default:
+                                    code(p) = -code(p0);
+                                    break;
+                                }
+                            }
+                        }
+                    }
+
+                    nodeColumn[x] = j;
+                }
+            }
+
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+            {
+                stats.add(scheduler);
+#ifdef DEBUG
+                etcP1.stop();
+                etcS1.start();
+#endif
+                size_t m = m0;
+                for (int x = 0; x < tasks; ++x) {
+                    size_t j = nodeColumn[x];
+                    nodeColumn[x] = m;
+                    m += j;
+                }
+
+                output.initRow(i, m);
+                NumaPlacement::interleave(output[i].data(),
+                        m * sizeof(Node<AR>));
+                nodeSource.resize(m - m0);
+                scheduler.reset(tasks, cumWeight.data());
+#ifdef DEBUG
+                etcS1.stop();
+                etcP2.start();
+#endif
+            }
+
+            // Resolves merged nodes and lists up the new nodes.
+            while (scheduler.next(yy, begin, end)) {
+                for (int x = begin; x < int(end); ++x) {
+                    size_t j0 = nodeColumn[x] - 1; // code(p) >= 1
+
+                    for (int y = 0; y < threads; ++y) {
+                        MyList<SpecNode> &snodes = snodeTables[y][x][i];
+
+                        for (MyList<SpecNode>::iterator t = snodes.begin();
+                                t != snodes.end(); ++t) {
+                            SpecNode* p = *t;
+
+                            if (code(p) <= 0) {
+                                *srcPtr(p) = code(p) ? NodeId(i, j0 - code(p)) : 0;
+                                spec.destruct(state(p));
+                            }
+                            else {
+                                nodeSource[j0 + code(p) - m0] = p;
+                            }
+                        }
+                    }
+                }
+            }
+
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+            {
+                stats.add(scheduler);
+                scheduler.reset(nodeSource.size());
+            }
+
+            // Makes the new nodes; this phase is split into column ranges
+            // so that a heavy task is shared by multiple threads.
+            while (scheduler.next(yy, begin, end)) {
+                for (size_t k = begin; k < end; ++k) {
+                    if (makeNode(spec, tmpState, yy, i, m0 + k, nodeSource[k],
+                            lc)) ++deadCount;
+                }
+            }
 
-#ifdef DEBUG
-    ElapsedTimeCounter etcP1, etcP2, etcS1;
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp for schedule(dynamic)
 #endif
-
-    void init(int n) {
-        for (int y = 0; y < threads; ++y) {
-            snodeTables[y].resize(tasks);
             for (int x = 0; x < tasks; ++x) {
-                snodeTables[y][x].resize(n + 1);
+                for (int y = 0; y < threads; ++y) {
+                    snodeTables[y][x][i].clear();
+                }
             }
-        }
-        if (n >= output.numRows()) output.setNumRows(n + 1);
-    }
 
-public:
-    DdBuilderMP(Spec const& s, NodeTableHandler<AR>& output, int n = 0) :
+            spec.destructLevel(i);
+
 #ifdef _OPENMP
-            threads(omp_get_max_threads()),
-            tasks(MyHashConstant::primeSize(TASKS_PER_THREAD * threads)),
-#else
-            threads(1),
-            tasks(1),
-#endif
-            specs(threads, s),
-            specNodeSize(getSpecNodeSize(s.datasize())),
-            output(output.privateEntity()),
-            sweeper(this->output),
-            snodeTables(threads) {
-        if (n >= 1) init(n);
-#ifdef DEBUG
-        MessageHandler mh;
-        mh << "#thread = " << threads << ", #task = " << tasks;
+#pragma omp critical
 #endif
-    }
+            if (lc < lowestChild) lowestChild = lc;
+        }
 
+        checkNodeId(i, output[i].size());
+        stats.add(scheduler);
+        stats.endLevel(i);
+        nodeSource.clear();
+        mergeOneCandidates(specs[0], one, oneSrcPtr, oneCandidates, output, i);
+        sweeper.update(i, lowestChild, deadCount);
 #ifdef DEBUG
-    ~DdBuilderMP() {
-        MessageHandler mh;
-        mh << "P1: " << etcP1 << "\n";
-        mh << "P2: " << etcP2 << "\n";
-        mh << "S1: " << etcS1 << "\n";
-    }
+        etcP2.stop();
 #endif
-
-    /**
-     * Schedules a top-down event.
-     * @param fp result storage.
-     * @param level node level of the event.
-     * @param s node state of the event.
-     */
-    void schedule(NodeId* fp, int level, void* s) {
-        SpecNode* p0 = snodeTables[0][0][level].alloc_front(specNodeSize);
-        specs[0].get_copy(state(p0), s);
-        srcPtr(p0) = fp;
     }
 
-    /**
-     * Initializes the builder.
-     * @param root result storage.
+private:
+    /*
+     * Makes a node from its state and schedules the child states.
+     * Returns true if the node has no path to a terminal other than 0.
      */
-    int initialize(NodeId& root) {
-        sweeper.setRoot(root);
-        MyVector<char> tmp(specs[0].datasize());
-        void* const tmpState = tmp.data();
-        int n = specs[0].get_root(tmpState);
+    bool makeNode(Spec& spec, void* tmpState, int yy, int i, size_t j,
+                  SpecNode* p, int& lc) {
+        Node<AR> &q = output[i][j];
 
-        if (n <= 0) {
-            root = n ? 1 : 0;
-            n = 0;
+        if (p == 0) { // forwarded to 0-terminal by merge_states
+            for (int b = 0; b < AR; ++b) {
+                q.branch[b] = 0;
+            }
+            return true;
         }
-        else {
-            init(n);
-            schedule(&root, n, tmpState);
+
+        *srcPtr(p) = NodeId(i, j);
+        bool allZero = true;
+        void* s = tmpState;
+
+        for (int b = 0; b < AR; ++b) {
+            if (b < AR - 1) {
+                spec.get_copy(s, state(p));
+            }
+            else {
+                s = state(p);
+            }
+
+            int ii = spec.get_child(s, i, b);
+
+            if (ii == 0) {
+                q.branch[b] = 0;
+            }
+            else if (ii < 0) { // merged by mergeOneCandidates()
+                SpecNode* pp = oneCandidates[yy].alloc_front(specNodeSize);
+                spec.get_copy(state(pp), s);
+                srcPtr(pp) = &q.branch[b];
+                q.branch[b] = 1;
+                allZero = false;
+            }
+            else {
+                assert(ii <= i - 1);
+                // The shared table does not need hash partitioning.
+                size_t const h = (hashSlot > 0 || !useSharedTable) ?
+                        spec.hash_code(s, ii) : 0;
+                int xx = useSharedTable ? (j * AR + b) % tasks : h % tasks;
+                SpecNode* pp = snodeTables[yy][xx][ii].alloc_front(
+                        specNodeSize);
+                spec.get_copy(state(pp), s);
+                srcPtr(pp) = &q.branch[b];
+                if (hashSlot > 0) pp[hashSlot].code = h;
+                if (ii < lc) lc = ii;
+                allZero = false;
+            }
+
+            spec.destruct(s);
         }
 
-        specs[0].destruct(tmpState);
-        return n;
+        return allZero;
     }
 
-    /**
-     * Builds one level.
-     * @param i level.
+    /*
+     * Builds one level using the shared unique table.
+     * Column numbers are given to the occupied slots of the table
+     * in the slot order by a parallel prefix sum.
      */
-    void construct(int i) {
-        assert(0 < i && i < output.numRows());
-        assert(output.numRows() - snodeTables[0][0].size() == 0);
-
-        MyVector<size_t> nodeColumn(tasks);
+    void constructWithSharedTable(int i, MyVector<size_t> const& cumWeight) {
+        size_t const m0 = output[i].size();
         int lowestChild = i - 1;
         size_t deadCount = 0;
 
+        sharedUniq.initialize(cumWeight[tasks]);
+        scheduler.reset(tasks, cumWeight.data());
+
 #ifdef DEBUG
         etcP1.start();
 #endif
@@ -510,7 +1901,7 @@ public:
         {
 #ifdef _OPENMP
             int yy = omp_get_thread_num();
-            //CPUAffinity().bind(yy);
+            NumaPlacement::bindThread(yy, threads);
 #else
             int yy = 0;
 #endif
@@ -518,141 +1909,178 @@ public:
             Spec& spec = specs[yy];
             MyVector<char> tmp(spec.datasize());
             void* const tmpState = tmp.data();
-            Hasher<Spec> hasher(spec, i);
-            UniqTable uniq(hasher, hasher);
+            Hasher<Spec> hasher(spec, i, hashSlot);
             int lc = lowestChild;
+            size_t begin, end;
+
+            // code(p) == IN_TABLE: put in the table, 0: forwarded to
+            // 0-terminal, negative: merged into the node at address -code(p).
+            // The states are merged after all insertions, so that merge_states
+            // never runs while other threads compare states in add().
+            // Each thread writes the codes of its own nodes only; a node
+            // replaced in the table keeps IN_TABLE and is found to be
+            // forwarded to 0-terminal when the columns are assigned.
+            while (scheduler.next(yy, begin, end)) {
+                for (int x = begin; x < int(end); ++x) {
+                    for (int y = 0; y < threads; ++y) {
+                        MyList<SpecNode> &snodes = snodeTables[y][x][i];
+
+                        for (MyList<SpecNode>::iterator t = snodes.begin();
+                                t != snodes.end(); ++t) {
+                            SpecNode* p = *t;
+                            size_t k;
+                            code(p) = (sharedUniq.add(p, hasher, hasher, k) == p) ?
+                                    IN_TABLE : -int64_t(k + 1); // slot to merge
+                        }
+                    }
+                }
+            }
 
 #ifdef _OPENMP
-#pragma omp for schedule(dynamic)
+#pragma omp barrier
+#pragma omp single
 #endif
-            for (int x = 0; x < tasks; ++x) {
-                size_t m = 0;
-                for (int y = 0; y < threads; ++y) {
-                    m += snodeTables[y][x][i].size();
-                }
-                if (m == 0) continue;
+            {
+                stats.add(scheduler);
+                scheduler.reset(tasks, cumWeight.data());
+            }
 
-                uniq.initialize(m * 2);
-                size_t j = 0;
+            while (scheduler.next(yy, begin, end)) {
+                for (int x = begin; x < int(end); ++x) {
+                    for (int y = 0; y < threads; ++y) {
+                        MyList<SpecNode> &snodes = snodeTables[y][x][i];
 
-                for (int y = 0; y < threads; ++y) {
-                    MyList<SpecNode> &snodes = snodeTables[y][x][i];
+                        for (MyList<SpecNode>::iterator t = snodes.begin();
+                                t != snodes.end(); ++t) {
+                            SpecNode* p = *t;
+                            if (code(p) >= 0) continue;
+                            size_t const k = -code(p) - 1;
 
-                    for (MyList<SpecNode>::iterator t = snodes.begin();
-                            t != snodes.end(); ++t) {
-                        SpecNode* p = *t;
-                        SpecNode*& p0 = uniq.add(p);
+                            sharedUniq.lock(k);
+                            SpecNode* p0 = sharedUniq.get(k);
 
-                        if (p0 == p) {
-                            code(p) = ++j; // code(p) >= 1
-                        }
-                        else {
                             switch (spec.merge_states(state(p0), state(p))) {
                             case 1:
-                                code(p0) = 0;
-                                code(p) = ++j; // code(p) >= 1
-                                p0 = p;
+                                code(p) = IN_TABLE;
+                                sharedUniq.replace(k, p);
                                 break;
                             case 2:
                                 code(p) = 0;
                                 break;
                             default:
-                                code(p) = -code(p0);
+                                code(p) = -reinterpret_cast<intptr_t>(p0);
                                 break;
                             }
+
+                            sharedUniq.unlock(k);
                         }
                     }
                 }
+            }
 
-                nodeColumn[x] = j;
-//#ifdef DEBUG
-//                MessageHandler mh;
-//#ifdef _OPENMP
-//#pragma omp critical
-//#endif
-//                mh << "table_size[" << i << "][" << x << "] = " << uniq.tableSize() << "\n";
-//#endif
+            size_t const tableSize = sharedUniq.tableSize();
+            size_t const k0 = tableSize * yy / threads;
+            size_t const k1 = tableSize * (yy + 1) / threads;
+            size_t count = 0;
+
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
+            for (size_t k = k0; k < k1; ++k) {
+                if (sharedUniq.get(k) != 0) ++count;
             }
+            blockColumn[yy + 1] = count;
 
 #ifdef _OPENMP
+#pragma omp barrier
 #pragma omp single
 #endif
             {
+                stats.add(scheduler);
 #ifdef DEBUG
                 etcP1.stop();
                 etcS1.start();
 #endif
-                size_t m = output[i].size();
-                for (int x = 0; x < tasks; ++x) {
-                    size_t j = nodeColumn[x];
-                    nodeColumn[x] = (j >= 1) ? m : -1; // -1 for skip
-                    m += j;
+                blockColumn[0] = m0;
+                for (int y = 0; y < threads; ++y) {
+                    blockColumn[y + 1] += blockColumn[y];
                 }
 
-                output.initRow(i, m);
+                output.initRow(i, blockColumn[threads]);
+                NumaPlacement::interleave(output[i].data(),
+                        blockColumn[threads] * sizeof(Node<AR>));
+                nodeSource.resize(blockColumn[threads] - m0);
 #ifdef DEBUG
                 etcS1.stop();
                 etcP2.start();
 #endif
             }
 
+            size_t j = blockColumn[yy];
+            for (size_t k = k0; k < k1; ++k) {
+                SpecNode* p = sharedUniq.get(k);
+                if (p == 0) continue;
+                code(p) = j + 1; // 1 <= code(p) < IN_TABLE
+                nodeSource[j - m0] = p;
+                ++j;
+            }
+            sharedUniq.clear(k0, k1);
+
 #ifdef _OPENMP
-#pragma omp for schedule(dynamic)
+#pragma omp barrier
+#pragma omp single
 #endif
-            for (int x = 0; x < tasks; ++x) {
-                if (nodeColumn[x] < 0) continue; // -1 for skip
-                size_t j0 = nodeColumn[x] - 1;   // code(p) >= 1
-
-                for (int y = 0; y < threads; ++y) {
-                    MyList<SpecNode> &snodes = snodeTables[y][x][i];
-
-                    for (; !snodes.empty(); snodes.pop_front()) {
-                        SpecNode* p = snodes.front();
-
-                        if (code(p) <= 0) {
-                            *srcPtr(p) = code(p) ? NodeId(i, j0 - code(p)) : 0;
-                            spec.destruct(state(p));
-                            continue;
-                        }
-
-                        size_t j = j0 + code(p);
-                        *srcPtr(p) = NodeId(i, j);
-
-                        Node<AR> &q = output[i][j];
-                        bool allZero = true;
-                        void* s = tmpState;
-
-                        for (int b = 0; b < AR; ++b) {
-                            if (b < AR - 1) {
-                                spec.get_copy(s, state(p));
+            scheduler.reset(tasks, cumWeight.data());
+
+            // Resolves merged nodes.
+            while (scheduler.next(yy, begin, end)) {
+                for (int x = begin; x < int(end); ++x) {
+                    for (int y = 0; y < threads; ++y) {
+                        MyList<SpecNode> &snodes = snodeTables[y][x][i];
+
+                        for (MyList<SpecNode>::iterator t = snodes.begin();
+                                t != snodes.end(); ++t) {
+                            SpecNode* p = *t;
+                            if (code(p) > 0 && code(p) != IN_TABLE) continue;
+
+                            if (code(p) < 0) {
+                                SpecNode* p0 =
+                                        reinterpret_cast<SpecNode*>(-code(p));
+                                *srcPtr(p) = (code(p0) > 0 && code(p0) != IN_TABLE) ?
+                                        NodeId(i, code(p0) - 1) : NodeId(0);
                             }
                             else {
-                                s = state(p);
+                                *srcPtr(p) = 0;
                             }
+                            spec.destruct(state(p));
+                        }
+                    }
+                }
+            }
 
-                            int ii = spec.get_child(s, i, b);
-
-                            if (ii <= 0) {
-                                q.branch[b] = ii ? 1 : 0;
-                                if (ii) allZero = false;
-                            }
-                            else {
-                                assert(ii <= i - 1);
-                                int xx = spec.hash_code(s, ii) % tasks;
-                                SpecNode* pp =
-                                        snodeTables[yy][xx][ii].alloc_front(
-                                                specNodeSize);
-                                spec.get_copy(state(pp), s);
-                                srcPtr(pp) = &q.branch[b];
-                                if (ii < lc) lc = ii;
-                                allZero = false;
-                            }
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+            {
+                stats.add(scheduler);
+                scheduler.reset(nodeSource.size());
+            }
 
-                            spec.destruct(s);
-                        }
+            while (scheduler.next(yy, begin, end)) {
+                for (size_t k = begin; k < end; ++k) {
+                    if (makeNode(spec, tmpState, yy, i, m0 + k, nodeSource[k],
+                            lc)) ++deadCount;
+                }
+            }
 
-                        if (allZero) ++deadCount;
-                    }
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp for schedule(dynamic)
+#endif
+            for (int x = 0; x < tasks; ++x) {
+                for (int y = 0; y < threads; ++y) {
+                    snodeTables[y][x][i].clear();
                 }
             }
 
@@ -664,11 +2092,25 @@ public:
             if (lc < lowestChild) lowestChild = lc;
         }
 
+        checkNodeId(i, output[i].size());
+        stats.add(scheduler);
+        stats.endLevel(i);
+        nodeSource.clear();
+        mergeOneCandidates(specs[0], one, oneSrcPtr, oneCandidates, output, i);
         sweeper.update(i, lowestChild, deadCount);
 #ifdef DEBUG
         etcP2.stop();
 #endif
     }
+
+public:
+    /**
+     * Gets the load-imbalance statistics of the parallel phases.
+     * @return the statistics.
+     */
+    LoadImbalanceStats const& loadImbalance() const {
+        return stats;
+    }
 };
 
 /**
@@ -823,6 +2265,7 @@ public:
             }
         }
 
+        checkNodeId(i, mm);
         output.initRow(i, mm);
         Node<AR>* const outi = output[i].data();
         size_t jj = 0;
@@ -955,7 +2398,7 @@ private:
  * Multi-threaded breadth-first ZDD subset builder.
  */
 template<typename S>
-class ZddSubsetterMP: DdBuilderMPBase { //TODO oneStorage
+class ZddSubsetterMP: DdBuilderMPBase {
 //typedef typename std::remove_const<typename std::remove_reference<S>::type>::type Spec;
     typedef S Spec;
     typedef MyHashTable<SpecNode*,Hasher<Spec>,Hasher<Spec> > UniqTable;
@@ -971,6 +2414,15 @@ class ZddSubsetterMP: DdBuilderMPBase { //TODO oneStorage
 
     MyVector<MyVector<MyVector<MyListOnPool<SpecNode> > > > snodeTables;
     MyVector<MemoryPools> pools;
+    MyVector<SpecNode*> nodeSource;
+
+    MyVector<char> oneStorage;
+    void* const one;
+    MyVector<NodeBranchId> oneSrcPtr;
+    MyVector<MyList<SpecNode> > oneCandidates;
+
+    WorkStealingScheduler scheduler;
+    LoadImbalanceStats stats;
 
 public:
     ZddSubsetterMP(NodeTableHandler<AR> const& input,
@@ -986,9 +2438,21 @@ public:
             specNodeSize(getSpecNodeSize(s.datasize())),
             input(*input),
             output(output.privateEntity()),
-            sweeper(this->output),
+            sweeper(this->output, oneSrcPtr),
             snodeTables(threads),
-            pools(threads) {
+            pools(threads),
+            oneStorage(s.datasize()),
+            one(oneStorage.data()),
+            oneCandidates(threads),
+            scheduler(threads),
+            stats(threads) {
+    }
+
+    ~ZddSubsetterMP() {
+        if (!oneSrcPtr.empty()) {
+            specs[0].destruct(one);
+            oneSrcPtr.clear();
+        }
     }
 
     /**
@@ -1050,9 +2514,22 @@ public:
         size_t const m = input[i].size();
 
         MyVector<size_t> nodeColumn(m);
+        MyVector<size_t> cumWeight(m + 1);
         int lowestChild = i - 1;
         size_t deadCount = 0;
 
+        cumWeight[0] = 0;
+        for (size_t j = 0; j < m; ++j) {
+            size_t mm = 0;
+            for (int y = 0; y < threads; ++y) {
+                if (snodeTables[y][i].empty()) continue;
+                mm += snodeTables[y][i][j].size();
+            }
+            cumWeight[j + 1] = cumWeight[j] + mm;
+        }
+
+        scheduler.reset(m, cumWeight.data());
+
 #ifdef _OPENMP
         // OpenMP 2.0 does not support reduction(min:lowestChild)
 #pragma omp parallel reduction(+:deadCount)
@@ -1060,6 +2537,7 @@ public:
         {
 #ifdef _OPENMP
             int yy = omp_get_thread_num();
+            NumaPlacement::bindThread(yy, threads);
 #else
             int yy = 0;
 #endif
@@ -1069,50 +2547,50 @@ public:
             Hasher<Spec> hasher(spec, i);
             UniqTable uniq(hasher, hasher);
             int lc = lowestChild;
+            size_t begin, end;
 
-#ifdef _OPENMP
-#pragma omp for schedule(dynamic)
-#endif
-            for (intmax_t j = 0; j < intmax_t(m); ++j) {
-                size_t mm = 0;
-                for (int y = 0; y < threads; ++y) {
-                    if (snodeTables[y][i].empty()) continue;
-                    MyListOnPool<SpecNode> &snodes = snodeTables[y][i][j];
-                    mm += snodes.size();
-                }
-                uniq.initialize(mm * 2);
-                size_t jj = 0;
+            while (scheduler.next(yy, begin, end)) {
+                for (size_t j = begin; j < end; ++j) {
+                    size_t mm = cumWeight[j + 1] - cumWeight[j];
+                    nodeColumn[j] = 0;
+                    if (mm == 0) continue;
 
-                for (int y = 0; y < threads; ++y) {
-                    if (snodeTables[y][i].empty()) continue;
-                    MyListOnPool<SpecNode> &snodes = snodeTables[y][i][j];
+                    uniq.initialize(mm * 2);
+                    size_t jj = 0;
 
-                    for (MyListOnPool<SpecNode>::iterator t = snodes.begin();
-                            t != snodes.end(); ++t) {
-                        SpecNode* p = *t;
-                        SpecNode* pp = uniq.add(p);
+                    for (int y = 0; y < threads; ++y) {
+                        if (snodeTables[y][i].empty()) continue;
+                        MyListOnPool<SpecNode> &snodes = snodeTables[y][i][j];
 
-                        if (pp == p) {
-                            code(p) = ++jj; // code(p) >= 1
-                        }
-                        else {
-                            code(p) = -code(pp);
-                            if (int prune = spec.merge_states(state(pp),
-                                    state(p))) {
-                                if (prune & 1) code(pp) = 0;
-                                if (prune & 2) code(p) = 0;
+                        for (MyListOnPool<SpecNode>::iterator t = snodes.begin();
+                                t != snodes.end(); ++t) {
+                            SpecNode* p = *t;
+                            SpecNode* pp = uniq.add(p);
+
+                            if (pp == p) {
+                                code(p) = ++jj; // code(p) >= 1
+                            }
+                            else {
+                                code(p) = -code(pp);
+                                if (int prune = spec.merge_states(state(pp),
+                                        state(p))) {
+                                    if (prune & 1) code(pp) = 0;
+                                    if (prune & 2) code(p) = 0;
+                                }
                             }
                         }
                     }
-                }
 
-                nodeColumn[j] = jj;
+                    nodeColumn[j] = jj;
+                }
             }
 
 #ifdef _OPENMP
+#pragma omp barrier
 #pragma omp single
 #endif
             {
+                stats.add(scheduler);
                 size_t mm = 0;
                 for (size_t j = 0; j < m; ++j) {
                     size_t jj = nodeColumn[j];
@@ -1121,89 +2599,128 @@ public:
                 }
 
                 output.initRow(i, mm);
+                NumaPlacement::interleave(output[i].data(),
+                        mm * sizeof(Node<AR>));
+                nodeSource.resize(mm);
+                scheduler.reset(m, cumWeight.data());
             }
 
-#ifdef _OPENMP
-#pragma omp for schedule(dynamic)
-#endif
-            for (intmax_t j = 0; j < intmax_t(m); ++j) {
-                size_t const jj0 = nodeColumn[j] - 1;   // code(p) >= 1
-
-                for (int y = 0; y < threads; ++y) {
-                    if (snodeTables[y][i].empty()) continue;
+            // Resolves merged nodes and lists up the new nodes.
+            while (scheduler.next(yy, begin, end)) {
+                for (size_t j = begin; j < end; ++j) {
+                    size_t const jj0 = nodeColumn[j] - 1; // code(p) >= 1
 
-                    MyListOnPool<SpecNode> &snodes = snodeTables[y][i][j];
+                    for (int y = 0; y < threads; ++y) {
+                        if (snodeTables[y][i].empty()) continue;
+                        MyListOnPool<SpecNode> &snodes = snodeTables[y][i][j];
 
-                    for (MyListOnPool<SpecNode>::iterator t = snodes.begin();
-                            t != snodes.end(); ++t) {
-                        SpecNode* p = *t;
+                        for (MyListOnPool<SpecNode>::iterator t = snodes.begin();
+                                t != snodes.end(); ++t) {
+                            SpecNode* p = *t;
 
-                        if (code(p) <= 0) {
-                            *srcPtr(p) = code(p) ? NodeId(i, jj0 - code(p)) : 0;
-                            spec.destruct(state(p));
-                            continue;
+                            if (code(p) <= 0) {
+                                *srcPtr(p) = code(p) ? NodeId(i, jj0 - code(p)) : 0;
+                                spec.destruct(state(p));
+                            }
+                            else {
+                                nodeSource[jj0 + code(p)] = p;
+                                code(p) = j; // input column
+                            }
                         }
+                    }
+                }
+            }
+
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+            {
+                stats.add(scheduler);
+                scheduler.reset(nodeSource.size());
+            }
 
-                        size_t const jj = jj0 + code(p);
-                        *srcPtr(p) = NodeId(i, jj);
-                        Node<AR> &q = output[i][jj];
-                        bool allZero = true;
-                        void* s = tmpState;
+            // Makes the new nodes; this phase is split into column ranges
+            // so that a heavy input node is shared by multiple threads.
+            while (scheduler.next(yy, begin, end)) {
+                for (size_t jj = begin; jj < end; ++jj) {
+                    SpecNode* p = nodeSource[jj];
+                    Node<AR> &q = output[i][jj];
 
+                    if (p == 0) { // forwarded to 0-terminal by merge_states
                         for (int b = 0; b < AR; ++b) {
-                            if (b < AR - 1) {
-                                spec.get_copy(s, state(p));
-                            }
-                            else {
-                                s = state(p);
-                            }
+                            q.branch[b] = 0;
+                        }
+                        ++deadCount;
+                        continue;
+                    }
 
-                            NodeId f(i, j);
-                            int kk = downTable(f, b, i - 1);
-                            int ii = downSpec(spec, s, i, b, kk);
+                    size_t const j = code(p);
+                    *srcPtr(p) = NodeId(i, jj);
+                    bool allZero = true;
+                    void* s = tmpState;
 
-                            while (ii != 0 && kk != 0 && ii != kk) {
-                                if (ii < kk) {
-                                    assert(kk >= 1);
-                                    kk = downTable(f, 0, ii);
-                                }
-                                else {
-                                    assert(ii >= 1);
-                                    ii = downSpec(spec, s, ii, 0, kk);
-                                }
-                            }
+                    for (int b = 0; b < AR; ++b) {
+                        if (b < AR - 1) {
+                            spec.get_copy(s, state(p));
+                        }
+                        else {
+                            s = state(p);
+                        }
+
+                        NodeId f(i, j);
+                        int kk = downTable(f, b, i - 1);
+                        int ii = downSpec(spec, s, i, b, kk);
 
-                            if (ii <= 0 || kk <= 0) {
-                                bool val = ii != 0 && kk != 0;
-                                q.branch[b] = val;
-                                if (val) allZero = false;
+                        while (ii != 0 && kk != 0 && ii != kk) {
+                            if (ii < kk) {
+                                assert(kk >= 1);
+                                kk = downTable(f, 0, ii);
                             }
                             else {
-                                assert(ii == f.row() && ii == kk && ii < i);
-                                size_t jj = f.col();
+                                assert(ii >= 1);
+                                ii = downSpec(spec, s, ii, 0, kk);
+                            }
+                        }
 
-                                if (snodeTables[yy][ii].empty()) {
-                                    snodeTables[yy][ii].resize(
-                                            input[ii].size());
-                                }
+                        if (ii == 0 || kk == 0) {
+                            q.branch[b] = 0;
+                        }
+                        else if (ii < 0 || kk < 0) {
+                            // merged by mergeOneCandidates()
+                            SpecNode* pp = oneCandidates[yy].alloc_front(
+                                    specNodeSize);
+                            spec.get_copy(state(pp), s);
+                            srcPtr(pp) = &q.branch[b];
+                            q.branch[b] = 1;
+                            allZero = false;
+                        }
+                        else {
+                            assert(ii == f.row() && ii == kk && ii < i);
+                            size_t jjj = f.col();
 
-                                SpecNode* pp =
-                                        snodeTables[yy][ii][jj].alloc_front(
-                                                pools[yy][ii], specNodeSize);
-                                spec.get_copy(state(pp), s);
-                                srcPtr(pp) = &q.branch[b];
-                                if (ii < lc) lc = ii;
-                                allZero = false;
+                            if (snodeTables[yy][ii].empty()) {
+                                snodeTables[yy][ii].resize(input[ii].size());
                             }
 
-                            spec.destruct(s);
+                            SpecNode* pp = snodeTables[yy][ii][jjj].alloc_front(
+                                    pools[yy][ii], specNodeSize);
+                            spec.get_copy(state(pp), s);
+                            srcPtr(pp) = &q.branch[b];
+                            if (ii < lc) lc = ii;
+                            allZero = false;
                         }
 
-                        if (allZero) ++deadCount;
+                        spec.destruct(s);
                     }
+
+                    if (allZero) ++deadCount;
                 }
             }
 
+#ifdef _OPENMP
+#pragma omp barrier
+#endif
             snodeTables[yy][i].clear();
             pools[yy][i].clear();
             spec.destructLevel(i);
@@ -1214,9 +2731,22 @@ public:
             if (lc < lowestChild) lowestChild = lc;
         }
 
+        checkNodeId(i, output[i].size());
+        stats.add(scheduler);
+        stats.endLevel(i);
+        nodeSource.clear();
+        mergeOneCandidates(specs[0], one, oneSrcPtr, oneCandidates, output, i);
         sweeper.update(i, lowestChild, deadCount);
     }
 
+    /**
+     * Gets the load-imbalance statistics of the parallel phases.
+     * @return the statistics.
+     */
+    LoadImbalanceStats const& loadImbalance() const {
+        return stats;
+    }
+
 private:
     int downTable(NodeId& f, int b, int zerosupLevel) const {
         if (zerosupLevel < 0) zerosupLevel = 0;
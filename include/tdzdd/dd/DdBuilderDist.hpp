@@ -0,0 +1,570 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef __unix__
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "DdBuilder.hpp"
+#include "DdSweeper.hpp"
+#include "Node.hpp"
+#include "NodeTable.hpp"
+#include "../util/MessageChannel.hpp"
+#include "../util/MyHashTable.hpp"
+#include "../util/MyList.hpp"
+#include "../util/MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Breadth-first DD builder distributed over worker processes.
+ * The states of each level are partitioned over the workers by their hash
+ * codes, so that each worker holds only its part of the pending states and
+ * equivalent states always meet in the same worker.
+ * Workers exchange child states with each other and report the nodes they
+ * make to the coordinator, which assembles the diagram with the columns of
+ * each row partitioned by workers.
+ * The workers are forked from the coordinator and connected by Unix domain
+ * sockets; the messages are length-prefixed byte streams that do not depend
+ * on the kind of the sockets.
+ * States are transferred as raw bytes; therefore they must not contain
+ * pointers to other memory blocks.
+ */
+template<typename S>
+class DdBuilderDist: DdBuilderBase {
+    typedef S Spec;
+    typedef MyHashTable<SpecNode*,Hasher<Spec>,Hasher<Spec> > UniqTable;
+    static int const AR = Spec::ARITY;
+
+    /* Branch codes in the reports of workers. */
+    enum {
+        ZERO = 0, ONE = 1, PENDING = 2
+    };
+
+    /*
+     * Branch of a node made by a worker, which waits for its child.
+     * row is -1 for the root.
+     */
+    struct Source {
+        size_t col; ///< column in the part of the row made by the worker.
+        int row;    ///< level of the node.
+        int worker; ///< the worker that made the node.
+        int val;    ///< branch number.
+        int unused;
+    };
+
+    Spec spec;
+    int const specNodeSize;
+    int const datasize;
+    NodeTableEntity<AR>& output;
+    DdSweeper<AR> sweeper;
+    NodeId* rootPtr;
+
+    MyVector<char> oneStorage;
+    void* const one;
+    MyVector<NodeBranchId> oneSrcPtr;
+
+    int processes;
+    MyVector<MessageChannel> workers;
+    MyVector<int> pids;
+    MyVector<MyVector<size_t> > offsets;
+
+    /* States held by a worker process. */
+    MyVector<MyList<SpecNode> > snodeTable;
+    MyVector<MyVector<Source> > sourceTable;
+
+public:
+    DdBuilderDist(Spec const& spec, NodeTableHandler<AR>& output) :
+            spec(spec),
+            specNodeSize(getSpecNodeSize(spec.datasize())),
+            datasize(spec.datasize()),
+            output(output.privateEntity()),
+            sweeper(this->output, oneSrcPtr),
+            rootPtr(0),
+            oneStorage(spec.datasize()),
+            one(oneStorage.data()),
+            processes(2) {
+    }
+
+    ~DdBuilderDist() {
+        if (!oneSrcPtr.empty()) {
+            spec.destruct(one);
+            oneSrcPtr.clear();
+        }
+        stopWorkers();
+    }
+
+    /**
+     * Sets the number of worker processes.
+     * This function must be called before initialize().
+     * @param n the number of worker processes.
+     */
+    void setProcesses(int n) {
+        processes = std::max(n, 1);
+    }
+
+    /**
+     * Selects the reduction rules applied during the construction.
+     * @param rule the reduction rules.
+     */
+    void setReduction(DdReduction rule) {
+        sweeper.setReduction(rule);
+    }
+
+    /**
+     * Initializes the builder and starts the worker processes.
+     * @param root result storage.
+     * @return the level of the root node.
+     */
+    int initialize(NodeId& root) {
+        sweeper.setRoot(root);
+        rootPtr = &root;
+        MyVector<char> tmp(datasize);
+        void* const tmpState = tmp.data();
+        int n = spec.get_root(tmpState);
+        spec.destruct(tmpState);
+
+        if (n <= 0) {
+            root = n ? 1 : 0;
+            return 0;
+        }
+
+        if (n >= output.numRows()) output.setNumRows(n + 1);
+        offsets.clear();
+        offsets.resize(n + 1);
+        if (!oneSrcPtr.empty()) {
+            spec.destruct(one);
+            oneSrcPtr.clear();
+        }
+        startWorkers();
+        return n;
+    }
+
+    /**
+     * Builds one level.
+     * The workers are stopped after level 1 is built.
+     * @param i level.
+     */
+    void construct(int i) {
+        assert(0 < i && size_t(i) < offsets.size());
+        int const n = processes;
+
+        MessageBuffer cmd;
+        cmd.put(i);
+        for (int w = 0; w < n; ++w) {
+            workers[w].send(cmd);
+        }
+
+        MyVector<MessageBuffer> reports(n);
+        MyVector<size_t>& off = offsets[i];
+        off.resize(n + 1);
+        off[0] = 0;
+        for (int w = 0; w < n; ++w) {
+            if (!workers[w].receive(reports[w])) {
+                throw std::runtime_error(
+                        "DdBuilderDist: worker process terminated");
+            }
+            off[w + 1] = off[w] + reports[w].get<size_t>();
+        }
+
+        checkNodeId(i, off[n]);
+        output.initRow(i, off[n]);
+        MyVector<char> tmp(datasize);
+        int lowestChild = i - 1;
+        size_t deadCount = 0;
+
+        for (int w = 0; w < n; ++w) {
+            MessageBuffer& r = reports[w];
+
+            for (size_t k = r.get<size_t>(); k > 0; --k) {
+                Source const s = r.get<Source>();
+                intmax_t const col = r.get<intmax_t>();
+                NodeId const f = (col < 0) ? NodeId(0) : NodeId(i, off[w] + col);
+                if (s.row < 0) {
+                    *rootPtr = f;
+                }
+                else {
+                    size_t const j = offsets[s.row][s.worker] + s.col;
+                    output[s.row][j].branch[s.val] = f;
+                }
+            }
+
+            for (size_t j = off[w]; j < off[w + 1]; ++j) {
+                Node<AR>& q = output[i][j];
+                bool allZero = true;
+                for (int b = 0; b < AR; ++b) {
+                    char const c = r.get<char>();
+                    q.branch[b] = (c == ONE) ? 1 : 0;
+                    if (c != ZERO) allZero = false;
+                }
+                if (allZero) ++deadCount;
+            }
+
+            for (size_t k = r.get<size_t>(); k > 0; --k) {
+                size_t const j = off[w] + r.get<size_t>();
+                int const b = r.get<int>();
+                r.read(tmp.data(), datasize);
+                mergeOne(i, j, b, tmp.data());
+            }
+
+            lowestChild = std::min(lowestChild, r.get<int>());
+        }
+
+        sweeper.update(i, lowestChild, deadCount);
+        if (i == 1) stopWorkers();
+    }
+
+private:
+    /*
+     * Merges a 1-terminal candidate in the same way as DdBuilder.
+     */
+    void mergeOne(int i, size_t j, int b, void* s) {
+        NodeId& f = output[i][j].branch[b];
+
+        if (oneSrcPtr.empty()) { // the first 1-terminal candidate
+            spec.get_copy(one, s);
+            oneSrcPtr.push_back(NodeBranchId(i, j, b));
+        }
+        else {
+            switch (spec.merge_states(one, s)) {
+            case 1:
+                while (!oneSrcPtr.empty()) {
+                    NodeBranchId const& nbi = oneSrcPtr.back();
+                    assert(nbi.row >= i);
+                    output[nbi.row][nbi.col].branch[nbi.val] = 0;
+                    oneSrcPtr.pop_back();
+                }
+                spec.destruct(one);
+                spec.get_copy(one, s);
+                oneSrcPtr.push_back(NodeBranchId(i, j, b));
+                break;
+            case 2:
+                f = 0;
+                break;
+            default:
+                oneSrcPtr.push_back(NodeBranchId(i, j, b));
+                break;
+            }
+        }
+
+        spec.destruct(s);
+    }
+
+    void startWorkers() {
+        stopWorkers();
+#ifdef __unix__
+        int const n = processes;
+        // A descriptor is set to -1 when it is closed or handed over.
+        MyVector<int> coordFd(n * 2, -1);
+        MyVector<int> meshFd(n * n, -1);
+
+        for (int w = 0; w < n; ++w) {
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, &coordFd[w * 2]) < 0) {
+                closeAll(coordFd);
+                closeAll(meshFd);
+                throw std::runtime_error("DdBuilderDist: socketpair failed");
+            }
+            for (int v = 0; v < w; ++v) {
+                int sv[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+                    closeAll(coordFd);
+                    closeAll(meshFd);
+                    throw std::runtime_error("DdBuilderDist: socketpair failed");
+                }
+                meshFd[v * n + w] = sv[0];
+                meshFd[w * n + v] = sv[1];
+            }
+        }
+
+        std::cout.flush();
+        std::cerr.flush();
+        std::fflush(0);
+
+        for (int w = 0; w < n; ++w) {
+            int pid = fork();
+            if (pid < 0) {
+                closeAll(coordFd);
+                closeAll(meshFd);
+                stopWorkers();
+                throw std::runtime_error("DdBuilderDist: fork failed");
+            }
+
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    // The parent ends of the earlier workers are in workers,
+                    // and their child ends have been closed by the parent.
+                    MessageChannel coord(coordFd[w * 2 + 1]);
+                    coordFd[w * 2 + 1] = -1;
+                    closeAll(coordFd);
+                    MyVector<MessageChannel> peers(n);
+                    for (int u = 0; u < n; ++u) {
+                        int& fd = meshFd[w * n + u];
+                        if (fd >= 0) peers[u] = MessageChannel(fd);
+                        fd = -1;
+                    }
+                    closeAll(meshFd);
+                    for (size_t v = 0; v < workers.size(); ++v) {
+                        workers[v].close();
+                    }
+                    runWorker(w, coord, peers);
+                }
+                catch (...) {
+                    status = 1;
+                }
+                _exit(status);
+            }
+
+            pids.push_back(pid);
+            workers.push_back(MessageChannel(coordFd[w * 2]));
+            coordFd[w * 2] = -1;
+            ::close(coordFd[w * 2 + 1]);
+            coordFd[w * 2 + 1] = -1;
+        }
+
+        closeAll(meshFd);
+#else
+        throw std::runtime_error("DdBuilderDist: not supported");
+#endif
+    }
+
+#ifdef __unix__
+    /*
+     * Closes the open descriptors and marks them as closed.
+     */
+    static void closeAll(MyVector<int>& fds) {
+        for (size_t k = 0; k < fds.size(); ++k) {
+            if (fds[k] >= 0) ::close(fds[k]);
+            fds[k] = -1;
+        }
+    }
+#endif
+
+    void stopWorkers() {
+        for (size_t w = 0; w < workers.size(); ++w) {
+            workers[w].close();
+        }
+#ifdef __unix__
+        for (size_t w = 0; w < pids.size(); ++w) {
+            int status;
+            waitpid(pids[w], &status, 0);
+        }
+#endif
+        workers.clear();
+        pids.clear();
+    }
+
+    /*
+     * Main loop of worker w.
+     * It builds the level given by the coordinator until the coordinator
+     * closes the channel.
+     */
+    void runWorker(int w, MessageChannel& coord,
+                   MyVector<MessageChannel>& peers) {
+        int const n = processes;
+        MyVector<char> tmp(datasize);
+        void* const tmpState = tmp.data();
+        int top = spec.get_root(tmpState);
+        snodeTable.resize(top + 1);
+        sourceTable.resize(top + 1);
+
+        if (int(spec.hash_code(tmpState, top) % n) == w) {
+            Source s;
+            s.col = 0;
+            s.row = -1;
+            s.worker = 0;
+            s.val = 0;
+            s.unused = 0;
+            addState(top, s, tmpState);
+        }
+        spec.destruct(tmpState);
+
+        MessageBuffer cmd;
+        MessageBuffer report;
+        MyVector<MessageBuffer> out(n);
+        MyVector<MessageBuffer> in;
+
+        while (coord.receive(cmd)) {
+            int const i = cmd.get<int>();
+            report.clear();
+            for (int v = 0; v < n; ++v) {
+                out[v].clear();
+            }
+
+            buildLevel(w, i, report, out);
+            coord.send(report);
+
+            MessageChannel::exchange(peers, out, in);
+            for (int v = 0; v < n; ++v) {
+                receiveStates(v == w ? out[v] : in[v]);
+            }
+        }
+    }
+
+    void addState(int level, Source const& s, void const* data) {
+        SpecNode* p = snodeTable[level].alloc_front(specNodeSize);
+        code(p) = sourceTable[level].size();
+        sourceTable[level].push_back(s);
+        std::copy(static_cast<char const*>(data),
+                static_cast<char const*>(data) + datasize,
+                static_cast<char*>(state(p)));
+    }
+
+    void receiveStates(MessageBuffer& buf) {
+        MyVector<char> tmp(datasize);
+        while (!buf.atEnd()) {
+            int const level = buf.get<int>();
+            Source const s = buf.get<Source>();
+            buf.read(tmp.data(), datasize);
+            addState(level, s, tmp.data());
+        }
+    }
+
+    /*
+     * Makes the nodes of the states at level i held by worker w.
+     * The report lists the number of nodes, the node of each source,
+     * the branch codes of the nodes, the 1-terminal candidates, and the
+     * lowest child level.
+     * The child states are written to the outgoing buffers of the workers
+     * that own them.
+     */
+    void buildLevel(int w, int i, MessageBuffer& report,
+                    MyVector<MessageBuffer>& out) {
+        int const n = processes;
+        MyList<SpecNode>& snodes = snodeTable[i];
+        MyVector<Source>& sources = sourceTable[i];
+        MyVector<intmax_t> colOf(sources.size());
+        MyVector<SpecNode*> nodes;
+
+        {
+            Hasher<Spec> hasher(spec, i);
+            UniqTable uniq(snodes.size() * 2, hasher, hasher);
+
+            for (MyList<SpecNode>::iterator t = snodes.begin();
+                    t != snodes.end(); ++t) {
+                SpecNode* p = *t;
+                SpecNode*& p0 = uniq.add(p);
+
+                if (p0 == p) {
+                    colOf[code(p)] = nodes.size();
+                    nodes.push_back(p);
+                    continue;
+                }
+
+                switch (spec.merge_states(state(p0), state(p))) {
+                case 1:
+                    nodes[colOf[code(p0)]] = 0; // forward to 0-terminal
+                    colOf[code(p)] = nodes.size();
+                    nodes.push_back(p);
+                    p0 = p;
+                    break;
+                case 2:
+                    colOf[code(p)] = -1;
+                    break;
+                default:
+                    colOf[code(p)] = colOf[code(p0)];
+                    break;
+                }
+            }
+        }
+
+        report.put(nodes.size());
+        report.put(sources.size());
+        for (size_t k = 0; k < sources.size(); ++k) {
+            report.put(sources[k]);
+            report.put(colOf[k]);
+        }
+
+        MessageBuffer ones;
+        size_t oneCount = 0;
+        int lowestChild = i - 1;
+        MyVector<char> tmp(specNodeSize * sizeof(SpecNode));
+        SpecNode* const pp = reinterpret_cast<SpecNode*>(tmp.data());
+
+        for (size_t j = 0; j < nodes.size(); ++j) {
+            SpecNode* p = nodes[j];
+
+            for (int b = 0; b < AR; ++b) {
+                if (p == 0) {
+                    report.put(char(ZERO));
+                    continue;
+                }
+
+                spec.get_copy(state(pp), state(p));
+                int ii = spec.get_child(state(pp), i, b);
+
+                if (ii == 0) {
+                    report.put(char(ZERO));
+                }
+                else if (ii < 0) {
+                    report.put(char(ONE));
+                    ones.put(j);
+                    ones.put(b);
+                    ones.write(state(pp), datasize);
+                    ++oneCount;
+                }
+                else {
+                    report.put(char(PENDING));
+                    if (ii < lowestChild) lowestChild = ii;
+                    Source s;
+                    s.col = j;
+                    s.row = i;
+                    s.worker = w;
+                    s.val = b;
+                    s.unused = 0;
+                    MessageBuffer& buf = out[spec.hash_code(state(pp), ii) % n];
+                    buf.put(ii);
+                    buf.put(s);
+                    buf.write(state(pp), datasize);
+                }
+
+                spec.destruct(state(pp));
+            }
+        }
+
+        report.put(oneCount);
+        report.write(ones.data(), ones.size());
+        report.put(lowestChild);
+
+        for (; !snodes.empty(); snodes.pop_front()) {
+            spec.destruct(state(snodes.front()));
+        }
+        sources.clear();
+        spec.destructLevel(i);
+    }
+};
+
+} // namespace tdzdd
@@ -0,0 +1,244 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DdSweeper.hpp"
+#include "NodeTable.hpp"
+#include "../util/ResourceUsage.hpp"
+
+namespace tdzdd {
+
+/**
+ * Handling of the states beyond the width limit of a level.
+ */
+enum DdWidthRule {
+    RESTRICTED_DD, ///< They are forwarded to the 0-terminal (primal bound).
+    RELAXED_DD     ///< They are merged into one state (dual bound).
+};
+
+/**
+ * Options for top-down DD construction.
+ */
+struct DdBuilderOptions {
+    /// Use algorithms for multiple processors.
+    bool useMP;
+
+    /// Use a shared concurrent unique table in the parallel builder.
+    bool sharedUniqTable;
+
+    /// Number of worker processes of the distributed builder;
+    /// 0 for building in this process.
+    int processes;
+
+    /// Directory for spill files; empty for the default.
+    std::string spillDirectory;
+
+    /// Memory budget for pending states in bytes before they are spilled
+    /// to files (serial builder only); 0 for keeping them in memory.
+    size_t spillMemory;
+
+    /// Deduplicate child states as soon as they are generated
+    /// (serial builder with 64-bit node IDs only).
+    bool eagerDedup;
+
+    /// Cache the hash codes of states in the breadth-first builders.
+    bool hashCache;
+
+    /// Use the depth-first builder instead of the breadth-first ones.
+    bool depthFirst;
+
+    /// Reduction rules applied during the construction.
+    DdReduction reduction;
+
+    /// Upper limit of the number of nodes at each level (serial builder
+    /// only); 0 for no limit.
+    size_t maxWidth;
+
+    /// Handling of the states beyond maxWidth.
+    DdWidthRule widthRule;
+
+    /// Upper limit of the memory usage in bytes; 0 for no limit.
+    size_t memoryLimit;
+
+    /// Upper limit of the elapsed time in seconds; 0 for no limit.
+    double timeLimit;
+
+    /// Checkpoint file of the breadth-first builders; empty for no
+    /// checkpoints. The construction is resumed from it if it exists.
+    std::string checkpointFile;
+
+    /// Interval of checkpoints in seconds.
+    double checkpointInterval;
+
+    DdBuilderOptions()
+            : useMP(false), sharedUniqTable(false), processes(0), spillMemory(0),
+              eagerDedup(false), hashCache(false), depthFirst(false),
+              reduction(NO_REDUCTION), maxWidth(0), widthRule(RESTRICTED_DD),
+              memoryLimit(0), timeLimit(0),
+              checkpointInterval(600) {
+    }
+};
+
+/**
+ * Exception thrown when DD construction exceeds a limit given by
+ * DdBuilderOptions.
+ * It reports how far the construction has proceeded.
+ */
+class DdBuildLimitExceeded: public std::runtime_error {
+    int level_;
+    std::vector<size_t> widths_;
+    size_t peakBytes_;
+    double elapsedTime_;
+
+public:
+    DdBuildLimitExceeded(std::string const& what, int level,
+                         std::vector<size_t> const& widths, size_t peakBytes,
+                         double elapsedTime)
+            : std::runtime_error(what), level_(level), widths_(widths),
+              peakBytes_(peakBytes), elapsedTime_(elapsedTime) {
+    }
+
+    ~DdBuildLimitExceeded() throw () {
+    }
+
+    /**
+     * Gets the level under construction when the limit is exceeded.
+     * @return the level.
+     */
+    int level() const {
+        return level_;
+    }
+
+    /**
+     * Gets the number of nodes at each level constructed so far.
+     * @return the widths indexed by levels.
+     */
+    std::vector<size_t> const& widths() const {
+        return widths_;
+    }
+
+    /**
+     * Gets the peak memory usage observed by the builder.
+     * @return the memory usage in bytes.
+     */
+    size_t peakBytes() const {
+        return peakBytes_;
+    }
+
+    /**
+     * Gets the elapsed time until the limit is exceeded.
+     * @return the elapsed time in seconds.
+     */
+    double elapsedTime() const {
+        return elapsedTime_;
+    }
+};
+
+/**
+ * Checker of the memory and time limits for DD builders.
+ */
+class DdBuildLimiter {
+    size_t memoryLimit;
+    double timeLimit;
+    double startTime;
+    size_t peakBytes;
+
+public:
+    DdBuildLimiter()
+            : memoryLimit(0), timeLimit(0), startTime(0), peakBytes(0) {
+    }
+
+    /**
+     * Sets the limits and starts the timer.
+     * @param memoryLimit upper limit of the memory usage in bytes;
+     *        0 for no limit.
+     * @param timeLimit upper limit of the elapsed time in seconds;
+     *        0 for no limit.
+     */
+    void set(size_t memoryLimit, double timeLimit) {
+        this->memoryLimit = memoryLimit;
+        this->timeLimit = timeLimit;
+        startTime = getWallClockTime();
+        peakBytes = 0;
+    }
+
+    /**
+     * Checks if any limit is set.
+     * @return true if some limit is set.
+     */
+    bool enabled() const {
+        return memoryLimit > 0 || timeLimit > 0;
+    }
+
+    /**
+     * Checks the limits.
+     * @param bytes the current memory usage in bytes.
+     * @return false if a limit is exceeded.
+     */
+    bool check(size_t bytes) {
+        if (bytes > peakBytes) peakBytes = bytes;
+        if (memoryLimit > 0 && bytes > memoryLimit) return false;
+        if (timeLimit > 0 && getWallClockTime() - startTime > timeLimit) {
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Throws DdBuildLimitExceeded.
+     * @param level the level under construction.
+     * @param bytes the current memory usage in bytes.
+     * @param table the node table under construction.
+     */
+    template<int ARITY>
+    void raise(int level, size_t bytes, NodeTableEntity<ARITY> const& table) {
+        double const elapsed = getWallClockTime() - startTime;
+        std::vector<size_t> widths(table.numRows());
+        for (int i = 0; i < table.numRows(); ++i) {
+            widths[i] = table[i].size();
+        }
+
+        std::ostringstream oss;
+        if (memoryLimit > 0 && bytes > memoryLimit) {
+            oss << "Memory limit exceeded: " << bytes << " > " << memoryLimit
+                << " bytes";
+        }
+        else {
+            oss << "Time limit exceeded: " << elapsed << " > " << timeLimit
+                << " seconds";
+        }
+        oss << " at level " << level;
+
+        throw DdBuildLimitExceeded(oss.str(), level, widths, peakBytes,
+                elapsed);
+    }
+};
+
+} // namespace tdzdd
@@ -0,0 +1,323 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "Node.hpp"
+#include "NodeTable.hpp"
+#include "../util/MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Binary file of a checkpoint of top-down DD construction.
+ * A new checkpoint is written to a temporary file first, and it replaces
+ * the old one only when commit() is called, so that an interrupted
+ * writer never leaves a broken checkpoint.
+ * The data is written in the native byte order; the file is not portable
+ * among different platforms.
+ */
+class DdCheckpointFile {
+    static int const VERSION = 1;
+
+    std::string path;
+    std::string tmpPath;
+    std::FILE* fp;
+
+    DdCheckpointFile(DdCheckpointFile const&);
+    DdCheckpointFile& operator=(DdCheckpointFile const&);
+
+    void error(char const* what) const {
+        throw std::runtime_error(std::string(what) + " checkpoint file: " + path);
+    }
+
+public:
+    /**
+     * Opens a checkpoint file.
+     * @param path file name.
+     * @param write true for writing a new checkpoint.
+     */
+    DdCheckpointFile(std::string const& path, bool write)
+            : path(path), fp(0) {
+        if (write) {
+            tmpPath = path + ".tmp";
+            fp = std::fopen(tmpPath.c_str(), "wb");
+        }
+        else {
+            fp = std::fopen(path.c_str(), "rb");
+        }
+        if (fp == 0) error("Cannot open");
+    }
+
+    ~DdCheckpointFile() {
+        if (fp != 0) std::fclose(fp);
+        if (!tmpPath.empty()) std::remove(tmpPath.c_str());
+    }
+
+    /**
+     * Checks if a checkpoint file exists.
+     * @param path file name.
+     * @return true if it exists.
+     */
+    static bool exists(std::string const& path) {
+        std::FILE* fp = std::fopen(path.c_str(), "rb");
+        if (fp == 0) return false;
+        std::fclose(fp);
+        return true;
+    }
+
+    /**
+     * Removes a checkpoint file.
+     * @param path file name.
+     */
+    static void remove(std::string const& path) {
+        std::remove(path.c_str());
+    }
+
+    /**
+     * Writes raw bytes.
+     * @param p pointer to the data.
+     * @param n the number of bytes.
+     */
+    void write(void const* p, size_t n) {
+        if (n > 0 && std::fwrite(p, 1, n, fp) != n) error("Cannot write");
+    }
+
+    /**
+     * Reads raw bytes.
+     * @param p pointer to the buffer.
+     * @param n the number of bytes.
+     */
+    void read(void* p, size_t n) {
+        if (n > 0 && std::fread(p, 1, n, fp) != n) error("Broken");
+    }
+
+    /**
+     * Writes a plain value.
+     * @param v the value.
+     */
+    template<typename T>
+    void put(T const& v) {
+        write(&v, sizeof(v));
+    }
+
+    /**
+     * Reads a plain value.
+     * @return the value.
+     */
+    template<typename T>
+    T get() {
+        T v;
+        read(&v, sizeof(v));
+        return v;
+    }
+
+    /**
+     * Writes a vector of plain values.
+     * @param v the vector.
+     */
+    template<typename T>
+    void putVector(MyVector<T> const& v) {
+        put(v.size());
+        write(v.data(), v.size() * sizeof(T));
+    }
+
+    /**
+     * Reads a vector of plain values.
+     * @param v the vector.
+     */
+    template<typename T>
+    void getVector(MyVector<T>& v) {
+        v.resize(get<size_t>());
+        read(v.data(), v.size() * sizeof(T));
+    }
+
+    /**
+     * Writes a string.
+     * @param s the string.
+     */
+    void putString(std::string const& s) {
+        put(s.size());
+        write(s.data(), s.size());
+    }
+
+    /**
+     * Reads a string.
+     * @return the string.
+     */
+    std::string getString() {
+        MyVector<char> buf(get<size_t>());
+        read(buf.data(), buf.size());
+        return std::string(buf.data(), buf.size());
+    }
+
+    /**
+     * Writes the header.
+     * @param specName the name of the DD spec.
+     * @param arity the arity of the nodes.
+     * @param datasize the size of a state in bytes.
+     */
+    void putHeader(std::string const& specName, int arity, int datasize) {
+        write("TdZddCkp", 8);
+        put(int(VERSION));
+        put(int(sizeof(void*)));
+        put(int(sizeof(NodeId)));
+        put(arity);
+        put(datasize);
+        putString(specName);
+    }
+
+    /**
+     * Reads and validates the header.
+     * @param specName the name of the DD spec.
+     * @param arity the arity of the nodes.
+     * @param datasize the size of a state in bytes.
+     */
+    void checkHeader(std::string const& specName, int arity, int datasize) {
+        char magic[8];
+        read(magic, 8);
+        if (std::memcmp(magic, "TdZddCkp", 8) != 0) error("Not a");
+        if (get<int>() != int(VERSION)) error("Unsupported version of");
+        if (get<int>() != int(sizeof(void*))) error("Incompatible");
+        if (get<int>() != int(sizeof(NodeId))) error("Incompatible");
+        if (get<int>() != arity) error("Arity mismatch in");
+        if (get<int>() != datasize) error("State size mismatch in");
+        if (getString() != specName) error("Spec mismatch in");
+    }
+
+    /**
+     * Writes a node table.
+     * @param table the node table.
+     */
+    template<int ARITY>
+    void putTable(NodeTableEntity<ARITY> const& table) {
+        put(table.numRows());
+        for (int i = 0; i < table.numRows(); ++i) {
+            putVector(table[i]);
+        }
+    }
+
+    /**
+     * Reads a node table.
+     * @param table the node table.
+     */
+    template<int ARITY>
+    void getTable(NodeTableEntity<ARITY>& table) {
+        table.setNumRows(get<int>());
+        for (int i = 0; i < table.numRows(); ++i) {
+            getVector(table[i]);
+        }
+    }
+
+    /**
+     * Makes the new checkpoint effective.
+     */
+    void commit() {
+        if (std::fclose(fp) != 0) {
+            fp = 0;
+            error("Cannot write");
+        }
+        fp = 0;
+        std::remove(path.c_str());
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0) error("Cannot rename");
+        tmpPath.clear();
+    }
+};
+
+/**
+ * Converter between pointers to the branches of a node table and their
+ * positions.
+ * The root pointer is represented by row -1.
+ */
+template<int ARITY>
+class NodeBranchLocator {
+    struct Range {
+        NodeId const* begin;
+        NodeId const* end;
+        int row;
+
+        bool operator<(Range const& o) const {
+            return begin < o.begin;
+        }
+    };
+
+    NodeTableEntity<ARITY>& table;
+    NodeId* const root;
+    MyVector<Range> ranges;
+
+public:
+    /**
+     * Constructor.
+     * @param table the node table.
+     * @param root the root pointer.
+     */
+    NodeBranchLocator(NodeTableEntity<ARITY>& table, NodeId* root)
+            : table(table), root(root) {
+        for (int i = 0; i < table.numRows(); ++i) {
+            if (table[i].size() == 0) continue;
+            Range r;
+            r.begin = table[i][0].branch;
+            r.end = r.begin + table[i].size() * ARITY;
+            r.row = i;
+            ranges.push_back(r);
+        }
+        std::sort(ranges.begin(), ranges.end());
+    }
+
+    /**
+     * Gets the position of a branch.
+     * @param p pointer to the branch.
+     * @return the position.
+     */
+    NodeBranchId locate(NodeId const* p) const {
+        if (p == root) return NodeBranchId(-1, 0, 0);
+
+        Range key;
+        key.begin = p;
+        Range const* r = std::upper_bound(ranges.begin(), ranges.end(), key);
+        if (r == ranges.begin() || p >= (--r)->end) {
+            throw std::runtime_error("Pending branch is not in the node table");
+        }
+        size_t k = p - r->begin;
+        return NodeBranchId(r->row, k / ARITY, k % ARITY);
+    }
+
+    /**
+     * Gets the pointer to a branch.
+     * @param nbi the position of the branch.
+     * @return pointer to the branch.
+     */
+    NodeId* resolve(NodeBranchId const& nbi) const {
+        if (nbi.row < 0) return root;
+        return &table[nbi.row][nbi.col].branch[nbi.val];
+    }
+};
+
+} // namespace tdzdd
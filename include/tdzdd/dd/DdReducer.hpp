@@ -24,10 +24,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <ostream>
 #include <stdexcept>
+#include <stdint.h>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -38,6 +40,7 @@
 #include "../util/MyHashTable.hpp"
 #include "../util/MyList.hpp"
 #include "../util/MyVector.hpp"
+#include "../util/NumaPlacement.hpp"
 
 namespace tdzdd {
 
@@ -82,6 +85,64 @@ class DdReducer {
 #endif
 
     bool readyForSequentialReduction;
+    bool radix;
+    bool inPlace;
+
+    static int const RADIX_BITS = 8;
+    static size_t const RADIX_SIZE = size_t(1) << RADIX_BITS;
+
+    MyVector<size_t> radixCount;
+    MyVector<size_t> chunkCount;
+    MyVector<size_t> sortBuf[2];
+    MyVector<size_t> groupStart;
+    MyVector<size_t> groupFirst;
+    MyVector<size_t> groupRun;
+    MyVector<size_t> groupBuf[2];
+
+    static size_t const WIDE_LEVEL_PER_THREAD = 1024;
+
+    size_t wideWidth;
+    MyVector<MyVector<int> > referredLevels;
+    MyVector<MyVector<int> > referringLevels;
+    MyVector<int> waitCount;
+    MyVector<int> userCount;
+    MyVector<int> readyLevels;
+    MyVector<int> wideLevels;
+
+    /*
+     * Sort key of a node index: the codes of the children.
+     */
+    struct ChildrenKey {
+        Node<ARITY> const* nodes;
+
+        explicit ChildrenKey(Node<ARITY> const* nodes) :
+                nodes(nodes) {
+        }
+
+        uint64_t operator()(size_t j, int w) const {
+            return nodes[j].branch[w].code();
+        }
+
+        bool equal(size_t j, size_t k) const {
+            return nodes[j] == nodes[k];
+        }
+    };
+
+    /*
+     * Sort key of a group index: a pair of numbers.
+     */
+    struct PairKey {
+        size_t const* first;
+        size_t const* second;
+
+        PairKey(size_t const* first, size_t const* second) :
+                first(first), second(second) {
+        }
+
+        uint64_t operator()(size_t g, int w) const {
+            return (w == 0) ? first[g] : second[g];
+        }
+    };
 
 public:
     DdReducer(NodeTableHandler<ARITY>& diagram, bool useMP = false) :
@@ -97,7 +158,10 @@ public:
             taskMatrix(threads),
             baseColumn(tasks + 1),
 #endif
-            readyForSequentialReduction(false) {
+            readyForSequentialReduction(false),
+            radix(false),
+            inPlace(false),
+            wideWidth(0) {
 #ifdef _OPENMP
 #ifdef DEBUG
         if (useMP) {
@@ -200,13 +264,54 @@ public:
         rootPtr[root.row()].push_back(&root);
     }
 
+    /**
+     * Selects the radix sort algorithm for reduce().
+     * The nodes at each level are sorted by their children with a parallel
+     * LSD radix sort instead of being registered to hash tables.
+     * When ARITY is 2 and the BDD or ZDD rule is applied, the result is
+     * identical to the one of Algorithm-R, including the order of the nodes
+     * at each level.
+     * Otherwise, the reduced diagram is the same as the one of the serial
+     * algorithm but the order of the nodes at each level may differ.
+     * reduceWavefront() uses this algorithm only for wide levels.
+     * @param flag true for using the radix sort algorithm.
+     * @return old value of the flag.
+     */
+    bool useRadixSort(bool flag = true) {
+        bool old = radix;
+        radix = flag;
+        return old;
+    }
+
+    /**
+     * Selects the in-place algorithm for reduce().
+     * The nodes at each level are compacted in the input table and moved to
+     * the output table without copying, and the new IDs of the lower levels
+     * are released as soon as no higher level refers to them.
+     * It saves the memory for a copy of the diagram at the cost of
+     * parallelism.
+     * @param flag true for using the in-place algorithm.
+     * @return old value of the flag.
+     */
+    bool useInPlace(bool flag = true) {
+        bool old = inPlace;
+        inPlace = flag;
+        return old;
+    }
+
     /**
      * Reduces one level.
      * @param i level.
      * @param useMP use an algorithm for multiple processors.
      */
     void reduce(int i, bool useMP = false) {
-        if (useMP) {
+        if (inPlace) {
+            reduceInPlace_(i);
+        }
+        else if (radix) {
+            reduceRadix_(i, useMP);
+        }
+        else if (useMP) {
             reduceMP_(i);
         }
         else if (ARITY == 2) {
@@ -217,7 +322,185 @@ public:
         }
     }
 
+    /**
+     * Reduces levels 1 to n in the order of their dependencies.
+     * A level is reduced as soon as all the levels referred by it are done,
+     * not after all the lower levels.
+     * Narrow levels are reduced serially by tasks, each of which goes on to
+     * the levels that become ready by itself, so that a chain of narrow
+     * levels is reduced without synchronizing the whole team.
+     * Wide levels are reduced one at a time by the radix sort algorithm
+     * with all threads.
+     * The reduced diagram is the same as the one given by reduce(), but the
+     * order of the nodes at each level may differ, since narrow levels are
+     * reduced by the hash table algorithm even when ARITY is 2.
+     * @param n the highest level.
+     * @param useMP use multiple threads.
+     */
+    void reduceWavefront(int n, bool useMP = false) {
+        int T = 1;
+#ifdef _OPENMP
+        if (useMP) T = threads;
+#endif
+        wideWidth = (T >= 2) ? WIDE_LEVEL_PER_THREAD * T : size_t(-1);
+        makeDependencies(n, useMP);
+
+        readyLevels.clear();
+        wideLevels.clear();
+        for (int i = 1; i <= n; ++i) {
+            if (waitCount[i] == 0) schedule(i);
+        }
+
+        while (!readyLevels.empty() || !wideLevels.empty()) {
+            if (!readyLevels.empty()) {
+                size_t const k = std::min(readyLevels.size(), size_t(T));
+#ifdef _OPENMP
+#pragma omp parallel num_threads(T) if (T > 1)
+#pragma omp single
+#endif
+                {
+                    DdReducer* self = this;
+                    for (size_t t = 1; t < k; ++t) {
+#ifdef _OPENMP
+#pragma omp task firstprivate(self)
+#endif
+                        self->drain();
+                    }
+                    drain();
+                }
+            }
+
+            while (!wideLevels.empty()) {
+                int const i = wideLevels.back();
+                wideLevels.pop_back();
+                reduceRadix_(i, useMP, false);
+                release(i);
+            }
+        }
+    }
+
 private:
+    /*
+     * Finds the levels referred by each level.
+     */
+    void makeDependencies(int n, bool useMP) {
+        referredLevels.clear();
+        referredLevels.resize(n + 1);
+        referringLevels.clear();
+        referringLevels.resize(n + 1);
+        waitCount.resize(n + 1);
+        userCount.resize(n + 1);
+        NodeTableEntity<ARITY> const& table = input; // keeps shared rows
+
+#ifdef _OPENMP
+#pragma omp parallel if (useMP)
+#endif
+        {
+            MyVector<int> mark(n + 1);
+            for (int ii = 0; ii <= n; ++ii) {
+                mark[ii] = 0;
+            }
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+            for (int i = 1; i <= n; ++i) {
+                MyVector<int>& lower = referredLevels[i];
+                size_t const m = table[i].size();
+
+                for (size_t j = 0; j < m; ++j) {
+                    for (int b = 0; b < ARITY; ++b) {
+                        int const ii = table[i][j].branch[b].row();
+                        if (ii == 0 || mark[ii] == i) continue;
+                        mark[ii] = i;
+                        lower.push_back(ii);
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i <= n; ++i) {
+            userCount[i] = 0;
+        }
+        for (int i = 1; i <= n; ++i) {
+            MyVector<int> const& lower = referredLevels[i];
+            waitCount[i] = lower.size();
+            for (size_t k = 0; k < lower.size(); ++k) {
+                referringLevels[lower[k]].push_back(i);
+                ++userCount[lower[k]];
+            }
+        }
+    }
+
+    /*
+     * Puts a level whose dependencies are resolved into the ready lists.
+     * Returns true if it is a narrow one.
+     */
+    bool schedule(int i) {
+        if (input[i].size() >= wideWidth) {
+            wideLevels.push_back(i);
+            return false;
+        }
+        readyLevels.push_back(i);
+        return true;
+    }
+
+    /*
+     * Marks level i as done; releases the new IDs that are no longer
+     * referred and schedules the levels that become ready.
+     * Returns the number of narrow levels scheduled.
+     */
+    size_t release(int i) {
+        size_t k = 0;
+#ifdef _OPENMP
+#pragma omp critical(tdzdd_DdReducer_wavefront)
+#endif
+        {
+            MyVector<int> const& lower = referredLevels[i];
+            for (size_t t = 0; t < lower.size(); ++t) {
+                if (--userCount[lower[t]] == 0) newIdTable[lower[t]].clear();
+            }
+
+            MyVector<int> const& higher = referringLevels[i];
+            for (size_t t = 0; t < higher.size(); ++t) {
+                if (--waitCount[higher[t]] == 0 && schedule(higher[t])) ++k;
+            }
+        }
+        return k;
+    }
+
+    /*
+     * Reduces narrow levels until none is ready,
+     * spawning a task for each extra level that becomes ready.
+     */
+    void drain() {
+        for (;;) {
+            int i = 0;
+#ifdef _OPENMP
+#pragma omp critical(tdzdd_DdReducer_wavefront)
+#endif
+            if (!readyLevels.empty()) {
+                i = readyLevels.back();
+                readyLevels.pop_back();
+            }
+            if (i == 0) return;
+
+            reduce_(i, false);
+            size_t const k = release(i);
+#ifdef _OPENMP
+            if (omp_get_num_threads() >= 2) {
+                DdReducer* self = this;
+                for (size_t t = 1; t < k; ++t) {
+#pragma omp task firstprivate(self)
+                    self->drain();
+                }
+            }
+#else
+            (void) k;
+#endif
+        }
+    }
+
     /**
      * Reduces one level using Algorithm-R.
      * @param i level.
@@ -334,8 +617,10 @@ private:
     /**
      * Reduces one level.
      * @param i level.
+     * @param clearLower release the new IDs of the lower levels that are
+     *        referred by no higher levels.
      */
-    void reduce_(int i) {
+    void reduce_(int i, bool clearLower = true) {
         size_t const m = input[i].size();
         newIdTable[i].resize(m);
         size_t jj = 0;
@@ -376,9 +661,11 @@ private:
             }
         }
 
-        MyVector<int> const& levels = input.lowerLevels(i);
-        for (int const* t = levels.begin(); t != levels.end(); ++t) {
-            newIdTable[*t].clear();
+        if (clearLower) {
+            MyVector<int> const& levels = input.lowerLevels(i);
+            for (int const* t = levels.begin(); t != levels.end(); ++t) {
+                newIdTable[*t].clear();
+            }
         }
 
         output.initRow(i, jj);
@@ -398,6 +685,74 @@ private:
         }
     }
 
+    /**
+     * Reduces one level in place.
+     * Unique nodes are packed to the front of the input row in the original
+     * order, then the row is handed over to the output table.
+     * @param i level.
+     */
+    void reduceInPlace_(int i) {
+        MyVector<Node<ARITY> >& row = input[i];
+        size_t const m = row.size();
+        MyVector<NodeId>& newId = newIdTable[i];
+        newId.resize(m);
+        size_t jj = 0;
+
+        {
+            MyHashTable<Node<ARITY> const*> uniq(m * 2);
+
+            for (size_t j = 0; j < m; ++j) {
+                Node<ARITY>& f = row[j];
+
+                // make f canonical
+                NodeId& f0 = f.branch[0];
+                f0 = newIdTable[f0.row()][f0.col()];
+                NodeId deletable = BDD ? f0 : 0;
+                bool del = BDD || ZDD || (f0 == 0);
+                for (int b = 1; b < ARITY; ++b) {
+                    NodeId& ff = f.branch[b];
+                    ff = newIdTable[ff.row()][ff.col()];
+                    if (ff != deletable) del = false;
+                }
+
+                if (del) { // f is redundant
+                    newId[j] = f0;
+                    continue;
+                }
+
+                Node<ARITY>* const q = &row[jj];
+                if (q != &f) *q = f;
+                Node<ARITY> const* pp = uniq.add(q);
+
+                if (pp == q) {
+                    newId[j] = NodeId(i, jj++, f0.hasEmpty());
+                }
+                else {
+                    newId[j] = NodeId(i, pp - row.data(), f0.hasEmpty());
+                }
+            }
+        }
+
+        MyVector<int> const& levels = input.lowerLevels(i);
+        for (int const* t = levels.begin(); t != levels.end(); ++t) {
+            newIdTable[*t].clear();
+        }
+
+        // The row is moved to a buffer of the reduced size, so that the
+        // reduced diagram does not keep the unreduced capacity; only this
+        // level is held twice, after the new IDs of the lower levels are
+        // released.
+        row.erase(row.begin() + jj, row.end());
+        row.shrink_to_fit();
+        output[i].swap(row);
+        row.clear();
+
+        for (size_t k = 0; k < rootPtr[i].size(); ++k) {
+            NodeId& root = *rootPtr[i][k];
+            root = newId[root.col()];
+        }
+    }
+
     /**
      * Reduces one level using OpenMP.
      * @param i level.
@@ -411,6 +766,7 @@ private:
 #endif
         size_t const m = input[i].size();
         newIdTable[i].resize(m);
+        NumaPlacement::interleave(newIdTable[i].data(), m * sizeof(NodeId));
 #ifdef DEBUG
         etcS1.stop();
         etcP1.start();
@@ -419,6 +775,7 @@ private:
 #pragma omp parallel
         {
             int y = omp_get_thread_num();
+            NumaPlacement::bindThread(y, threads);
             MyHashTable<ReducNodeInfo const*> uniq;
 
 #pragma omp for schedule(static)
@@ -527,6 +884,8 @@ private:
 //                }
 
                 output.initRow(i, baseColumn[tasks]);
+                NumaPlacement::interleave(output[i].data(),
+                        baseColumn[tasks] * sizeof(Node<ARITY>));
 #ifdef DEBUG
                 etcS3.stop();
                 etcP3.start();
@@ -560,6 +919,272 @@ private:
 #endif // _OPENMP
     }
 
+    /**
+     * Reduces one level by radix sort.
+     * The columns are numbered in the same order as Algorithm-R:
+     * the nodes are grouped by the first occurrence of their 0-children,
+     * and ordered by their own first occurrence in each group.
+     * @param i level.
+     * @param useMP use multiple threads.
+     * @param clearLower release the new IDs of the lower levels that are
+     *        referred by no higher levels.
+     */
+    void reduceRadix_(int i, bool useMP, bool clearLower = true) {
+        int T = 1;
+#ifdef _OPENMP
+        if (useMP) T = threads;
+#endif
+        size_t const m = input[i].size();
+        if (m < RADIX_SIZE * T) T = 1;
+        Node<ARITY>* const tt = input[i].data();
+        MyVector<NodeId>& newId = newIdTable[i];
+        newId.resize(m);
+        if (useMP) NumaPlacement::interleave(newId.data(), m * sizeof(NodeId));
+
+        reserve(sortBuf[0], m);
+        reserve(sortBuf[1], m);
+        reserve(groupStart, m + 1);
+        reserve(groupFirst, m);
+        reserve(groupRun, m);
+        reserve(groupBuf[0], m);
+        reserve(groupBuf[1], m);
+        reserve(chunkCount, T + 1);
+        size_t* order = sortBuf[0].data();
+        size_t* const cnt = chunkCount.data();
+        NodeId const kept(i + 1, 0);
+        cnt[0] = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(T) if (T > 1)
+#endif
+        {
+            int const y = threadNum();
+            if (useMP) NumaPlacement::bindThread(y, T);
+            size_t const lo = m * y / T;
+            size_t const hi = m * (y + 1) / T;
+            size_t k = 0;
+
+            for (size_t j = lo; j < hi; ++j) {
+                Node<ARITY>& f = tt[j];
+
+                // make f canonical
+                NodeId& f0 = f.branch[0];
+                f0 = newIdTable[f0.row()][f0.col()];
+                NodeId deletable = BDD ? f0 : 0;
+                bool del = BDD || ZDD || (f0 == 0);
+                for (int b = 1; b < ARITY; ++b) {
+                    NodeId& ff = f.branch[b];
+                    ff = newIdTable[ff.row()][ff.col()];
+                    if (ff != deletable) del = false;
+                }
+
+                if (del) { // f is redundant
+                    newId[j] = f0;
+                }
+                else {
+                    newId[j] = kept;
+                    ++k;
+                }
+            }
+
+            cnt[y + 1] = k;
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+            {
+                for (int yy = 0; yy < T; ++yy) {
+                    cnt[yy + 1] += cnt[yy];
+                }
+            }
+
+            k = cnt[y];
+            for (size_t j = lo; j < hi; ++j) {
+                if (newId[j] == kept) order[k++] = j;
+            }
+        }
+
+        if (clearLower) {
+            MyVector<int> const& levels = input.lowerLevels(i);
+            for (int const* t = levels.begin(); t != levels.end(); ++t) {
+                newIdTable[*t].clear();
+            }
+        }
+
+        size_t const n = cnt[T];
+        ChildrenKey const key(tt);
+        order = radixSort(order, sortBuf[1].data(), n, key, ARITY, T);
+
+        // find the groups of the equivalent nodes
+        size_t* const start = groupStart.data();
+        size_t* const first = groupFirst.data();
+        size_t* const run = groupRun.data();
+#ifdef _OPENMP
+#pragma omp parallel num_threads(T) if (T > 1)
+#endif
+        {
+            int const y = threadNum();
+            size_t const lo = n * y / T;
+            size_t const hi = n * (y + 1) / T;
+            size_t g = 0;
+
+            for (size_t k = lo; k < hi; ++k) {
+                if (k == 0 || !key.equal(order[k - 1], order[k])) ++g;
+            }
+
+            cnt[y + 1] = g;
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+            {
+                for (int yy = 0; yy < T; ++yy) {
+                    cnt[yy + 1] += cnt[yy];
+                }
+                start[cnt[T]] = n;
+            }
+
+            g = cnt[y];
+            for (size_t k = lo; k < hi; ++k) {
+                if (k == 0 || !key.equal(order[k - 1], order[k])) {
+                    start[g] = k;
+                    first[g] = order[k]; // the first occurrence by stability
+                    ++g;
+                }
+            }
+        }
+
+        // number the groups in the order of Algorithm-R
+        size_t const u = cnt[T];
+        size_t* const go = groupBuf[0].data();
+#ifdef _OPENMP
+#pragma omp parallel num_threads(T) if (T > 1)
+#endif
+        {
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1024)
+#endif
+            for (size_t g = 0; g < u; ++g) {
+                go[g] = g;
+                NodeId const f0 = tt[first[g]].branch[0];
+                if (g > 0 && tt[first[g - 1]].branch[0] == f0) continue;
+
+                size_t e = g + 1;
+                size_t r = first[g];
+                while (e < u && tt[first[e]].branch[0] == f0) {
+                    r = std::min(r, first[e++]);
+                }
+                for (size_t h = g; h < e; ++h) {
+                    run[h] = r;
+                }
+            }
+        }
+
+        size_t const* const rank = radixSort(go, groupBuf[1].data(), u,
+                PairKey(run, first), 2, T);
+
+        output.initRow(i, u);
+        Node<ARITY>* const nt = output[i].data();
+        if (useMP) NumaPlacement::interleave(nt, u * sizeof(Node<ARITY>));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(T) if (T > 1)
+#endif
+        for (size_t r = 0; r < u; ++r) {
+            size_t const g = rank[r];
+            Node<ARITY> const& q = tt[first[g]];
+            NodeId const f(i, r, q.branch[0].hasEmpty());
+            nt[r] = q;
+            for (size_t k = start[g]; k < start[g + 1]; ++k) {
+                newId[order[k]] = f;
+            }
+        }
+
+        input[i].clear();
+
+        for (size_t k = 0; k < rootPtr[i].size(); ++k) {
+            NodeId& root = *rootPtr[i][k];
+            root = newId[root.col()];
+        }
+    }
+
+    /*
+     * Sorts n indices in src stably by the given key of the words
+     * from 0 (most significant) to words - 1.
+     * The digits that are common to all keys are skipped.
+     * Returns the sorted array, which is either src or dst.
+     */
+    template<typename KEY>
+    size_t* radixSort(size_t* src, size_t* dst, size_t n, KEY const& key,
+                      int words, int T) {
+        if (n <= 1) return src;
+        if (n < RADIX_SIZE * T) T = 1;
+        reserve(radixCount, RADIX_SIZE * T);
+        size_t* const cnt = radixCount.data();
+
+        for (int w = words - 1; w >= 0; --w) {
+            uint64_t const k0 = key(src[0], w);
+            uint64_t diff = 0;
+#ifdef _OPENMP
+#pragma omp parallel for reduction(|:diff) num_threads(T) if (T > 1)
+#endif
+            for (size_t k = 1; k < n; ++k) {
+                diff |= key(src[k], w) ^ k0;
+            }
+
+            for (int s = 0; s < 64; s += RADIX_BITS) {
+                if (((diff >> s) & (RADIX_SIZE - 1)) == 0) continue;
+#ifdef _OPENMP
+#pragma omp parallel num_threads(T) if (T > 1)
+#endif
+                {
+                    int const y = threadNum();
+                    size_t const lo = n * y / T;
+                    size_t const hi = n * (y + 1) / T;
+                    size_t* const c = cnt + RADIX_SIZE * y;
+                    std::fill(c, c + RADIX_SIZE, 0);
+
+                    for (size_t k = lo; k < hi; ++k) {
+                        ++c[(key(src[k], w) >> s) & (RADIX_SIZE - 1)];
+                    }
+#ifdef _OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+                    {
+                        size_t base = 0;
+                        for (size_t d = 0; d < RADIX_SIZE; ++d) {
+                            for (int yy = 0; yy < T; ++yy) {
+                                size_t const t = cnt[RADIX_SIZE * yy + d];
+                                cnt[RADIX_SIZE * yy + d] = base;
+                                base += t;
+                            }
+                        }
+                    }
+
+                    for (size_t k = lo; k < hi; ++k) {
+                        size_t d = (key(src[k], w) >> s) & (RADIX_SIZE - 1);
+                        dst[c[d]++] = src[k];
+                    }
+                }
+                std::swap(src, dst);
+            }
+        }
+        return src;
+    }
+
+    static void reserve(MyVector<size_t>& v, size_t n) {
+        if (v.size() < n) v.resize(n);
+    }
+
+    static int threadNum() {
+#ifdef _OPENMP
+        return omp_get_thread_num();
+#else
+        return 0;
+#endif
+    }
+
 public:
     void garbageCollect() {
         // Initialize marks
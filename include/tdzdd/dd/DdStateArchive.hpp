@@ -0,0 +1,295 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "DdBuilder.hpp"
+#include "DdCheckpoint.hpp"
+#include "Node.hpp"
+#include "../util/MyList.hpp"
+#include "../util/MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Record of a DD construction for incremental reconstruction.
+ * It keeps two kinds of information:
+ * - the frontiers of the construction, that is, checkpoints saved
+ *   as files at the boundaries of every @p interval levels, and
+ * - the states of the nodes at each level with their node IDs in the
+ *   resulting diagram, which are updated as the diagram is swept.
+ *
+ * When the behavior of the spec changes only at levels lo to hi,
+ * the construction is resumed from the lowest frontier not below hi,
+ * and the states at the levels below lo that have been seen before are
+ * linked to the sub-diagrams built before instead of being expanded.
+ * States are written to the files as raw bytes;
+ * therefore they must not contain pointers to other memory blocks.
+ * @tparam S the spec type.
+ */
+template<typename S>
+class DdStateArchive: DdBuilderBase {
+    typedef S Spec;
+    typedef MyHashTable<SpecNode const*,Hasher<Spec>,Hasher<Spec> > Index;
+
+    std::string prefix;
+    int interval;
+    int specNodeSize;
+    Spec* spec;
+    MyVector<SpecNode> probe;
+
+    MyVector<MyList<SpecNode> > stateTable;
+    MyVector<MyVector<NodeId> > idTable;
+    MyVector<Index*> indexTable;
+    MyVector<bool> saved;
+
+public:
+    /**
+     * Constructor.
+     * @param prefix path prefix of the frontier files.
+     * @param interval interval of the frontiers in levels.
+     */
+    explicit DdStateArchive(std::string const& prefix, int interval = 16) :
+            prefix(prefix),
+            interval(interval >= 1 ? interval : 1),
+            specNodeSize(0),
+            spec(0) {
+    }
+
+    ~DdStateArchive() {
+        clear();
+    }
+
+    /**
+     * Gets the top level of the recorded construction.
+     * @return the top level; 0 if nothing is recorded.
+     */
+    int topLevel() const {
+        return stateTable.empty() ? 0 : int(stateTable.size()) - 1;
+    }
+
+    /**
+     * Gets the number of the recorded states.
+     * @return the number of the states.
+     */
+    size_t size() const {
+        size_t k = 0;
+        for (size_t i = 0; i < idTable.size(); ++i) {
+            k += idTable[i].size();
+        }
+        return k;
+    }
+
+    /**
+     * Checks if the frontier above a level should be saved.
+     * @param level the next level to be constructed at the frontier.
+     * @return true if the level is on the boundaries.
+     */
+    bool isFrontier(int level) const {
+        return 0 < level && level < topLevel() && level % interval == 0;
+    }
+
+    /**
+     * Finds the lowest saved frontier not below a level.
+     * @param level the level.
+     * @return the next level to be constructed at the frontier;
+     *         0 if not found.
+     */
+    int frontierAbove(int level) const {
+        for (int i = std::max(level, 1); size_t(i) < saved.size(); ++i) {
+            if (saved[i]) return i;
+        }
+        return 0;
+    }
+
+    /**
+     * Gets the file name of a frontier.
+     * @param level the next level to be constructed at the frontier.
+     * @return the file name.
+     */
+    std::string frontierPath(int level) const {
+        char buf[32];
+        std::sprintf(buf, ".%d.ckp", level);
+        return prefix + buf;
+    }
+
+    /**
+     * Marks a frontier as saved.
+     * @param level the next level to be constructed at the frontier.
+     */
+    void setFrontier(int level) {
+        saved[level] = true;
+    }
+
+    /**
+     * Clears everything and removes the frontier files.
+     */
+    void clear() {
+        for (size_t i = 0; i < saved.size(); ++i) {
+            if (saved[i]) DdCheckpointFile::remove(frontierPath(i));
+        }
+        saved.clear();
+        for (int i = topLevel(); i >= 1; --i) {
+            clearLevel(i);
+        }
+        stateTable.clear();
+        idTable.clear();
+        indexTable.clear();
+        delete spec;
+        spec = 0;
+    }
+
+    /**
+     * Starts recording a new construction.
+     * @param s the spec.
+     * @param n the top level.
+     */
+    void reset(Spec const& s, int n) {
+        clear();
+        setSpec(s);
+        stateTable.resize(n + 1);
+        idTable.resize(n + 1);
+        indexTable.resize(n + 1);
+        saved.resize(n + 1);
+    }
+
+    /**
+     * Prepares for a reconstruction from a frontier.
+     * The records at the levels from lo to hi and the frontiers below hi
+     * are discarded.
+     * @param s the spec of the reconstruction.
+     * @param lo the lowest level to be reconstructed.
+     * @param hi the frontier level.
+     */
+    void update(Spec const& s, int lo, int hi) {
+        for (int i = std::max(lo, 1); i <= hi; ++i) {
+            clearLevel(i);
+        }
+        for (int i = 1; i < hi; ++i) {
+            if (saved[i]) DdCheckpointFile::remove(frontierPath(i));
+            saved[i] = false;
+        }
+        setSpec(s);
+    }
+
+    /**
+     * Records the state of a node.
+     * @param level the level of the node.
+     * @param s the state.
+     * @param f the node ID.
+     */
+    void add(int level, void const* s, NodeId f) {
+        SpecNode* p = stateTable[level].alloc_front(specNodeSize);
+        code(p) = idTable[level].size();
+        spec->get_copy(state(p), s);
+        idTable[level].push_back(f);
+        if (indexTable[level]) indexTable[level]->add(p);
+    }
+
+    /**
+     * Looks up a state.
+     * @param level the level of the state.
+     * @param s the state.
+     * @return pointer to the node ID of the equivalent state recorded;
+     *         null if not found.
+     */
+    NodeId const* find(int level, void const* s) {
+        MyList<SpecNode>& snodes = stateTable[level];
+        if (snodes.empty()) return 0;
+
+        Index*& index = indexTable[level];
+        if (index == 0) {
+            Hasher<Spec> hasher(*spec, level);
+            index = new Index(snodes.size() * 2, hasher, hasher);
+            for (MyList<SpecNode>::iterator t = snodes.begin();
+                    t != snodes.end(); ++t) {
+                index->add(*t);
+            }
+        }
+
+        spec->get_copy(state(probe.data()), s);
+        SpecNode const* const* p0 = index->get(probe.data());
+        spec->destruct(state(probe.data()));
+        return p0 ? &idTable[level][(*p0)[0].code] : 0;
+    }
+
+    /**
+     * Gets the node IDs to be updated as the diagram is swept.
+     * @return the node IDs indexed by levels.
+     */
+    MyVector<MyVector<NodeId> >& nodeIds() {
+        return idTable;
+    }
+
+    /**
+     * Writes the node IDs above a frontier to a checkpoint file.
+     * @param file the checkpoint file.
+     * @param level the next level to be constructed at the frontier.
+     */
+    void saveIds(DdCheckpointFile& file, int level) const {
+        for (int i = level + 1; i <= topLevel(); ++i) {
+            file.putVector(idTable[i]);
+        }
+    }
+
+    /**
+     * Reads the node IDs above a frontier from a checkpoint file.
+     * @param file the checkpoint file.
+     * @param level the next level to be constructed at the frontier.
+     */
+    void loadIds(DdCheckpointFile& file, int level) {
+        for (int i = level + 1; i <= topLevel(); ++i) {
+            file.getVector(idTable[i]);
+        }
+    }
+
+private:
+    void setSpec(Spec const& s) {
+        Spec* tmp = new Spec(s);
+        delete spec;
+        spec = tmp;
+        specNodeSize = getSpecNodeSize(spec->datasize());
+        probe.resize(specNodeSize);
+        for (size_t i = 0; i < indexTable.size(); ++i) {
+            delete indexTable[i];
+            indexTable[i] = 0;
+        }
+    }
+
+    void clearLevel(int i) {
+        delete indexTable[i];
+        indexTable[i] = 0;
+        MyList<SpecNode>& snodes = stateTable[i];
+        for (; !snodes.empty(); snodes.pop_front()) {
+            spec->destruct(state(snodes.front()));
+        }
+        idTable[i].clear();
+    }
+};
+
+} // namespace tdzdd
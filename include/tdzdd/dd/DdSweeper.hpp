@@ -24,24 +24,42 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <ostream>
 
+#include "DdCheckpoint.hpp"
 #include "Node.hpp"
 #include "NodeTable.hpp"
 #include "../util/MessageHandler.hpp"
+#include "../util/MyHashTable.hpp"
 #include "../util/MyVector.hpp"
 
 namespace tdzdd {
 
+/**
+ * Reduction rules applied during top-down DD construction.
+ */
+enum DdReduction {
+    NO_REDUCTION,  ///< Only the nodes equivalent to the 0-terminal are removed.
+    QDD_REDUCTION, ///< Equivalent nodes are shared.
+    BDD_REDUCTION, ///< QDD reduction and the BDD node deletion rule.
+    ZDD_REDUCTION  ///< QDD reduction and the ZDD node deletion rule.
+};
+
 /**
  * On-the-fly DD cleaner.
  * Removes the nodes that are identified as equivalent to the 0-terminal
  * while top-down DD construction.
+ * Optionally, it also applies the reduction rules to the levels whose
+ * edges are all completed, so that the diagram is reduced without an
+ * unreduced copy when the construction ends.
  */
 template<int ARITY>
 class DdSweeper {
     static size_t const SWEEP_RATIO = 20;
+    static size_t const REDUCE_RATIO = 2;
+    static size_t const REDUCE_MIN = 1024;
 
     NodeTableEntity<ARITY>& diagram;
     MyVector<NodeBranchId>* oneSrcPtr;
@@ -51,6 +69,10 @@ class DdSweeper {
     size_t allCount;
     size_t maxCount;
     NodeId* rootPtr;
+    MyVector<MyVector<NodeId> >* trackedIds;
+
+    DdReduction reduction;
+    size_t reducedCount;
 
 public:
     /**
@@ -58,7 +80,8 @@ public:
      * @param diagram the diagram to sweep.
      */
     DdSweeper(NodeTableEntity<ARITY>& diagram) :
-            diagram(diagram), oneSrcPtr(0), allCount(0), maxCount(0), rootPtr(0) {
+            diagram(diagram), oneSrcPtr(0), allCount(0), maxCount(0), rootPtr(0),
+            trackedIds(0), reduction(NO_REDUCTION), reducedCount(REDUCE_MIN) {
     }
 
     /**
@@ -72,7 +95,10 @@ public:
             oneSrcPtr(&oneSrcPtr),
             allCount(0),
             maxCount(0),
-            rootPtr(0) {
+            rootPtr(0),
+            trackedIds(0),
+            reduction(NO_REDUCTION),
+            reducedCount(REDUCE_MIN) {
     }
 
     /**
@@ -83,6 +109,25 @@ public:
         rootPtr = &root;
     }
 
+    /**
+     * Registers external node IDs to be kept valid across sweeping.
+     * Each ID at index i must not be above level i.
+     * @param ids the node IDs indexed by levels.
+     */
+    void track(MyVector<MyVector<NodeId> >& ids) {
+        trackedIds = &ids;
+    }
+
+    /**
+     * Selects the reduction rules.
+     * When it is not NO_REDUCTION, the diagram is completely reduced
+     * at the end of the construction (level 1).
+     * @param rule the reduction rules.
+     */
+    void setReduction(DdReduction rule) {
+        reduction = rule;
+    }
+
     /**
      * Updates status and sweeps the DD if necessary.
      * @param current current level.
@@ -92,7 +137,10 @@ public:
     void update(int current, int child, size_t count) {
         assert(1 <= current);
         assert(0 <= child);
-        if (current <= 1) return;
+        if (current <= 1) {
+            if (reduction != NO_REDUCTION) sweep(1, true);
+            return;
+        }
 
         if (size_t(current) >= sweepLevel.size()) {
             sweepLevel.resize(current + 1);
@@ -113,18 +161,74 @@ public:
             deadCount[i] = 0;
         }
         if (maxCount < allCount) maxCount = allCount;
-        if (deadCount[k] * SWEEP_RATIO < maxCount) return;
+        if (deadCount[k] * SWEEP_RATIO < maxCount
+                && (reduction == NO_REDUCTION
+                        || allCount < reducedCount * REDUCE_RATIO)) return;
+
+        sweep(k, false);
+        deadCount[k] = 0;
+    }
+
+    /**
+     * Writes the bookkeeping data to a checkpoint file.
+     * @param file the checkpoint file.
+     */
+    void save(DdCheckpointFile& file) const {
+        file.putVector(sweepLevel);
+        file.putVector(deadCount);
+        file.put(allCount);
+        file.put(maxCount);
+        file.put(reducedCount);
+    }
+
+    /**
+     * Reads the bookkeeping data from a checkpoint file.
+     * @param file the checkpoint file.
+     */
+    void load(DdCheckpointFile& file) {
+        file.getVector(sweepLevel);
+        file.getVector(deadCount);
+        allCount = file.get<size_t>();
+        maxCount = file.get<size_t>();
+        reducedCount = file.get<size_t>();
+    }
 
+private:
+    /*
+     * Checks if node p can be deleted by the node deletion rule.
+     * The 1-terminal is not final until the end of the construction
+     * because it may be merged into the 0-terminal.
+     */
+    bool deletable(Node<ARITY> const& p, bool final) const {
+        NodeId const f0 = p.branch[0];
+        if (reduction == QDD_REDUCTION) return false;
+        if (f0 == 1 && oneSrcPtr && !final) return false;
+
+        NodeId const f = (reduction == BDD_REDUCTION) ? f0 : NodeId(0);
+        for (int b = 1; b < ARITY; ++b) {
+            if (p.branch[b] != f) return false;
+        }
+        return true;
+    }
+
+    /*
+     * Removes dead nodes at level k and above,
+     * and applies the reduction rules to them.
+     */
+    void sweep(int k, bool final) {
         MyVector<MyVector<NodeId> > newId(diagram.numRows());
 
         MessageHandler mh;
-        mh.begin("sweeping") << " <" << diagram.size() << "> ...";
+        mh.begin(reduction == NO_REDUCTION ? "sweeping" : "reducing") << " <"
+                << diagram.size() << "> ...";
 
         for (int i = k; i < diagram.numRows(); ++i) {
             size_t m = diagram[i].size();
             newId[i].resize(m);
 
             size_t jj = 0;
+            MyHashTable<Node<ARITY> const*> uniq;
+            if (reduction != NO_REDUCTION) uniq.initialize(m * 2);
 
             for (size_t j = 0; j < m; ++j) {
                 Node<ARITY>& p = diagram[i][j];
@@ -139,11 +243,27 @@ public:
                 if (dead) {
                     newId[i][j] = 0;
                 }
-                else {
+                else if (reduction == NO_REDUCTION) {
                     newId[i][j] = NodeId(i, jj);
                     diagram[i][jj] = p;
                     ++jj;
                 }
+                else if (deletable(p, final)) {
+                    newId[i][j] = p.branch[0];
+                }
+                else {
+                    bool const attr = p.branch[0].hasEmpty();
+                    Node<ARITY>* const q = &diagram[i][jj];
+                    *q = p;
+                    Node<ARITY> const* q0 = uniq.add(q);
+
+                    if (q0 == q) {
+                        newId[i][j] = NodeId(i, jj++, attr);
+                    }
+                    else {
+                        newId[i][j] = NodeId(i, q0 - diagram[i].data(), attr);
+                    }
+                }
             }
 
             diagram[i].resize(jj);
@@ -160,9 +280,23 @@ public:
             }
         }
 
-        *rootPtr = newId[rootPtr->row()][rootPtr->col()];
-        deadCount[k] = 0;
+        if (trackedIds) {
+            for (size_t i = k; i < trackedIds->size(); ++i) {
+                MyVector<NodeId>& ids = (*trackedIds)[i];
+                for (size_t j = 0; j < ids.size(); ++j) {
+                    NodeId& f = ids[j];
+                    if (f.row() >= k) f = newId[f.row()][f.col()];
+                }
+            }
+        }
+
+        if (rootPtr->row() >= k) {
+            *rootPtr = newId[rootPtr->row()][rootPtr->col()];
+        }
         allCount = diagram.size();
+        if (reduction != NO_REDUCTION) {
+            reducedCount = std::max(allCount, size_t(REDUCE_MIN));
+        }
         mh.end(diagram.size());
     }
 };
@@ -0,0 +1,356 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cassert>
+
+#include "DdBuilder.hpp"
+#include "DdBuilderOptions.hpp"
+#include "DdSweeper.hpp"
+#include "Node.hpp"
+#include "NodeTable.hpp"
+#include "../util/MyHashTable.hpp"
+#include "../util/MyList.hpp"
+#include "../util/MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Depth-first DD builder with memoization.
+ * Each state is looked up in the unique table of its level, and a new
+ * node is made only when the state has not been seen yet.
+ * Unlike DdBuilder, it keeps only the states on the current path as
+ * pending ones, and it has no per-level scheduling overhead;
+ * it is suitable for specs with a large number of levels of small widths.
+ * Since the subdiagram of a node is completed when the node is made,
+ * the reduction rules can be applied on the fly.
+ * merge_states(void*, void*) is not supported.
+ */
+template<typename S>
+class DepthFirstBuilder: DdBuilderBase {
+    typedef S Spec;
+    typedef MyHashTable<SpecNode*,Hasher<Spec>,Hasher<Spec> > UniqTable;
+    static int const AR = Spec::ARITY;
+
+    /*
+     * Hash function of the nodes in a row, identified by (column + 1).
+     */
+    struct NodeHasher {
+        MyVector<Node<AR> > const& row;
+
+        NodeHasher(MyVector<Node<AR> > const& row) :
+                row(row) {
+        }
+
+        size_t operator()(size_t k) const {
+            return row[k - 1].hash();
+        }
+
+        bool operator()(size_t k, size_t l) const {
+            return row[k - 1] == row[l - 1];
+        }
+    };
+
+    typedef MyHashTable<size_t,NodeHasher,NodeHasher> NodeUniqTable;
+
+    /*
+     * A node under construction.
+     */
+    struct Frame {
+        SpecNode* p;  ///< memoized state of the node.
+        SpecNode* pp; ///< work area for the child states.
+        int level;    ///< level of the node.
+        int value;    ///< branch under construction.
+        size_t col;   ///< column of the node.
+    };
+
+    Spec spec;
+    int const specNodeSize;
+    NodeTableEntity<AR>& output;
+
+    MyList<SpecNode> snodes;
+    MyVector<UniqTable*> uniqTable;
+    MyVector<NodeUniqTable*> nodeUniqTable;
+    MyList<SpecNode> statePool;
+    MyVector<Frame> stack;
+
+    DdReduction reduction;
+    DdBuildLimiter limiter;
+    size_t limitCheckCount;
+    int abortLevel;
+    size_t abortBytes;
+
+    void init(int n) {
+        clear();
+        uniqTable.resize(n + 1);
+        nodeUniqTable.resize(n + 1);
+        if (n >= output.numRows()) output.setNumRows(n + 1);
+    }
+
+    void clear() {
+        for (; !snodes.empty(); snodes.pop_front()) {
+            spec.destruct(state(snodes.front()));
+        }
+        for (size_t i = 0; i < uniqTable.size(); ++i) {
+            delete uniqTable[i];
+            delete nodeUniqTable[i];
+        }
+        uniqTable.clear();
+        nodeUniqTable.clear();
+    }
+
+public:
+    DepthFirstBuilder(Spec const& spec, NodeTableHandler<AR>& output) :
+            spec(spec),
+            specNodeSize(getSpecNodeSize(spec.datasize())),
+            output(output.privateEntity()),
+            reduction(NO_REDUCTION),
+            limitCheckCount(0),
+            abortLevel(0),
+            abortBytes(0) {
+    }
+
+    ~DepthFirstBuilder() {
+        clear();
+    }
+
+    /**
+     * Selects the reduction rules applied during the construction.
+     * @param rule the reduction rules.
+     */
+    void setReduction(DdReduction rule) {
+        reduction = rule;
+    }
+
+    /**
+     * Sets the resource limits.
+     * The limits are checked periodically during the construction.
+     * When a limit is exceeded, DdBuildLimitExceeded is thrown.
+     * @param memoryLimit upper limit of memoryUsage() in bytes;
+     *        0 for no limit.
+     * @param timeLimit upper limit of the elapsed time in seconds
+     *        from this call; 0 for no limit.
+     */
+    void setLimits(size_t memoryLimit, double timeLimit) {
+        limiter.set(memoryLimit, timeLimit);
+    }
+
+    /**
+     * Estimates the memory usage of the builder.
+     * It counts the output nodes and the memoized states.
+     * @return the memory usage in bytes.
+     */
+    size_t memoryUsage() const {
+        size_t bytes = 0;
+        for (int i = 0; i < output.numRows(); ++i) {
+            bytes += output[i].size() * sizeof(Node<AR> );
+        }
+        bytes += snodes.size() * (specNodeSize + 1) * sizeof(SpecNode);
+        for (size_t i = 0; i < uniqTable.size(); ++i) {
+            if (uniqTable[i] != 0) {
+                bytes += uniqTable[i]->tableSize() * sizeof(SpecNode*);
+            }
+            if (nodeUniqTable[i] != 0) {
+                bytes += nodeUniqTable[i]->tableSize() * sizeof(size_t);
+            }
+        }
+        return bytes;
+    }
+
+    /**
+     * Builds the DD.
+     * @param root result storage.
+     * @return the level of the root node.
+     */
+    int construct(NodeId& root) {
+        SpecNode* p = statePool.alloc_front(specNodeSize);
+        int n = spec.get_root(state(p));
+
+        if (n <= 0) {
+            root = n ? 1 : 0;
+            n = 0;
+        }
+        else {
+            init(n);
+            abortLevel = 0;
+            root = build(p, n);
+
+            for (int i = n; i >= 1; --i) {
+                spec.destructLevel(i);
+            }
+        }
+
+        spec.destruct(state(p));
+        statePool.pop_front();
+        clear();
+
+        if (abortLevel > 0) {
+            limiter.raise(abortLevel, abortBytes, output);
+        }
+        return n;
+    }
+
+private:
+    /*
+     * Looks up state p at level i in the unique table.
+     * Returns null if it is not found.
+     */
+    SpecNode* find(SpecNode* p, int i) {
+        UniqTable*& uniq = uniqTable[i];
+        if (uniq == 0) {
+            Hasher<Spec> hasher(spec, i);
+            uniq = new UniqTable(hasher, hasher);
+        }
+
+        SpecNode* const* e = uniq->get(p);
+        return (e != 0) ? *e : 0;
+    }
+
+    /*
+     * Memoizes state p at level i and starts its node.
+     * Returns false if a limit is exceeded.
+     */
+    bool open(SpecNode* p, int i) {
+        if (limiter.enabled() && ++limitCheckCount % 1024 == 0) {
+            size_t const bytes = memoryUsage();
+            if (!limiter.check(bytes)) {
+                abortLevel = i;
+                abortBytes = bytes;
+                return false;
+            }
+        }
+
+        SpecNode* q = snodes.alloc_front(specNodeSize);
+        spec.get_copy(state(q), state(p));
+        uniqTable[i]->add(q);
+
+        Frame fr;
+        fr.p = q;
+        fr.pp = statePool.alloc_front(specNodeSize);
+        fr.level = i;
+        fr.value = 0;
+        fr.col = output[i].size();
+        checkNodeId(i, fr.col + 1);
+        output[i].push_back(Node<AR>());
+        stack.push_back(fr);
+        return true;
+    }
+
+    /*
+     * Returns the node for state p at level i.
+     * The state of p is not destructed.
+     * The recursion is unrolled into an explicit stack so that the depth
+     * is not limited by the call stack.
+     */
+    NodeId build(SpecNode* p, int i) {
+        SpecNode* q = find(p, i);
+        if (q != 0) return nodeId(q);
+        if (!open(p, i)) return 0;
+
+        NodeId f;
+
+        while (true) {
+            Frame& fr = stack.back();
+
+            if (fr.value == AR) { // all branches are completed
+                f = close(fr);
+                statePool.pop_front();
+                stack.pop_back();
+                if (stack.empty()) break;
+
+                Frame& parent = stack.back();
+                spec.destruct(state(parent.pp));
+                output[parent.level][parent.col].branch[parent.value++] = f;
+                continue;
+            }
+
+            spec.get_copy(state(fr.pp), state(fr.p));
+            int ii = spec.get_child(state(fr.pp), fr.level, fr.value);
+
+            if (ii <= 0) {
+                f = ii ? 1 : 0;
+            }
+            else {
+                assert(ii < fr.level);
+                q = find(fr.pp, ii);
+                if (q == 0 && abortLevel == 0 && open(fr.pp, ii)) continue;
+                f = (q != 0) ? nodeId(q) : NodeId(0);
+            }
+
+            spec.destruct(state(fr.pp));
+            output[fr.level][fr.col].branch[fr.value++] = f;
+        }
+
+        return f;
+    }
+
+    /*
+     * Determines the ID of a completed node, applying the reduction rules.
+     * The node is the last one in its row.
+     */
+    NodeId close(Frame const& fr) {
+        int const i = fr.level;
+        size_t const j = fr.col;
+        Node<AR> const& node = output[i][j];
+        NodeId const f0 = node.branch[0];
+        NodeId& f = nodeId(fr.p);
+
+        bool dead = true;
+        for (int b = 0; b < AR; ++b) {
+            if (node.branch[b] != 0) dead = false;
+        }
+
+        if (dead) {
+            output[i].pop_back();
+            return f = 0;
+        }
+
+        if (reduction == NO_REDUCTION) return f = NodeId(i, j);
+
+        if (reduction != QDD_REDUCTION) {
+            NodeId const g = (reduction == BDD_REDUCTION) ? f0 : NodeId(0);
+            bool del = true;
+            for (int b = 1; b < AR; ++b) {
+                if (node.branch[b] != g) del = false;
+            }
+            if (del) {
+                output[i].pop_back();
+                return f = f0;
+            }
+        }
+
+        NodeUniqTable*& uniq = nodeUniqTable[i];
+        if (uniq == 0) {
+            NodeHasher hasher(output[i]);
+            uniq = new NodeUniqTable(hasher, hasher);
+        }
+
+        size_t const k = uniq->add(j + 1) - 1;
+        if (k != j) output[i].pop_back();
+        return f = NodeId(i, k, f0.hasEmpty());
+    }
+};
+
+} // namespace tdzdd
@@ -25,26 +25,92 @@
 #pragma once
 
 #include <cassert>
+#include <sstream>
+#include <stdexcept>
 #include <stdint.h>
 #include <ostream>
 
+/*
+ * Node ID layout.
+ * Define TDZDD_COMPACT_NODE to use 32-bit node IDs, which halves the size
+ * of the nodes; the default layout then allows 255 levels and 2^23 nodes
+ * per level.  TDZDD_NODE_ROW_BITS sets the number of bits for the level,
+ * which must be an integer literal.
+ * The macros must be defined identically in all translation units.
+ * The definitions below are placed in a namespace named after the layout,
+ * e.g. tdzdd::node_layout_64_20, so that the symbols using them differ
+ * between layouts; translation units of different layouts that share them
+ * fail to link instead of silently sharing one of the definitions.
+ */
+#ifndef TDZDD_NODE_ROW_BITS
+#ifdef TDZDD_COMPACT_NODE
+#define TDZDD_NODE_ROW_BITS 8
+#else
+#define TDZDD_NODE_ROW_BITS 20
+#endif
+#endif
+
+#ifdef TDZDD_COMPACT_NODE
+#define TDZDD_NODE_CODE_BITS 32
+#else
+#define TDZDD_NODE_CODE_BITS 64
+#endif
+
+#define TDZDD_NODE_LAYOUT_NAME_(c, r) node_layout_##c##_##r
+#define TDZDD_NODE_LAYOUT_NAME(c, r) TDZDD_NODE_LAYOUT_NAME_(c, r)
+#define TDZDD_NODE_LAYOUT \
+        TDZDD_NODE_LAYOUT_NAME(TDZDD_NODE_CODE_BITS, TDZDD_NODE_ROW_BITS)
+
 namespace tdzdd {
+namespace TDZDD_NODE_LAYOUT {
 
-int const NODE_ROW_BITS = 20;
+#ifdef TDZDD_COMPACT_NODE
+typedef uint32_t NodeCode;
+#else
+typedef uint64_t NodeCode;
+#endif
+
+int const NODE_CODE_BITS = sizeof(NodeCode) * 8;
+int const NODE_ROW_BITS = TDZDD_NODE_ROW_BITS;
 int const NODE_ATTR_BITS = 1;
-int const NODE_COL_BITS = 64 - NODE_ROW_BITS - NODE_ATTR_BITS;
+int const NODE_COL_BITS = NODE_CODE_BITS - NODE_ROW_BITS - NODE_ATTR_BITS;
 
 int const NODE_ROW_OFFSET = NODE_COL_BITS + NODE_ATTR_BITS;
 int const NODE_ATTR_OFFSET = NODE_COL_BITS;
 
-uint64_t const NODE_ROW_MAX = (uint64_t(1) << NODE_ROW_BITS) - 1;
-uint64_t const NODE_COL_MAX = (uint64_t(1) << NODE_COL_BITS) - 1;
+NodeCode const NODE_ROW_MAX = (NodeCode(1) << NODE_ROW_BITS) - 1;
+NodeCode const NODE_COL_MAX = (NodeCode(1) << NODE_COL_BITS) - 1;
 
-uint64_t const NODE_ROW_MASK = NODE_ROW_MAX << NODE_ROW_OFFSET;
-uint64_t const NODE_ATTR_MASK = uint64_t(1) << NODE_ATTR_OFFSET;
+NodeCode const NODE_ROW_MASK = NODE_ROW_MAX << NODE_ROW_OFFSET;
+NodeCode const NODE_ATTR_MASK = NodeCode(1) << NODE_ATTR_OFFSET;
+
+/**
+ * Checks if the node IDs of a level can be represented.
+ * @param row the level.
+ * @param cols the number of nodes at the level.
+ * @return true if the node IDs fit in the layout.
+ */
+inline bool nodeIdFits(int row, size_t cols) {
+    return uint64_t(row) <= NODE_ROW_MAX
+            && (cols == 0 || uint64_t(cols - 1) <= NODE_COL_MAX);
+}
+
+/**
+ * Throws an exception if the node IDs of a level cannot be represented.
+ * @param row the level.
+ * @param cols the number of nodes at the level.
+ */
+inline void checkNodeId(int row, size_t cols) {
+    if (nodeIdFits(row, cols)) return;
+    std::ostringstream oss;
+    oss << "Node ID overflow: level " << row << " with " << cols
+            << " nodes does not fit in the " << NODE_CODE_BITS
+            << "-bit layout with " << NODE_ROW_BITS << " row bits";
+    throw std::runtime_error(oss.str());
+}
 
 class NodeId {
-    uint64_t code_;
+    NodeCode code_;
 
 public:
     NodeId() { // 'code_' is not initialized in the default constructor for SPEED. @suppress("Class members should be properly initialized")
@@ -55,13 +121,13 @@ public:
     }
 
     NodeId(uint64_t row, uint64_t col) :
-            code_((row << NODE_ROW_OFFSET) | col) {
+            code_((NodeCode(row) << NODE_ROW_OFFSET) | NodeCode(col)) {
         assert(row <= NODE_ROW_MAX);
         assert(col <= NODE_COL_MAX);
     }
 
     NodeId(uint64_t row, uint64_t col, bool attr) :
-            code_((row << NODE_ROW_OFFSET) | col) {
+            code_((NodeCode(row) << NODE_ROW_OFFSET) | NodeCode(col)) {
         assert(row <= NODE_ROW_MAX);
         assert(col <= NODE_COL_MAX);
         setAttr(attr);
@@ -211,4 +277,8 @@ struct InitializedNode: Node<ARITY> {
     }
 };
 
+} // namespace TDZDD_NODE_LAYOUT
+
+using namespace TDZDD_NODE_LAYOUT;
+
 } // namespace tdzdd
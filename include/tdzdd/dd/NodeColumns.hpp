@@ -0,0 +1,144 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cassert>
+
+#include "DataTable.hpp"
+#include "Node.hpp"
+#include "NodeTable.hpp"
+#include "../util/MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Node table in the structure-of-arrays layout.
+ * The b-th child IDs of the nodes at each level are stored in a separate
+ * array, and the nodes are grouped into blocks of a fixed size.
+ * For each block and branch, the level of the children is recorded when
+ * it is common to all the nodes in the block, so that their values can be
+ * gathered from a single array.
+ * @tparam ARITY arity of the nodes.
+ */
+template<int ARITY>
+class NodeColumns {
+    static size_t const BLOCK_SIZE = 256;
+
+    DataTable<NodeId> branch[ARITY];
+    DataTable<int> blockLevel[ARITY];
+
+public:
+    /**
+     * Constructor.
+     * @param table the node table to be converted.
+     * @param useMP use multiple threads.
+     */
+    NodeColumns(NodeTableEntity<ARITY> const& table, bool useMP = false) {
+        int const n = table.numRows();
+        for (int b = 0; b < ARITY; ++b) {
+            branch[b].init(n);
+            blockLevel[b].init(n);
+        }
+
+        for (int i = 1; i < n; ++i) {
+            size_t const m = table[i].size();
+            size_t const mb = (m + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            for (int b = 0; b < ARITY; ++b) {
+                branch[b][i].resize(m);
+                blockLevel[b][i].resize(mb);
+            }
+            Node<ARITY> const* const node = table[i].data();
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (useMP)
+#endif
+            for (intmax_t k = 0; k < intmax_t(mb); ++k) {
+                size_t const j0 = k * BLOCK_SIZE;
+                size_t const j1 = std::min(j0 + BLOCK_SIZE, m);
+
+                for (int b = 0; b < ARITY; ++b) {
+                    NodeId* const f = branch[b][i].data();
+                    int level = node[j0].branch[b].row();
+
+                    for (size_t j = j0; j < j1; ++j) {
+                        f[j] = node[j].branch[b];
+                        if (f[j].row() != level) level = -1;
+                    }
+
+                    blockLevel[b][i][k] = level;
+                }
+            }
+        }
+    }
+
+    /**
+     * Gets the number of nodes in a block.
+     * @return the block size.
+     */
+    static size_t blockSize() {
+        return BLOCK_SIZE;
+    }
+
+    /**
+     * Gets the number of rows.
+     * @return the number of rows.
+     */
+    int numRows() const {
+        return branch[0].numRows();
+    }
+
+    /**
+     * Gets the number of nodes at a level.
+     * @param i level.
+     * @return the number of nodes.
+     */
+    size_t size(int i) const {
+        return branch[0][i].size();
+    }
+
+    /**
+     * Gets the b-th child IDs of the nodes at a level.
+     * @param i level.
+     * @param b branch index.
+     * @return array of child IDs.
+     */
+    NodeId const* branches(int i, int b) const {
+        return branch[b][i].data();
+    }
+
+    /**
+     * Gets the common level of the b-th children in a block.
+     * @param i level.
+     * @param k block index.
+     * @param b branch index.
+     * @return the common level, or -1 if they are at different levels.
+     */
+    int commonLevel(int i, size_t k, int b) const {
+        assert(k < blockLevel[b][i].size());
+        return blockLevel[b][i][k];
+    }
+};
+
+} // namespace tdzdd
@@ -27,19 +27,57 @@
 #include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cstdio>
+#include <cstring>
 #include <ostream>
 #include <stdexcept>
+#include <stdint.h>
+#include <string>
 
 #include "Node.hpp"
 #include "DataTable.hpp"
+#include "../util/Atomic.hpp"
+#include "../util/MappedFile.hpp"
 #include "../util/MyVector.hpp"
 
 namespace tdzdd {
 
 template<int ARITY>
 class NodeTableEntity: public DataTable<Node<ARITY> > {
-    mutable MyVector<MyVector<int> > higherLevelTable;
-    mutable MyVector<MyVector<int> > lowerLevelTable;
+    struct LevelIndex {
+        MyVector<MyVector<int> > higherLevelTable;
+        MyVector<MyVector<int> > lowerLevelTable;
+    };
+
+    mutable LevelIndex* volatile index;
+    MappedFile* mappedFile;
+
+    /*
+     * Header of the binary format, followed by the row directory
+     * (offset and size of each row) and the rows aligned to BINARY_ALIGN.
+     */
+    struct BinaryHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint32_t arity;
+        uint32_t nodeSize;
+        uint32_t rowBits;
+        uint32_t numRows;
+        uint64_t root;
+    };
+
+    static uint32_t const BINARY_VERSION = 1;
+    static uint32_t const BINARY_BYTE_ORDER = 0x01020304;
+    static uint64_t const BINARY_ALIGN = 64;
+
+    static void binaryError(char const* what, std::string const& path) {
+        throw std::runtime_error(std::string(what) + " binary DD file: " + path);
+    }
+
+    static uint64_t binaryAlign(uint64_t offset) {
+        return (offset + BINARY_ALIGN - 1) / BINARY_ALIGN * BINARY_ALIGN;
+    }
 
 public:
     /**
@@ -47,21 +85,57 @@ public:
      * @param n the number of rows.
      */
     NodeTableEntity(int n = 1)
-            : DataTable<Node<ARITY> >(n) {
+            : DataTable<Node<ARITY> >(n), index(0), mappedFile(0) {
         assert(n >= 1);
         initTerminals();
     }
 
+    /**
+     * Copy constructor.
+     * The rows are copied even if the source is a mapped file.
+     * @param o the source table.
+     */
+    NodeTableEntity(NodeTableEntity const& o)
+            : DataTable<Node<ARITY> >(o),
+              index(o.index ? new LevelIndex(*o.index) : 0), mappedFile(0) {
+    }
+
+    NodeTableEntity& operator=(NodeTableEntity const& o) {
+        DataTable<Node<ARITY> >::operator=(o);
+        copyIndex(o);
+        delete mappedFile;
+        mappedFile = 0;
+        return *this;
+    }
+
+    ~NodeTableEntity() {
+        DataTable<Node<ARITY> >::init(0);
+        delete index;
+        delete mappedFile;
+    }
+
     /**
      * Clears and initializes the table.
      * @param n the number of rows.
      */
     void init(int n) {
         assert(n >= 1);
+        checkNodeId(n - 1, 0);
         DataTable<Node<ARITY> >::init(n);
+        delete mappedFile;
+        mappedFile = 0;
         initTerminals();
     }
 
+    /**
+     * Resizes the table rows.
+     * @param n the number of rows.
+     */
+    void setNumRows(int n) {
+        checkNodeId(n - 1, 0);
+        DataTable<Node<ARITY> >::setNumRows(n);
+    }
+
     /**
      * Initializes the terminal nodes.
      */
@@ -73,6 +147,56 @@ public:
         }
     }
 
+    /**
+     * Makes the rows refer to those of another table without copying.
+     * A shared row is copied when it is accessed for modification,
+     * so that the other table is never modified through this table.
+     * The other table must be neither modified nor destructed while
+     * this table shares its rows.
+     * @param o the source table.
+     */
+    void share(NodeTableEntity const& o) {
+        init(o.numRows());
+        for (int i = 1; i < o.numRows(); ++i) {
+            MyVector<Node<ARITY> > const& row = o[i];
+            DataTable<Node<ARITY> >::operator[](i).attach(
+                    const_cast<Node<ARITY>*>(row.data()), row.size());
+        }
+        copyIndex(o);
+    }
+
+    /**
+     * Checks if any row refers to external storage.
+     * @return true if a shared or mapped row remains.
+     */
+    bool sharing() const {
+        for (int i = 1; i < this->numRows(); ++i) {
+            if ((*this)[i].attached()) return true;
+        }
+        return false;
+    }
+
+    /**
+     * Accesses to a row for modification.
+     * A shared or mapped row is copied into own storage first.
+     * @param i row index.
+     * @return vector of nodes on the row.
+     */
+    MyVector<Node<ARITY> >& operator[](int i) {
+        MyVector<Node<ARITY> >& row = DataTable<Node<ARITY> >::operator[](i);
+        if (row.attached()) row.reserve(row.size());
+        return row;
+    }
+
+    /**
+     * Accesses to a row.
+     * @param i row index.
+     * @return vector of nodes on the row.
+     */
+    MyVector<Node<ARITY> > const& operator[](int i) const {
+        return DataTable<Node<ARITY> >::operator[](i);
+    }
+
 //    /**
 //     * Gets the variable ID at a given level.
 //     * @param level level.
@@ -240,19 +364,74 @@ public:
      * Deletes current index information.
      */
     void deleteIndex() {
-        higherLevelTable.clear();
-        lowerLevelTable.clear();
+        delete index;
+        index = 0;
     }
 
     /**
      * Makes index information.
+     * It must not be called while other threads are using the table.
      * @param useMP use an algorithm for multiple processors.
      */
     void makeIndex(bool useMP = false) const {
+        LevelIndex* p = buildIndex(useMP);
+        delete index;
+        index = p;
+    }
+
+    /**
+     * Returns a collection of the higher levels that directly refers
+     * the given level and that does not refer any lower levels.
+     * @param level the level.
+     */
+    MyVector<int> const& higherLevels(int level) const {
+        return getIndex().higherLevelTable[level];
+    }
+
+    /**
+     * Returns a collection of the lower levels that are referred
+     * by the given level and that are not referred directly by
+     * any higher levels.
+     * @param level the level.
+     */
+    MyVector<int> const& lowerLevels(int level) const {
+        return getIndex().lowerLevelTable[level];
+    }
+
+private:
+    void copyIndex(NodeTableEntity const& o) {
+        LevelIndex* p = o.index ? new LevelIndex(*o.index) : 0;
+        delete index;
+        index = p;
+    }
+
+    /*
+     * Gets the index information, which is made if it does not exist.
+     * When threads call it at the same time, only one of the indices
+     * made by them is published and the others are discarded,
+     * so that the index is safely shared without locks.
+     */
+    LevelIndex const& getIndex() const {
+        LevelIndex* p = atomicLoad(&index);
+        if (p == 0) {
+            LevelIndex* q = buildIndex(false);
+            p = atomicCompareAndSwap(&index, static_cast<LevelIndex*>(0), q);
+            if (p == 0) {
+                p = q;
+            }
+            else {
+                delete q;
+            }
+        }
+        return *p;
+    }
+
+    LevelIndex* buildIndex(bool useMP) const {
         int const n = this->numRows() - 1;
-        higherLevelTable.clear();
+        LevelIndex* p = new LevelIndex;
+        MyVector<MyVector<int> >& higherLevelTable = p->higherLevelTable;
+        MyVector<MyVector<int> >& lowerLevelTable = p->lowerLevelTable;
         higherLevelTable.resize(n + 1);
-        lowerLevelTable.clear();
         lowerLevelTable.resize(n + 1);
         MyVector<bool> lowerMark(n + 1);
 
@@ -300,27 +479,127 @@ public:
                 if (myLower[ii]) lower.push_back(ii);
             }
         }
+
+        return p;
     }
 
+public:
+
     /**
-     * Returns a collection of the higher levels that directly refers
-     * the given level and that does not refer any lower levels.
-     * @param level the level.
+     * Writes the node table in the binary format.
+     * The rows are stored as raw node arrays in the native byte order
+     * and node ID layout, so that the file can be mapped by mapBinary().
+     * @param path file name.
+     * @param root the root node ID.
      */
-    MyVector<int> const& higherLevels(int level) const {
-        if (higherLevelTable.empty()) makeIndex();
-        return higherLevelTable[level];
+    void writeBinary(std::string const& path, NodeId root) const {
+        uint32_t const n = this->numRows();
+        BinaryHeader h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, "TdZddBin", 8);
+        h.version = BINARY_VERSION;
+        h.byteOrder = BINARY_BYTE_ORDER;
+        h.arity = ARITY;
+        h.nodeSize = sizeof(Node<ARITY>);
+        h.rowBits = NODE_ROW_BITS;
+        h.numRows = n;
+        std::memcpy(&h.root, &root, sizeof(root));
+
+        MyVector<uint64_t> dir(n * 2);
+        uint64_t offset = binaryAlign(sizeof(h) + dir.size() * sizeof(uint64_t));
+        for (uint32_t i = 0; i < n; ++i) {
+            uint64_t const m = (i == 0) ? 0 : (*this)[i].size();
+            dir[i * 2] = (m == 0) ? 0 : offset;
+            dir[i * 2 + 1] = m;
+            offset = binaryAlign(offset + m * sizeof(Node<ARITY>));
+        }
+
+        std::FILE* fp = std::fopen(path.c_str(), "wb");
+        if (fp == 0) binaryError("Cannot open", path);
+        char const pad[BINARY_ALIGN] = { };
+        uint64_t pos = sizeof(h) + dir.size() * sizeof(uint64_t);
+        bool ok = std::fwrite(&h, sizeof(h), 1, fp) == 1
+                && std::fwrite(dir.data(), sizeof(uint64_t), dir.size(), fp)
+                        == dir.size();
+
+        for (uint32_t i = 1; ok && i < n; ++i) {
+            uint64_t const m = dir[i * 2 + 1];
+            if (m == 0) continue;
+            size_t const k = dir[i * 2] - pos;
+            ok = std::fwrite(pad, 1, k, fp) == k
+                    && std::fwrite((*this)[i].data(), sizeof(Node<ARITY>), m, fp)
+                            == m;
+            pos = dir[i * 2] + m * sizeof(Node<ARITY>);
+        }
+
+        if (std::fclose(fp) != 0) ok = false;
+        if (!ok) binaryError("Cannot write", path);
     }
 
     /**
-     * Returns a collection of the lower levels that are referred
-     * by the given level and that are not referred directly by
-     * any higher levels.
-     * @param level the level.
+     * Replaces the node table with a file written by writeBinary().
+     * The file is mapped into memory and the rows refer to it directly;
+     * a row is copied only when it is accessed for modification.
+     * The node data are not validated.
+     * @param path file name.
+     * @return the root node ID.
      */
-    MyVector<int> const& lowerLevels(int level) const {
-        if (lowerLevelTable.empty()) makeIndex();
-        return lowerLevelTable[level];
+    NodeId mapBinary(std::string const& path) {
+        MappedFile* file = new MappedFile(path);
+        NodeId root;
+        try {
+            char* const base = file->data();
+            uint64_t const size = file->size();
+            BinaryHeader h;
+            if (size < sizeof(h)) binaryError("Not a", path);
+            std::memcpy(&h, base, sizeof(h));
+            if (std::memcmp(h.magic, "TdZddBin", 8) != 0) binaryError("Not a", path);
+            if (h.version != BINARY_VERSION) binaryError("Unsupported version of", path);
+            if (h.byteOrder != BINARY_BYTE_ORDER) binaryError("Incompatible", path);
+            if (h.nodeSize != sizeof(Node<ARITY>) || h.rowBits != NODE_ROW_BITS) {
+                binaryError("Incompatible", path);
+            }
+            if (h.arity != uint32_t(ARITY)) binaryError("Arity mismatch in", path);
+
+            uint32_t const n = h.numRows;
+            if (n == 0 || (size - sizeof(h)) / (2 * sizeof(uint64_t)) < n) {
+                binaryError("Broken", path);
+            }
+            MyVector<uint64_t> dir(n * 2);
+            std::memcpy(dir.data(), base + sizeof(h), dir.size() * sizeof(uint64_t));
+            for (uint32_t i = 1; i < n; ++i) {
+                uint64_t const offset = dir[i * 2];
+                uint64_t const m = dir[i * 2 + 1];
+                if (m == 0) continue;
+                if (offset % BINARY_ALIGN != 0 || offset > size
+                        || (size - offset) / sizeof(Node<ARITY>) < m
+                        || !nodeIdFits(i, m)) {
+                    binaryError("Broken", path);
+                }
+            }
+
+            root = 0;
+            std::memcpy(static_cast<void*>(&root), &h.root, sizeof(root));
+            if (root.row() >= int(n)
+                    || (root.row() > 0 && root.col() >= dir[root.row() * 2 + 1])
+                    || (root.row() == 0 && root.col() >= 2)) {
+                binaryError("Broken", path);
+            }
+
+            init(n);
+            for (uint32_t i = 1; i < n; ++i) {
+                Node<ARITY>* const row = reinterpret_cast<Node<ARITY>*>(base
+                        + dir[i * 2]);
+                DataTable<Node<ARITY> >::operator[](i).attach(row,
+                        dir[i * 2 + 1]);
+            }
+        }
+        catch (...) {
+            delete file;
+            throw;
+        }
+        mappedFile = file;
+        return root;
     }
 
     /**
@@ -398,28 +677,54 @@ public:
     }
 };
 
+/**
+ * Reference-counted handler of a node table.
+ * Copies of a handler share the table.
+ * When a shared table is going to be modified, the handler makes
+ * a new table whose rows refer to the old ones, and each row is copied
+ * only when it is modified.
+ * The reference count is updated atomically, so that handlers sharing
+ * a table can be copied and destructed by different threads.
+ */
 template<int ARITY>
 class NodeTableHandler {
     struct Object {
         unsigned refCount;
+        Object* base; ///< The object whose rows may be shared.
         NodeTableEntity<ARITY> entity;
 
         Object(int n)
-                : refCount(1), entity(n) {
+                : refCount(1), base(0), entity(n) {
+        }
+
+        Object(Object* base)
+                : refCount(1), base(base) {
+            base->ref();
+            entity.share(base->entity);
         }
 
-        Object(NodeTableEntity<ARITY> const& entity)
-                : refCount(1), entity(entity) {
+        ~Object() {
+            if (base) base->deref();
+        }
+
+        /*
+         * Releases the base object if no row is shared with it any more.
+         */
+        void releaseBase() {
+            if (base && !entity.sharing()) {
+                base->deref();
+                base = 0;
+            }
         }
 
         void ref() {
-            ++refCount;
-            if (refCount == 0) throw std::runtime_error("Too many references");
+            if (atomicAdd(&refCount, 1U) == 0) {
+                throw std::runtime_error("Too many references");
+            }
         }
 
         void deref() {
-            --refCount;
-            if (refCount == 0) delete this;
+            if (atomicAdd(&refCount, ~0U) == 0) delete this;
         }
     };
 
@@ -456,12 +761,17 @@ public:
 
     /**
      * Make the table unshared.
+     * The rows are still shared until they are accessed for modification.
      * @return writable reference to the private table.
      */
     NodeTableEntity<ARITY>& privateEntity() {
         if (pointer->refCount >= 2) {
+            Object* o = new Object(pointer);
             pointer->deref();
-            pointer = new Object(pointer->entity);
+            pointer = o;
+        }
+        else {
+            pointer->releaseBase();
         }
         return pointer->entity;
     }
@@ -474,6 +784,7 @@ public:
     NodeTableEntity<ARITY>& init(int n = 1) {
         if (pointer->refCount == 1) {
             pointer->entity.init(n);
+            pointer->releaseBase();
         }
         else {
             pointer->deref();
@@ -487,7 +798,7 @@ public:
      * @param i row index.
      */
     void derefLevel(int i) {
-        if (pointer->refCount == 1) pointer->entity[i].clear();
+        if (pointer->refCount == 1) pointer->entity.initRow(i, 0);
     }
 };
 
@@ -0,0 +1,453 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <cassert>
+#include <stdint.h>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "DdBuilder.hpp"
+#include "DdSweeper.hpp"
+#include "Node.hpp"
+#include "NodeTable.hpp"
+#include "../util/MemoryPool.hpp"
+#include "../util/MyHashTable.hpp"
+#include "../util/MyList.hpp"
+#include "../util/MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Breadth-first ZDD subset builder for multiple specs.
+ * It refines one input ZDD by several specs of the same type at once.
+ * The input diagram is traversed only once; the zero-suppressed children
+ * of each input level are computed once and shared by all the specs,
+ * and the specs are processed in parallel when OpenMP is enabled.
+ * Each spec has its own pending states and output diagram.
+ */
+template<typename S>
+class ZddMultiSubsetter: DdBuilderBase {
+    typedef S Spec;
+    typedef MyHashTable<SpecNode*,Hasher<Spec>,Hasher<Spec> > UniqTable;
+    static int const AR = Spec::ARITY;
+
+    /*
+     * Construction status for one spec.
+     */
+    struct Filter {
+        Spec spec;
+        int const specNodeSize;
+        NodeTableHandler<AR> diagram;
+        NodeTableEntity<AR>& output;
+        NodeId root;
+        int top;
+        DataTable<MyListOnPool<SpecNode> > work;
+        MemoryPools pools;
+        DdSweeper<AR> sweeper;
+        MyVector<char> oneStorage;
+        void* const one;
+        MyVector<NodeBranchId> oneSrcPtr;
+        int lowestChild;
+        size_t deadCount;
+
+        Filter(Spec const& s, int n) :
+                spec(s),
+                specNodeSize(getSpecNodeSize(spec.datasize())),
+                output(diagram.privateEntity()),
+                root(0),
+                top(0),
+                work(n),
+                sweeper(output, oneSrcPtr),
+                oneStorage(spec.datasize()),
+                one(oneStorage.data()),
+                lowestChild(0),
+                deadCount(0) {
+            sweeper.setRoot(root);
+        }
+
+        ~Filter() {
+            if (!oneSrcPtr.empty()) spec.destruct(one);
+        }
+    };
+
+    NodeTableEntity<AR> const& input;
+    MyVector<Filter*> filters;
+    MyVector<NodeId> downCache;
+    bool useMP;
+
+public:
+    /**
+     * Constructor.
+     * @param input the input diagram.
+     * @param specs the specs.
+     */
+    ZddMultiSubsetter(NodeTableHandler<AR> const& input,
+                      std::vector<Spec> const& specs) :
+            input(*input), filters(specs.size()), useMP(false) {
+        for (size_t k = 0; k < specs.size(); ++k) {
+            filters[k] = new Filter(specs[k], input->numRows());
+        }
+    }
+
+    ~ZddMultiSubsetter() {
+        for (size_t k = 0; k < filters.size(); ++k) {
+            delete filters[k];
+        }
+    }
+
+    /**
+     * Enables or disables processing the specs in parallel.
+     * @param flag true for using multiple threads.
+     * @return old value of the flag.
+     */
+    bool useMultiProcessors(bool flag = true) {
+        bool old = useMP;
+        useMP = flag;
+        return old;
+    }
+
+    /**
+     * Gets the number of the specs.
+     * @return the number of the specs.
+     */
+    size_t numFilters() const {
+        return filters.size();
+    }
+
+    /**
+     * Gets the diagram for a spec.
+     * @param k index of the spec.
+     * @return the output diagram.
+     */
+    NodeTableHandler<AR> const& getDiagram(size_t k) const {
+        return filters[k]->diagram;
+    }
+
+    /**
+     * Gets the root for a spec.
+     * @param k index of the spec.
+     * @return the root node ID.
+     */
+    NodeId getRoot(size_t k) const {
+        return filters[k]->root;
+    }
+
+    /**
+     * Initializes the builder.
+     * @param root the root node of the input diagram.
+     * @return the highest level to be constructed.
+     */
+    int initialize(NodeId root) {
+        int top = 0;
+        for (size_t k = 0; k < filters.size(); ++k) {
+            int n = initialize(*filters[k], root);
+            if (n > top) top = n;
+        }
+        return top;
+    }
+
+    /**
+     * Builds one level of all the output diagrams.
+     * @param i level.
+     */
+    void subset(int i) {
+        bool active = false;
+        for (size_t k = 0; k < filters.size(); ++k) {
+            if (filters[k]->top >= i) active = true;
+        }
+        if (!active) return;
+
+        size_t const m = input[i].size();
+        downCache.resize(m * AR);
+        for (size_t j = 0; j < m; ++j) {
+            for (int b = 0; b < AR; ++b) {
+                NodeId f(i, j);
+                downTable(f, b, i - 1);
+                downCache[j * AR + b] = f;
+            }
+        }
+
+        intmax_t const nf = filters.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (useMP)
+#endif
+        for (intmax_t k = 0; k < nf; ++k) {
+            if (filters[k]->top >= i) subset(*filters[k], i);
+        }
+
+        for (size_t k = 0; k < filters.size(); ++k) {
+            Filter& flt = *filters[k];
+            if (flt.top < i) continue;
+            checkNodeId(i, flt.output[i].size());
+            flt.sweeper.update(i, flt.lowestChild, flt.deadCount);
+        }
+    }
+
+private:
+    int initialize(Filter& flt, NodeId root) {
+        Spec& spec = flt.spec;
+        MyVector<char> tmp(spec.datasize());
+        void* const tmpState = tmp.data();
+        int n = spec.get_root(tmpState);
+
+        int k = (root == 1) ? -1 : root.row();
+
+        while (n != 0 && k != 0 && n != k) {
+            if (n < k) {
+                assert(k >= 1);
+                k = downTable(root, 0, n);
+            }
+            else {
+                assert(n >= 1);
+                n = downSpec(spec, tmpState, n, 0, k);
+            }
+        }
+
+        if (n <= 0 || k <= 0) {
+            assert(n == 0 || k == 0 || (n == -1 && k == -1));
+            flt.root = NodeId(0, n != 0 && k != 0);
+            n = 0;
+        }
+        else {
+            assert(n == k);
+            assert(n == root.row());
+
+            flt.root = root;
+            flt.pools.resize(n + 1);
+            flt.work[n].resize(input[n].size());
+
+            SpecNode* p0 = flt.work[n][root.col()].alloc_front(flt.pools[n],
+                    flt.specNodeSize);
+            spec.get_copy(state(p0), tmpState);
+            srcPtr(p0) = &flt.root;
+        }
+
+        spec.destruct(tmpState);
+        flt.output.init(n + 1);
+        flt.top = n;
+        return n;
+    }
+
+    void subset(Filter& flt, int i) {
+        Spec& spec = flt.spec;
+        NodeTableEntity<AR>& output = flt.output;
+        DataTable<MyListOnPool<SpecNode> >& work = flt.work;
+
+        Hasher<Spec> const hasher(spec, i);
+        MyVector<char> tmp(spec.datasize());
+        void* const tmpState = tmp.data();
+        size_t const m = input[i].size();
+        size_t mm = 0;
+        int lowestChild = i - 1;
+        size_t deadCount = 0;
+
+        if (work[i].empty()) work[i].resize(m);
+        assert(work[i].size() == m);
+
+        for (size_t j = 0; j < m; ++j) {
+            MyListOnPool<SpecNode> &list = work[i][j];
+            size_t n = list.size();
+
+            if (n >= 2) {
+                UniqTable uniq(n * 2, hasher, hasher);
+
+                for (MyListOnPool<SpecNode>::iterator t = list.begin();
+                        t != list.end(); ++t) {
+                    SpecNode* p = *t;
+                    SpecNode*& p0 = uniq.add(p);
+
+                    if (p0 == p) {
+                        nodeId(p) = *srcPtr(p) = NodeId(i, mm++);
+                    }
+                    else {
+                        switch (spec.merge_states(state(p0), state(p))) {
+                        case 1:
+                            nodeId(p0) = 0; // forward to 0-terminal
+                            nodeId(p) = *srcPtr(p) = NodeId(i, mm++);
+                            p0 = p;
+                            break;
+                        case 2:
+                            *srcPtr(p) = 0;
+                            nodeId(p) = 1; // unused
+                            break;
+                        default:
+                            *srcPtr(p) = nodeId(p0);
+                            nodeId(p) = 1; // unused
+                            break;
+                        }
+                    }
+                }
+            }
+            else if (n == 1) {
+                SpecNode* p = list.front();
+                nodeId(p) = *srcPtr(p) = NodeId(i, mm++);
+            }
+        }
+
+        output.initRow(i, mm);
+        Node<AR>* const outi = output[i].data();
+        size_t jj = 0;
+
+        for (size_t j = 0; j < m; ++j) {
+            MyListOnPool<SpecNode> &list = work[i][j];
+
+            for (MyListOnPool<SpecNode>::iterator t = list.begin();
+                    t != list.end(); ++t) {
+                SpecNode* p = *t;
+                Node<AR>& q = outi[jj];
+
+                if (nodeId(p) == 1) {
+                    spec.destruct(state(p));
+                    continue;
+                }
+
+                bool allZero = true;
+
+                for (int b = 0; b < AR; ++b) {
+                    if (nodeId(p) == 0) {
+                        q.branch[b] = 0;
+                        continue;
+                    }
+
+                    NodeId f = downCache[j * AR + b];
+                    int kk = (f == 1) ? -1 : f.row();
+                    spec.get_copy(tmpState, state(p));
+                    int ii = downSpec(spec, tmpState, i, b, kk);
+
+                    while (ii != 0 && kk != 0 && ii != kk) {
+                        if (ii < kk) {
+                            assert(kk >= 1);
+                            kk = downTable(f, 0, ii);
+                        }
+                        else {
+                            assert(ii >= 1);
+                            ii = downSpec(spec, tmpState, ii, 0, kk);
+                        }
+                    }
+
+                    if (ii <= 0 || kk <= 0) {
+                        if (ii == 0 || kk == 0) {
+                            q.branch[b] = 0;
+                        }
+                        else {
+                            mergeOne(flt, tmpState, i, jj, b);
+                            allZero = false;
+                        }
+                    }
+                    else {
+                        assert(ii == f.row() && ii == kk && ii < i);
+                        if (work[ii].empty()) work[ii].resize(input[ii].size());
+                        SpecNode* pp = work[ii][f.col()].alloc_front(
+                                flt.pools[ii], flt.specNodeSize);
+                        spec.get_copy(state(pp), tmpState);
+                        srcPtr(pp) = &q.branch[b];
+                        if (ii < lowestChild) lowestChild = ii;
+                        allZero = false;
+                    }
+
+                    spec.destruct(tmpState);
+                }
+
+                spec.destruct(state(p));
+                ++jj;
+                if (allZero) ++deadCount;
+            }
+        }
+
+        work[i].clear();
+        flt.pools[i].clear();
+        spec.destructLevel(i);
+        flt.lowestChild = lowestChild;
+        flt.deadCount = deadCount;
+    }
+
+    /*
+     * Makes branch b of node (i, jj) point to the 1-terminal with state s,
+     * merging it with the other 1-terminal candidates.
+     */
+    static void mergeOne(Filter& flt, void* s, int i, size_t jj, int b) {
+        Spec& spec = flt.spec;
+        NodeId& f = flt.output[i][jj].branch[b];
+        MyVector<NodeBranchId>& oneSrcPtr = flt.oneSrcPtr;
+
+        if (oneSrcPtr.empty()) { // the first 1-terminal candidate
+            spec.get_copy(flt.one, s);
+            f = 1;
+            oneSrcPtr.push_back(NodeBranchId(i, jj, b));
+            return;
+        }
+
+        switch (spec.merge_states(flt.one, s)) {
+        case 1:
+            while (!oneSrcPtr.empty()) {
+                NodeBranchId const& nbi = oneSrcPtr.back();
+                assert(nbi.row >= i);
+                flt.output[nbi.row][nbi.col].branch[nbi.val] = 0;
+                oneSrcPtr.pop_back();
+            }
+            spec.destruct(flt.one);
+            spec.get_copy(flt.one, s);
+            f = 1;
+            oneSrcPtr.push_back(NodeBranchId(i, jj, b));
+            break;
+        case 2:
+            f = 0;
+            break;
+        default:
+            f = 1;
+            oneSrcPtr.push_back(NodeBranchId(i, jj, b));
+            break;
+        }
+    }
+
+    int downTable(NodeId& f, int b, int zerosupLevel) const {
+        if (zerosupLevel < 0) zerosupLevel = 0;
+
+        f = input.child(f, b);
+        while (f.row() > zerosupLevel) {
+            f = input.child(f, 0);
+        }
+        return (f == 1) ? -1 : f.row();
+    }
+
+    static int downSpec(Spec& spec, void* p, int level, int b,
+                        int zerosupLevel) {
+        if (zerosupLevel < 0) zerosupLevel = 0;
+        assert(level > zerosupLevel);
+
+        int i = spec.get_child(p, level, b);
+        while (i > zerosupLevel) {
+            i = spec.get_child(p, i, 0);
+        }
+        return i;
+    }
+};
+
+} // namespace tdzdd
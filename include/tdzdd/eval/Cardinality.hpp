@@ -73,6 +73,50 @@ public:
         }
     }
 
+    void evalBlock(T* v, int i, DdBlockValues<T,ARITY> const& values) const {
+        size_t const m = values.size();
+        for (size_t k = 0; k < m; ++k) {
+            v[k] = 0;
+        }
+
+        for (int b = 0; b < ARITY; ++b) {
+            NodeId const* f = values.getBranches(b);
+            T const* row = values.getRow(b);
+
+            if (row) {
+                T factor = 1;
+                if (BDD) {
+                    for (int ii = values.getCommonLevel(b) + 1; ii < i; ++ii) {
+                        factor *= ARITY;
+                    }
+                }
+
+                if (factor == 1) {
+                    for (size_t k = 0; k < m; ++k) {
+                        v[k] += row[f[k].col()];
+                    }
+                }
+                else {
+                    for (size_t k = 0; k < m; ++k) {
+                        v[k] += row[f[k].col()] * factor;
+                    }
+                }
+            }
+            else {
+                for (size_t k = 0; k < m; ++k) {
+                    T tmp = values.get(b, k);
+                    if (BDD) {
+                        int ii = values.getLevel(b, k);
+                        while (++ii < i) {
+                            tmp *= ARITY;
+                        }
+                    }
+                    v[k] += tmp;
+                }
+            }
+        }
+    }
+
     T getValue(T const& n) {
         if (BDD) {
             T tmp = n;
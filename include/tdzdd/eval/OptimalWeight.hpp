@@ -0,0 +1,96 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <limits>
+#include <vector>
+
+#include "../DdEval.hpp"
+
+namespace tdzdd {
+
+template<typename E, typename T, bool MAX>
+class OptimalWeightBase: public DdEval<E,T> {
+    std::vector<T> weight;
+
+public:
+    template<typename U>
+    OptimalWeightBase(std::vector<U> const& weight) :
+            weight(weight.begin(), weight.end()) {
+    }
+
+    /**
+     * Gets the value for the empty family.
+     * @return the value that is worse than any other.
+     */
+    static T infeasible() {
+        return MAX ? -std::numeric_limits<T>::max()
+                : std::numeric_limits<T>::max();
+    }
+
+    void evalTerminal(T& v, int id) const {
+        v = id ? T(0) : infeasible();
+    }
+
+    void evalNode(T& v, int i, DdValues<T,2> const& values) const {
+        v = values.get(0);
+        if (values.get(1) == infeasible()) return;
+        T const v1 = values.get(1) + weight[i];
+        if (v == infeasible() || (MAX ? v < v1 : v1 < v)) v = v1;
+    }
+};
+
+/**
+ * ZDD evaluator that finds the maximum total weight of the items in a set.
+ * The weight of the item at level i is given by the i-th element of the
+ * vector.
+ * It gives infeasible() for the empty family.
+ * @tparam T data type of weights.
+ */
+template<typename T = long long>
+struct ZddMaxWeight: public OptimalWeightBase<ZddMaxWeight<T>,T,true> {
+    template<typename U>
+    ZddMaxWeight(std::vector<U> const& weight) :
+            OptimalWeightBase<ZddMaxWeight<T>,T,true>(weight) {
+    }
+};
+
+/**
+ * ZDD evaluator that finds the minimum total weight of the items in a set.
+ * The weight of the item at level i is given by the i-th element of the
+ * vector.
+ * It gives infeasible() for the empty family.
+ * @tparam T data type of weights.
+ */
+template<typename T = long long>
+struct ZddMinWeight: public OptimalWeightBase<ZddMinWeight<T>,T,false> {
+    template<typename U>
+    ZddMinWeight(std::vector<U> const& weight) :
+            OptimalWeightBase<ZddMinWeight<T>,T,false>(weight) {
+    }
+};
+
+} // namespace tdzdd
@@ -0,0 +1,122 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#if defined(_MSC_VER) && !defined(__GNUC__)
+#include <intrin.h>
+#endif
+
+namespace tdzdd {
+
+/*
+ * Minimal atomic operations for C++98 compilers.
+ * GCC-compatible compilers use the __sync builtins and MSVC uses the
+ * Interlocked intrinsics; other compilers fall back on an OpenMP
+ * critical section, which is correct but slow.
+ */
+
+/**
+ * Compares and swaps a pointer atomically.
+ * It is a full memory barrier, so that the returned value can be
+ * dereferenced as if it were read by atomicLoad().
+ * @param p pointer to the target variable.
+ * @param oldVal expected value.
+ * @param newVal new value.
+ * @return the value of the variable before the operation;
+ *         the swap succeeded if and only if it is equal to @p oldVal.
+ */
+template<typename T>
+inline T* atomicCompareAndSwap(T* volatile* p, T* oldVal, T* newVal) {
+#if defined(__GNUC__)
+    return __sync_val_compare_and_swap(p, oldVal, newVal);
+#elif defined(_MSC_VER)
+    return static_cast<T*>(_InterlockedCompareExchangePointer(
+            reinterpret_cast<void* volatile*>(p), newVal, oldVal));
+#else
+    T* val;
+#ifdef _OPENMP
+#pragma omp critical(tdzdd_atomic)
+#endif
+    {
+        val = *p;
+        if (val == oldVal) *p = newVal;
+    }
+    return val;
+#endif
+}
+
+/**
+ * Reads a pointer with acquire ordering,
+ * so that the object published by atomicCompareAndSwap() is visible.
+ * It does not write to the variable, so that many threads can read it
+ * without contention.
+ * @param p pointer to the target variable.
+ * @return the value of the variable.
+ */
+template<typename T>
+inline T* atomicLoad(T* volatile* p) {
+#if defined(__ATOMIC_ACQUIRE)
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined(__GNUC__)
+    T* val = *p;
+    __sync_synchronize();
+    return val;
+#elif defined(_MSC_VER)
+    T* val = *p; // volatile reads have acquire semantics
+    _ReadWriteBarrier();
+    return val;
+#else
+    T* val;
+#ifdef _OPENMP
+#pragma omp critical(tdzdd_atomic)
+#endif
+    val = *p;
+    return val;
+#endif
+}
+
+/**
+ * Adds a value to a variable atomically.
+ * @param p pointer to the target variable.
+ * @param val value to be added.
+ * @return the new value of the variable.
+ */
+template<typename T>
+inline T atomicAdd(T volatile* p, T val) {
+#if defined(__GNUC__)
+    return __sync_add_and_fetch(p, val);
+#else
+    T ret;
+#ifdef _OPENMP
+#pragma omp critical(tdzdd_atomic)
+#endif
+    ret = (*p += val);
+    return ret;
+#endif
+}
+
+} // namespace tdzdd
@@ -0,0 +1,202 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "Atomic.hpp"
+#include "MyHashTable.hpp"
+#include "MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Concurrent hash table of non-null pointers with open addressing.
+ * Elements are inserted by compare-and-swap, so that any number of threads
+ * can call add() at the same time without locks.
+ * Elements are never deleted individually; the capacity is fixed by
+ * initialize(), which must be given an upper bound of the number of
+ * elements.
+ * The hash function and the equality are given to each add() call
+ * so that every thread can use its own functor objects.
+ * Rare updates of existing slots are serialized by striped slot locks;
+ * they must not overlap add() calls, whose equality tests read the elements
+ * without locks.
+ * @tparam T element type, which must be a pointer type.
+ */
+template<typename T>
+class ConcurrentHashTable: MyHashConstant {
+    typedef T volatile Slot;
+    static size_t const LOCKS = 1024;
+
+    size_t tableSize_;
+    MyVector<T> table;
+#ifdef _OPENMP
+    omp_lock_t locks[LOCKS];
+#endif
+
+    ConcurrentHashTable(ConcurrentHashTable const&);
+    ConcurrentHashTable& operator=(ConcurrentHashTable const&);
+
+public:
+    ConcurrentHashTable()
+            : tableSize_(0) {
+#ifdef _OPENMP
+        for (size_t k = 0; k < LOCKS; ++k) {
+            omp_init_lock(&locks[k]);
+        }
+#endif
+    }
+
+    ~ConcurrentHashTable() {
+#ifdef _OPENMP
+        for (size_t k = 0; k < LOCKS; ++k) {
+            omp_destroy_lock(&locks[k]);
+        }
+#endif
+    }
+
+    /**
+     * Gets the table size.
+     * @return the number of slots.
+     */
+    size_t tableSize() const {
+        return tableSize_;
+    }
+
+    /**
+     * Prepares an empty table.
+     * This function must not be called concurrently with the others.
+     * Slots must have been cleared by clear() after the last use
+     * unless the table is extended.
+     * @param n upper bound of the number of elements.
+     */
+    void initialize(size_t n) {
+        size_t const size = primeSize(n * 100 / MAX_FILL + 1);
+        if (table.size() < size) {
+            table.clear();
+            table.resize(size); // filled with null pointers
+        }
+        tableSize_ = size;
+    }
+
+    /**
+     * Inserts an element unless an equivalent one already exists.
+     * @param elem the element.
+     * @param hash hash function object.
+     * @param eq equality function object.
+     * @param slot the slot index of the element in the table is stored.
+     * @return @p elem if it is inserted, or the equivalent element found.
+     */
+    template<typename Hash, typename Equal>
+    T add(T elem, Hash const& hash, Equal const& eq, size_t& slot) {
+        assert(elem != 0);
+        assert(tableSize_ > 0);
+        Slot* const t = table.data();
+        size_t i = hash(elem) % tableSize_;
+
+        // Both reads of a slot are acquire-ordered, so that the element
+        // published by another thread is complete when it is compared.
+        for (;;) {
+            T p = atomicLoad(&t[i]);
+
+            if (p == 0) {
+                p = atomicCompareAndSwap(&t[i], T(0), elem);
+                if (p == 0) {
+                    slot = i;
+                    return elem;
+                }
+            }
+
+            if (eq(p, elem)) {
+                slot = i;
+                return p;
+            }
+
+            if (++i >= tableSize_) i = 0;
+        }
+    }
+
+    /**
+     * Reads a slot.
+     * @param i slot index.
+     * @return the element at the slot or null.
+     */
+    T get(size_t i) const {
+        assert(i < tableSize_);
+        return const_cast<Slot*>(table.data())[i];
+    }
+
+    /**
+     * Acquires the lock of a slot.
+     * @param i slot index.
+     */
+    void lock(size_t i) {
+#ifdef _OPENMP
+        omp_set_lock(&locks[i % LOCKS]);
+#endif
+    }
+
+    /**
+     * Releases the lock of a slot.
+     * @param i slot index.
+     */
+    void unlock(size_t i) {
+#ifdef _OPENMP
+        omp_unset_lock(&locks[i % LOCKS]);
+#endif
+    }
+
+    /**
+     * Overwrites a non-empty slot with an equivalent element.
+     * The caller must hold the lock of the slot, and no thread may be
+     * in add() at the same time.
+     * @param i slot index.
+     * @param elem the new element.
+     */
+    void replace(size_t i, T elem) {
+        assert(i < tableSize_);
+        assert(elem != 0 && get(i) != 0);
+        table.data()[i] = elem;
+    }
+
+    /**
+     * Clears a range of slots.
+     * This function can be called by multiple threads for disjoint ranges.
+     * @param begin the first slot index.
+     * @param end the slot index next to the last one.
+     */
+    void clear(size_t begin, size_t end) {
+        std::fill(table.data() + begin,
+                table.data() + std::min(end, tableSize_), T(0));
+    }
+};
+
+} // namespace tdzdd
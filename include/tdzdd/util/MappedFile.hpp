@@ -0,0 +1,132 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tdzdd {
+
+/**
+ * Private memory image of a file.
+ * The file is mapped by mmap so that the pages are loaded on demand and
+ * shared with the page cache.
+ * The image is writable, but the changes are not written back to the
+ * file; a modified page is copied by the operating system.
+ * The whole file is read into memory on platforms without mmap.
+ */
+class MappedFile {
+    std::string path;
+    void* addr;
+    size_t size_;
+
+    MappedFile(MappedFile const&);
+    MappedFile& operator=(MappedFile const&);
+
+    void error(char const* what) const {
+        throw std::runtime_error(std::string(what) + " file: " + path);
+    }
+
+public:
+    /**
+     * Maps a file.
+     * @param path file name.
+     */
+    explicit MappedFile(std::string const& path)
+            : path(path), addr(0), size_(0) {
+#ifdef _WIN32
+        std::FILE* fp = std::fopen(path.c_str(), "rb");
+        if (fp == 0) error("Cannot open");
+        std::fseek(fp, 0, SEEK_END);
+        long n = std::ftell(fp);
+        std::fseek(fp, 0, SEEK_SET);
+        if (n > 0) {
+            size_ = n;
+            addr = std::malloc(size_);
+            if (addr == 0 || std::fread(addr, 1, size_, fp) != size_) {
+                std::free(addr);
+                std::fclose(fp);
+                addr = 0;
+                error("Cannot read");
+            }
+        }
+        std::fclose(fp);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) error("Cannot open");
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            error("Cannot stat");
+        }
+        size_ = st.st_size;
+        if (size_ > 0) {
+            addr = ::mmap(0, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                addr = 0;
+                ::close(fd);
+                error("Cannot map");
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+        if (addr == 0) return;
+#ifdef _WIN32
+        std::free(addr);
+#else
+        ::munmap(addr, size_);
+#endif
+    }
+
+    /**
+     * Gets the start address of the image.
+     * @return pointer to the first byte.
+     */
+    char* data() const {
+        return static_cast<char*>(addr);
+    }
+
+    /**
+     * Gets the size of the image.
+     * @return the number of bytes.
+     */
+    size_t size() const {
+        return size_;
+    }
+};
+
+} // namespace tdzdd
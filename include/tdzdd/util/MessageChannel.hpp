@@ -0,0 +1,381 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef __unix__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#endif
+
+#include "MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * Byte buffer of a message.
+ * Data are appended by put() and read sequentially by get().
+ * Values are stored in the native byte order.
+ */
+class MessageBuffer {
+    MyVector<char> data_;
+    size_t size_;
+    size_t pos;
+
+    void reserve(size_t n) {
+        if (n > data_.size()) data_.resize(std::max(n, data_.size() * 2));
+    }
+
+public:
+    MessageBuffer() :
+            size_(0), pos(0) {
+    }
+
+    /**
+     * Clears the data.
+     * The storage is kept for reuse.
+     */
+    void clear() {
+        size_ = 0;
+        pos = 0;
+    }
+
+    /**
+     * Checks if all data have been read.
+     * @return true if no data remain.
+     */
+    bool atEnd() const {
+        return pos >= size_;
+    }
+
+    /**
+     * Gets the size of the data.
+     * @return the size in bytes.
+     */
+    size_t size() const {
+        return size_;
+    }
+
+    char* data() {
+        return data_.data();
+    }
+
+    char const* data() const {
+        return data_.data();
+    }
+
+    /**
+     * Resizes the data and rewinds the read position.
+     * @param n new size in bytes.
+     */
+    void resize(size_t n) {
+        reserve(n);
+        size_ = n;
+        pos = 0;
+    }
+
+    /**
+     * Appends raw bytes.
+     * @param p pointer to the data.
+     * @param n the size in bytes.
+     */
+    void write(void const* p, size_t n) {
+        reserve(size_ + n);
+        if (n > 0) std::memcpy(data_.data() + size_, p, n);
+        size_ += n;
+    }
+
+    /**
+     * Reads raw bytes.
+     * @param p pointer to the storage.
+     * @param n the size in bytes.
+     */
+    void read(void* p, size_t n) {
+        if (pos + n > size_) {
+            throw std::runtime_error("MessageBuffer: truncated message");
+        }
+        if (n > 0) std::memcpy(p, data_.data() + pos, n);
+        pos += n;
+    }
+
+    template<typename T>
+    void put(T const& v) {
+        write(&v, sizeof(v));
+    }
+
+    template<typename T>
+    T get() {
+        T v;
+        read(&v, sizeof(v));
+        return v;
+    }
+};
+
+/**
+ * Bidirectional channel of messages over a stream socket.
+ * Each message is sent as its length followed by its contents, so that the
+ * same protocol works on Unix domain sockets between local processes and on
+ * TCP connections between hosts.
+ */
+class MessageChannel {
+    int fd_;
+
+public:
+    /**
+     * Constructor.
+     * @param fd file descriptor of a connected stream socket; -1 for none.
+     */
+    explicit MessageChannel(int fd = -1) :
+            fd_(fd) {
+    }
+
+    /**
+     * Gets the file descriptor.
+     * @return the file descriptor; -1 if closed.
+     */
+    int fd() const {
+        return fd_;
+    }
+
+    /**
+     * Closes the channel.
+     */
+    void close() {
+#ifdef __unix__
+        if (fd_ >= 0) ::close(fd_);
+#endif
+        fd_ = -1;
+    }
+
+    /**
+     * Sends a message, waiting until it is completely written.
+     * @param msg the message.
+     */
+    void send(MessageBuffer const& msg) {
+        size_t n = msg.size();
+        writeAll(&n, sizeof(n));
+        writeAll(msg.data(), n);
+    }
+
+    /**
+     * Receives a message, waiting until it arrives.
+     * @param msg storage for the message.
+     * @return false if the peer has closed the channel.
+     */
+    bool receive(MessageBuffer& msg) {
+        size_t n;
+        if (!readAll(&n, sizeof(n))) return false;
+        msg.resize(n);
+        if (!readAll(msg.data(), n)) {
+            throw std::runtime_error("MessageChannel: connection lost");
+        }
+        return true;
+    }
+
+    /**
+     * Sends a message to each peer and receives one from each peer
+     * at the same time.
+     * Since a peer does the same, sending all before receiving
+     * could deadlock when socket buffers are full.
+     * Channels that are closed are skipped.
+     * @param peers the channels.
+     * @param out the messages to send, indexed as peers.
+     * @param in storage for the received messages, indexed as peers.
+     */
+    static void exchange(MyVector<MessageChannel>& peers,
+                         MyVector<MessageBuffer> const& out,
+                         MyVector<MessageBuffer>& in) {
+#ifdef __unix__
+        size_t const n = peers.size();
+        size_t const h = sizeof(size_t);
+        MyVector<size_t> txHead(n), txDone(n), rxHead(n), rxDone(n);
+        MyVector<pollfd> fds;
+        MyVector<size_t> idx;
+        in.resize(n);
+
+        for (size_t k = 0; k < n; ++k) {
+            bool const open = peers[k].fd() >= 0;
+            txHead[k] = out[k].size();
+            txDone[k] = open ? 0 : h + txHead[k];
+            rxDone[k] = open ? 0 : ~size_t(0);
+            in[k].clear();
+        }
+
+        for (;;) {
+            fds.clear();
+            idx.clear();
+            for (size_t k = 0; k < n; ++k) {
+                short ev = 0;
+                if (txDone[k] < h + txHead[k]) ev |= POLLOUT;
+                if (rxDone[k] != ~size_t(0)) ev |= POLLIN;
+                if (ev == 0) continue;
+                pollfd pfd;
+                pfd.fd = peers[k].fd();
+                pfd.events = ev;
+                pfd.revents = 0;
+                fds.push_back(pfd);
+                idx.push_back(k);
+            }
+            if (fds.empty()) break;
+
+            if (::poll(fds.data(), fds.size(), -1) < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(
+                        std::string("MessageChannel: ") + std::strerror(errno));
+            }
+
+            for (size_t t = 0; t < fds.size(); ++t) {
+                size_t const k = idx[t];
+                short const rev = fds[t].revents;
+                if (rev & POLLOUT) {
+                    sendPart(fds[t].fd, txHead[k], out[k], txDone[k]);
+                }
+                if ((fds[t].events & POLLIN)
+                        && (rev & (POLLIN | POLLHUP | POLLERR))) {
+                    receivePart(fds[t].fd, rxHead[k], in[k], rxDone[k]);
+                }
+            }
+        }
+#else
+        throw std::runtime_error("MessageChannel: not supported");
+#endif
+    }
+
+private:
+    void writeAll(void const* p, size_t n) {
+#ifdef __unix__
+        char const* s = static_cast<char const*>(p);
+        while (n > 0) {
+            ssize_t k = ::write(fd_, s, n);
+            if (k < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(
+                        std::string("MessageChannel: ") + std::strerror(errno));
+            }
+            s += k;
+            n -= k;
+        }
+#else
+        throw std::runtime_error("MessageChannel: not supported");
+#endif
+    }
+
+    bool readAll(void* p, size_t n) {
+#ifdef __unix__
+        char* s = static_cast<char*>(p);
+        size_t const n0 = n;
+        while (n > 0) {
+            ssize_t k = ::read(fd_, s, n);
+            if (k < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(
+                        std::string("MessageChannel: ") + std::strerror(errno));
+            }
+            if (k == 0) {
+                if (n == n0) return false;
+                throw std::runtime_error("MessageChannel: connection lost");
+            }
+            s += k;
+            n -= k;
+        }
+        return true;
+#else
+        throw std::runtime_error("MessageChannel: not supported");
+#endif
+    }
+
+#ifdef __unix__
+    /*
+     * Writes as much of the length header and the message as possible
+     * without blocking.
+     */
+    static void sendPart(int fd, size_t const& head, MessageBuffer const& msg,
+                         size_t& done) {
+        size_t const h = sizeof(size_t);
+        char const* p;
+        size_t n;
+        if (done < h) {
+            p = reinterpret_cast<char const*>(&head) + done;
+            n = h - done;
+        }
+        else {
+            p = msg.data() + (done - h);
+            n = msg.size() - (done - h);
+        }
+        ssize_t k = ::send(fd, p, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return;
+            }
+            throw std::runtime_error(
+                    std::string("MessageChannel: ") + std::strerror(errno));
+        }
+        done += k;
+    }
+
+    /*
+     * Reads as much of the length header and the message as available
+     * without blocking; done becomes ~0 when the message is complete.
+     */
+    static void receivePart(int fd, size_t& head, MessageBuffer& msg,
+                            size_t& done) {
+        size_t const h = sizeof(size_t);
+        char* p;
+        size_t n;
+        if (done < h) {
+            p = reinterpret_cast<char*>(&head) + done;
+            n = h - done;
+        }
+        else {
+            p = msg.data() + (done - h);
+            n = msg.size() - (done - h);
+        }
+        ssize_t k = (n > 0) ? ::recv(fd, p, n, MSG_DONTWAIT) : 0;
+        if (k < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return;
+            }
+            throw std::runtime_error(
+                    std::string("MessageChannel: ") + std::strerror(errno));
+        }
+        if (k == 0 && n > 0) {
+            throw std::runtime_error("MessageChannel: connection lost");
+        }
+        done += k;
+        if (done == h) msg.resize(head);
+        if (done >= h && done == h + msg.size()) done = ~size_t(0);
+    }
+#endif
+};
+
+} // namespace tdzdd
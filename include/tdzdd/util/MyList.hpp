@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
@@ -133,6 +134,15 @@ public:
         size_ = 0;
     }
 
+    /**
+     * Exchanges the contents with another list.
+     * @param o the other list.
+     */
+    void swap(MyList& o) {
+        std::swap(front_, o.front_);
+        std::swap(size_, o.size_);
+    }
+
     /**
      * Accesses the first element.
      * @return pointer to the first element.
@@ -63,8 +63,10 @@ public:
     }
 
     MyVector(Size n)
-            : capacity_(0), size_(0), array_(0) {
-        resize(n);
+            : capacity_(n), size_(n), array_(n ? allocate(n) : 0) {
+        for (Size i = 0; i < n; ++i) {
+            new (array_ + i) T();
+        }
     }
 
     MyVector(Size n, T const& val)
@@ -200,17 +202,36 @@ public:
         if (capacity_ < capacity) {
             T* tmp = allocate(capacity);
             if (array_ != 0) {
-                assert(0 <= size_ && size_ <= capacity_);
+                assert(0 <= size_ && (size_ <= capacity_ || capacity_ == 0));
                 for (Size i = 0; i < size_; ++i) {
                     moveElement(array_[i], tmp[i]);
                 }
-                deallocate(array_, capacity_);
+                if (capacity_ > 0) deallocate(array_, capacity_);
             }
             array_ = tmp;
             capacity_ = capacity;
         }
     }
 
+    /**
+     * Reduces the capacity to the number of elements.
+     * Data is moved unless the capacity is already the same.
+     */
+    void shrink_to_fit() {
+        if (size_ == 0) {
+            clear();
+        }
+        else if (size_ < capacity_) {
+            T* tmp = allocate(size_);
+            for (Size i = 0; i < size_; ++i) {
+                moveElement(array_[i], tmp[i]);
+            }
+            deallocate(array_, capacity_);
+            array_ = tmp;
+            capacity_ = size_;
+        }
+    }
+
     /**
      * Initializes the array.
      * @param n new size.
@@ -256,7 +277,7 @@ public:
                 new (tmp + size_++) T();
             }
 
-            deallocate(array_, capacity_);
+            if (capacity_ > 0) deallocate(array_, capacity_);
             array_ = tmp;
             capacity_ = n;
         }
@@ -288,17 +309,41 @@ public:
      * The memory is deallocated.
      */
     void clear() {
-        if (array_ != 0) {
-            assert(capacity_ > 0);
+        if (array_ != 0 && capacity_ > 0) {
             while (size_ > 0) {
                 array_[--size_].~T();
             }
             deallocate(array_, capacity_);
-            array_ = 0;
         }
+        array_ = 0;
+        size_ = 0;
         capacity_ = 0;
     }
 
+    /**
+     * Uses external storage as the array without copying.
+     * The storage is not owned; it is neither destructed nor deallocated,
+     * and it is replaced by an own copy when the array is extended or
+     * shrunk.
+     * Elements must be trivially copyable.
+     * @param array start address of the storage.
+     * @param n the number of elements.
+     */
+    void attach(T* array, Size n) {
+        clear();
+        if (n == 0) return;
+        array_ = array;
+        size_ = n;
+    }
+
+    /**
+     * Checks if the array is on external storage.
+     * @return true if attach() is in effect.
+     */
+    bool attached() const {
+        return array_ != 0 && capacity_ == 0;
+    }
+
     /**
      * Adds an element to the end of the array.
      * The array is automatically extended,
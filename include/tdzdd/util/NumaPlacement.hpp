@@ -0,0 +1,242 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "MyVector.hpp"
+
+namespace tdzdd {
+
+/**
+ * NUMA-aware placement for the parallel algorithms.
+ * When it is enabled, each worker thread is bound to the CPUs of a NUMA
+ * node, the threads being divided into contiguous blocks of nodes, so that
+ * the per-thread pools and lists are allocated on the local node by the
+ * first-touch policy of the kernel.
+ * Large node rows shared by all threads are interleaved over the nodes.
+ * It uses the Linux system interface directly and does nothing on other
+ * platforms or on single-node hosts.
+ */
+template<int N = 0>
+class NumaPlacement_ {
+    static int const MPOL_INTERLEAVE_ = 3;
+    static size_t const INTERLEAVE_MIN = size_t(1) << 20;
+
+    static bool enabled_;
+
+    MyVector<int> nodeIds;
+    MyVector<MyVector<int> > nodeCpus;
+    MyVector<int> cpuNode;
+
+    NumaPlacement_() {
+#ifdef __linux__
+        MyVector<int> nodes;
+        if (!readList("/sys/devices/system/node/online", nodes)) return;
+
+        for (size_t k = 0; k < nodes.size(); ++k) {
+            char path[64];
+            std::sprintf(path, "/sys/devices/system/node/node%d/cpulist",
+                    nodes[k]);
+            MyVector<int> cpus;
+            if (!readList(path, cpus) || cpus.empty()) continue;
+            nodeIds.push_back(nodes[k]);
+            nodeCpus.push_back(cpus);
+
+            for (size_t t = 0; t < cpus.size(); ++t) {
+                while (cpuNode.size() <= size_t(cpus[t])) {
+                    cpuNode.push_back(-1);
+                }
+                cpuNode[cpus[t]] = nodes[k];
+            }
+        }
+#endif
+    }
+
+    static NumaPlacement_& instance() {
+        static NumaPlacement_ obj;
+        return obj;
+    }
+
+    static int nodeIndex(int y, int threads) {
+        return int((long long) y * numNodes() / (threads >= 1 ? threads : 1));
+    }
+
+    /*
+     * Reads a list like "0-3,8,10-11" from a file.
+     */
+    static bool readList(char const* path, MyVector<int>& list) {
+        std::FILE* fp = std::fopen(path, "r");
+        if (fp == 0) return false;
+        int a, b;
+        char c;
+        while (std::fscanf(fp, "%d", &a) == 1) {
+            b = a;
+            if ((c = std::fgetc(fp)) == '-') {
+                if (std::fscanf(fp, "%d", &b) != 1) break;
+                c = std::fgetc(fp);
+            }
+            for (int k = a; k <= b; ++k) {
+                list.push_back(k);
+            }
+            if (c != ',') break;
+        }
+        std::fclose(fp);
+        return true;
+    }
+
+public:
+    /**
+     * Enables or disables the NUMA-aware placement.
+     * Threads that are already bound remain bound.
+     * @param flag true for enabling.
+     * @return old value of the flag.
+     */
+    static bool enable(bool flag = true) {
+        bool prev = enabled_;
+        enabled_ = flag;
+        return prev;
+    }
+
+    /**
+     * Checks if the NUMA-aware placement is in effect.
+     * @return true if it is enabled and the host has multiple nodes.
+     */
+    static bool active() {
+        return enabled_ && numNodes() >= 2;
+    }
+
+    /**
+     * Gets the number of NUMA nodes with CPUs.
+     * @return the number of nodes; 1 if unknown.
+     */
+    static int numNodes() {
+        int n = instance().nodeCpus.size();
+        return (n >= 1) ? n : 1;
+    }
+
+    /**
+     * Gets the node assigned to a thread.
+     * @param y thread number.
+     * @param threads the number of threads.
+     * @return node number; -1 if unknown.
+     */
+    static int nodeOfThread(int y, int threads) {
+        MyVector<int> const& nodeIds = instance().nodeIds;
+        if (nodeIds.empty()) return -1;
+        return nodeIds[nodeIndex(y, threads)];
+    }
+
+    /**
+     * Gets the node on which the calling thread is running.
+     * @return node number; -1 if unknown.
+     */
+    static int currentNode() {
+#ifdef __linux__
+        int cpu = sched_getcpu();
+        MyVector<int> const& cpuNode = instance().cpuNode;
+        if (0 <= cpu && size_t(cpu) < cpuNode.size()) return cpuNode[cpu];
+#endif
+        return -1;
+    }
+
+    /**
+     * Binds the calling thread to the CPUs of its node
+     * if the NUMA-aware placement is in effect.
+     * @param y thread number.
+     * @param threads the number of threads.
+     */
+    static void bindThread(int y, int threads) {
+        if (!active()) return;
+#ifdef __linux__
+        MyVector<int> const& cpus = instance().nodeCpus[nodeIndex(y, threads)];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t k = 0; k < cpus.size(); ++k) {
+            CPU_SET(cpus[k], &set);
+        }
+        sched_setaffinity(0, sizeof(set), &set);
+#endif
+    }
+
+    /**
+     * Interleaves the pages of a memory block over the nodes
+     * if the NUMA-aware placement is in effect.
+     * It should be called before the block is first written.
+     * Small blocks are left to the default policy.
+     * @param p pointer to the block.
+     * @param bytes the size of the block.
+     */
+    static void interleave(void const* p, size_t bytes) {
+        if (bytes < INTERLEAVE_MIN || !active()) return;
+#if defined(__linux__) && defined(SYS_mbind)
+        size_t const page = sysconf(_SC_PAGESIZE);
+        size_t const b = (reinterpret_cast<size_t>(p) + page - 1) / page * page;
+        size_t const e = (reinterpret_cast<size_t>(p) + bytes) / page * page;
+        if (b >= e) return;
+
+        int const bits = sizeof(long) * 8;
+        unsigned long mask[4] = { 0, 0, 0, 0 };
+        MyVector<int> const& nodeIds = instance().nodeIds;
+        for (size_t k = 0; k < nodeIds.size(); ++k) {
+            int const id = nodeIds[k];
+            if (id < int(sizeof(mask) * 8)) mask[id / bits] |= 1UL << (id % bits);
+        }
+        syscall(SYS_mbind, b, e - b, MPOL_INTERLEAVE_, mask,
+                sizeof(mask) * 8, 0);
+#endif
+    }
+
+    /**
+     * Gets the node on which a memory page resides.
+     * @param p address in the page.
+     * @return node number; -1 if unknown or not yet allocated.
+     */
+    static int nodeOfAddress(void const* p) {
+#if defined(__linux__) && defined(SYS_move_pages)
+        size_t const page = sysconf(_SC_PAGESIZE);
+        void* addr = reinterpret_cast<void*>(
+                reinterpret_cast<size_t>(p) / page * page);
+        int status = -1;
+        if (syscall(SYS_move_pages, 0, 1UL, &addr, 0, &status, 0) == 0
+                && status >= 0) return status;
+#endif
+        return -1;
+    }
+};
+
+template<int N>
+bool NumaPlacement_<N>::enabled_ = false;
+
+typedef NumaPlacement_<> NumaPlacement;
+
+} // namespace tdzdd
@@ -0,0 +1,192 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace tdzdd {
+
+/**
+ * Temporary file of fixed-size records.
+ * Records are appended and then read back sequentially in the same order.
+ * The file is opened only while it is being written or read,
+ * so that a large number of spill files can exist at the same time.
+ * The file is removed on destruction.
+ */
+class SpillFile {
+    std::string path;
+    std::FILE* fp;
+    size_t recordSize;
+    size_t count;
+    bool reading;
+
+    SpillFile(SpillFile const&);
+    SpillFile& operator=(SpillFile const&);
+
+    static std::string newPath(std::string const& dir) {
+        static unsigned long serial = 0;
+        std::ostringstream oss;
+        oss << (dir.empty() ? defaultDirectory() : dir);
+#ifdef _WIN32
+        oss << "\\tdzdd-" << _getpid();
+#else
+        oss << "/tdzdd-" << getpid();
+#endif
+        oss << "-" << serial++ << ".spill";
+        return oss.str();
+    }
+
+    void open(char const* mode) {
+        fp = std::fopen(path.c_str(), mode);
+        if (fp == 0) {
+            throw std::runtime_error("Cannot open spill file: " + path);
+        }
+    }
+
+public:
+    /**
+     * Gets the default directory for spill files.
+     * It is given by the TMPDIR environment variable if exists.
+     * @return directory path.
+     */
+    static std::string defaultDirectory() {
+        char const* dir = std::getenv("TMPDIR");
+        if (dir != 0 && dir[0] != '\0') return dir;
+#ifdef _WIN32
+        dir = std::getenv("TEMP");
+        return (dir != 0) ? dir : ".";
+#else
+        return "/tmp";
+#endif
+    }
+
+    /**
+     * Constructor.
+     * @param dir directory for the file; empty for the default.
+     * @param recordSize the size of a record in bytes.
+     */
+    SpillFile(std::string const& dir, size_t recordSize)
+            : path(newPath(dir)), fp(0), recordSize(recordSize), count(0),
+              reading(false) {
+    }
+
+    ~SpillFile() {
+        if (fp != 0) std::fclose(fp);
+        if (count != 0 || reading) std::remove(path.c_str());
+    }
+
+    /**
+     * Gets the number of records.
+     * @return the number of records written.
+     */
+    size_t size() const {
+        return count;
+    }
+
+    /**
+     * Gets the size of the file.
+     * @return the number of bytes.
+     */
+    size_t bytes() const {
+        return count * recordSize;
+    }
+
+    /**
+     * Appends records to the file.
+     * @param p pointer to the records.
+     * @param n the number of records.
+     */
+    void write(void const* p, size_t n = 1) {
+        assert(!reading);
+        if (fp == 0) open(count ? "ab" : "wb");
+        if (std::fwrite(p, recordSize, n, fp) != n) {
+            throw std::runtime_error("Cannot write spill file: " + path);
+        }
+        count += n;
+    }
+
+    /**
+     * Closes the file temporarily after writing.
+     */
+    void close() {
+        if (fp != 0) {
+            if (std::fclose(fp) != 0) {
+                fp = 0;
+                throw std::runtime_error("Cannot write spill file: " + path);
+            }
+            fp = 0;
+        }
+    }
+
+    /**
+     * Reads records sequentially from the beginning of the file.
+     * The file must not be written after reading is started.
+     * @param p pointer to the buffer for records.
+     * @param n the maximum number of records to read.
+     * @return the number of records read; 0 at the end of file.
+     */
+    size_t read(void* p, size_t n = 1) {
+        if (!reading) {
+            close();
+            reading = true;
+            if (count == 0) return 0;
+            open("rb");
+        }
+        if (fp == 0) return 0;
+        size_t k = std::fread(p, recordSize, n, fp);
+        if (k < n) {
+            if (std::ferror(fp)) {
+                throw std::runtime_error("Cannot read spill file: " + path);
+            }
+            std::fclose(fp);
+            fp = 0;
+        }
+        return k;
+    }
+
+    /**
+     * Removes the file and makes this object empty.
+     */
+    void clear() {
+        if (fp != 0) std::fclose(fp);
+        fp = 0;
+        if (count != 0 || reading) std::remove(path.c_str());
+        count = 0;
+        reading = false;
+    }
+};
+
+} // namespace tdzdd
@@ -0,0 +1,356 @@
+/*
+ * TdZdd: a Top-down/Breadth-first Decision Diagram Manipulation Framework
+ * by Hiroaki Iwashita <iwashita@erato.ist.hokudai.ac.jp>
+ * Copyright (c) 2014 ERATO MINATO Project
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <iomanip>
+#include <ostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "MyVector.hpp"
+#include "ResourceUsage.hpp"
+
+namespace tdzdd {
+
+/**
+ * Work-stealing scheduler for an index range.
+ * The range [0, n) is first divided among the threads in proportion to
+ * the weights of the indices.
+ * Each thread takes small chunks from the front of its own range,
+ * and when the range runs dry it steals the latter half of the remaining
+ * range of another thread.
+ * Thus a heavy part of the range is split on demand instead of being
+ * processed by a single thread.
+ *
+ * Typical usage inside an OpenMP parallel region:
+ * @code
+ * #pragma omp single
+ * scheduler.reset(n, cumWeight);
+ * size_t begin, end;
+ * while (scheduler.next(yy, begin, end)) {
+ *     for (size_t k = begin; k < end; ++k) ...
+ * }
+ * #pragma omp barrier
+ * @endcode
+ */
+class WorkStealingScheduler {
+    static size_t const CHUNKS_PER_THREAD = 16;
+
+    struct Deque {
+        size_t begin;       ///< front of the remaining range.
+        size_t end;         ///< back of the remaining range.
+        size_t work;        ///< weight processed by the owner.
+        size_t steals;      ///< number of successful steals by the owner.
+        double busyTime;    ///< time spent on processing chunks.
+        double chunkStart;  ///< start time of the current chunk.
+#ifdef _OPENMP
+        omp_lock_t lock;
+#endif
+        char padding[64];   // avoid false sharing between threads
+    };
+
+    int const threads;
+    MyVector<Deque> deques;
+    size_t n;
+    size_t const* cumWeight;
+    size_t grain;
+
+    size_t weight(size_t begin, size_t end) const {
+        return cumWeight ? cumWeight[end] - cumWeight[begin] : end - begin;
+    }
+
+    /*
+     * Finds the smallest position k in (begin, end] such that
+     * the weight of [begin, k) is not less than w.
+     */
+    size_t advance(size_t begin, size_t end, size_t w) const {
+        if (cumWeight == 0) return std::min(begin + std::max(w, size_t(1)), end);
+        size_t k = std::lower_bound(cumWeight + begin + 1, cumWeight + end,
+                cumWeight[begin] + w) - cumWeight;
+        return std::min(k, end);
+    }
+
+    void lock(Deque& d) {
+#ifdef _OPENMP
+        omp_set_lock(&d.lock);
+#endif
+    }
+
+    void unlock(Deque& d) {
+#ifdef _OPENMP
+        omp_unset_lock(&d.lock);
+#endif
+    }
+
+    bool steal(int y) {
+        Deque& me = deques[y];
+
+        for (int k = 1; k < threads; ++k) {
+            Deque& victim = deques[(y + k) % threads];
+            size_t b, e;
+
+            lock(victim);
+            b = victim.begin;
+            e = victim.end;
+            if (b < e) {
+                size_t mid = (e - b == 1) ? b : advance(b, e, weight(b, e) / 2);
+                if (mid == e) mid = e - 1;
+                victim.end = mid;
+                b = mid;
+            }
+            unlock(victim);
+
+            if (b < e) {
+                lock(me);
+                me.begin = b;
+                me.end = e;
+                ++me.steals;
+                unlock(me);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+public:
+    /**
+     * Constructor.
+     * @param threads the number of threads.
+     */
+    explicit WorkStealingScheduler(int threads)
+            : threads(std::max(threads, 1)), deques(this->threads), n(0),
+              cumWeight(0), grain(1) {
+        for (int y = 0; y < this->threads; ++y) {
+            Deque& d = deques[y];
+            d.begin = d.end = 0;
+            d.work = d.steals = 0;
+            d.busyTime = d.chunkStart = 0;
+#ifdef _OPENMP
+            omp_init_lock(&d.lock);
+#endif
+        }
+    }
+
+    ~WorkStealingScheduler() {
+#ifdef _OPENMP
+        for (int y = 0; y < threads; ++y) {
+            omp_destroy_lock(&deques[y].lock);
+        }
+#endif
+    }
+
+    /**
+     * Sets up a new index range.
+     * This function must not be called concurrently with next().
+     * @param size the number of indices.
+     * @param cumulativeWeight array of size+1 elements such that
+     *        cumulativeWeight[k+1]-cumulativeWeight[k] is the weight of
+     *        index k, or null for unit weights.
+     */
+    void reset(size_t size, size_t const* cumulativeWeight = 0) {
+        n = size;
+        cumWeight = cumulativeWeight;
+        size_t const total = weight(0, n);
+        grain = std::max(total / (threads * CHUNKS_PER_THREAD), size_t(1));
+
+        size_t b = 0;
+        for (int y = 0; y < threads; ++y) {
+            Deque& d = deques[y];
+            size_t const target = total * (y + 1) / threads;
+            size_t const done = weight(0, b);
+            size_t e = (y == threads - 1) ? n :
+                       (done >= target) ? b : advance(b, n, target - done);
+            d.begin = b;
+            d.end = e;
+            d.work = d.steals = 0;
+            d.busyTime = d.chunkStart = 0;
+            b = e;
+        }
+    }
+
+    /**
+     * Gets the next chunk for a thread.
+     * @param y thread number.
+     * @param begin the first index of the chunk.
+     * @param end the index next to the last one of the chunk.
+     * @return false if no work remains.
+     */
+    bool next(int y, size_t& begin, size_t& end) {
+        Deque& me = deques[y];
+        double now = getWallClockTime();
+        if (me.chunkStart > 0) me.busyTime += now - me.chunkStart;
+        me.chunkStart = 0;
+
+        for (;;) {
+            lock(me);
+            size_t b = me.begin;
+            size_t e = me.end;
+            if (b < e) {
+                e = advance(b, e, grain);
+                me.begin = e;
+            }
+            unlock(me);
+
+            if (b < e) {
+                begin = b;
+                end = e;
+                me.work += weight(b, e);
+                me.chunkStart = getWallClockTime();
+                return true;
+            }
+
+            if (!steal(y)) return false;
+        }
+    }
+
+    /**
+     * Gets the weight processed by a thread since the last reset.
+     * @param y thread number.
+     * @return the processed weight.
+     */
+    size_t work(int y) const {
+        return deques[y].work;
+    }
+
+    /**
+     * Gets the number of steals by all threads since the last reset.
+     * @return the number of steals.
+     */
+    size_t steals() const {
+        size_t k = 0;
+        for (int y = 0; y < threads; ++y) {
+            k += deques[y].steals;
+        }
+        return k;
+    }
+
+    /**
+     * Gets the total time spent on processing chunks by a thread
+     * since the last reset.
+     * @param y thread number.
+     * @return busy time in seconds.
+     */
+    double busyTime(int y) const {
+        return deques[y].busyTime;
+    }
+};
+
+/**
+ * Load-imbalance statistics of parallel phases.
+ * The busy time of each thread is accumulated per level, and
+ * the imbalance of a level is the ratio of the maximum busy time
+ * to the average one; 1.0 means perfectly balanced.
+ */
+class LoadImbalanceStats {
+    int const threads;
+    MyVector<double> busy;
+    MyVector<double> imbalance_;
+    size_t steals_;
+
+public:
+    /**
+     * Constructor.
+     * @param threads the number of threads.
+     */
+    explicit LoadImbalanceStats(int threads)
+            : threads(std::max(threads, 1)), busy(this->threads), steals_(0) {
+    }
+
+    /**
+     * Adds the busy times recorded by a scheduler.
+     * This function must be called after each parallel phase.
+     * @param s the scheduler.
+     */
+    void add(WorkStealingScheduler const& s) {
+        for (int y = 0; y < threads; ++y) {
+            busy[y] += s.busyTime(y);
+        }
+        steals_ += s.steals();
+    }
+
+    /**
+     * Closes the statistics of a level.
+     * @param level the level.
+     */
+    void endLevel(int level) {
+        double max = 0;
+        double sum = 0;
+        for (int y = 0; y < threads; ++y) {
+            max = std::max(max, busy[y]);
+            sum += busy[y];
+            busy[y] = 0;
+        }
+        if (level >= 0 && size_t(level) >= imbalance_.size()) {
+            imbalance_.resize(level + 1);
+        }
+        if (level >= 0) imbalance_[level] = (sum > 0) ? max * threads / sum : 1;
+    }
+
+    /**
+     * Gets the load imbalance of a level.
+     * @param level the level.
+     * @return max/average busy time of the threads.
+     */
+    double imbalance(int level) const {
+        return (size_t(level) < imbalance_.size()) ? imbalance_[level] : 0;
+    }
+
+    /**
+     * Gets the maximum load imbalance over all levels.
+     * @return max/average busy time of the threads.
+     */
+    double maxImbalance() const {
+        double max = 0;
+        for (size_t i = 0; i < imbalance_.size(); ++i) {
+            max = std::max(max, imbalance_[i]);
+        }
+        return max;
+    }
+
+    /**
+     * Gets the total number of steals.
+     * @return the number of steals.
+     */
+    size_t steals() const {
+        return steals_;
+    }
+
+    friend std::ostream& operator<<(std::ostream& os,
+                                    LoadImbalanceStats const& o) {
+        std::ios_base::fmtflags backup = os.flags(std::ios::fixed);
+        os.setf(std::ios::fixed);
+        os << "max imbalance " << std::setprecision(2) << o.maxImbalance();
+        os << ", " << o.steals_ << " steals";
+        os.flags(backup);
+        return os;
+    }
+};
+
+} // namespace tdzdd